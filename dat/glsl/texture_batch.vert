@@ -0,0 +1,19 @@
+uniform mat4 projection;
+
+in vec4 vertex;
+in vec2 vertex_tex;
+in vec2 vertex_tex2;
+in vec4 vertex_color;
+in float vertex_inter;
+out vec2 tex_coord1;
+out vec2 tex_coord2;
+out vec4 color;
+out float inter;
+
+void main(void) {
+   tex_coord1 = vertex_tex;
+   tex_coord2 = vertex_tex2;
+   color = vertex_color;
+   inter = vertex_inter;
+   gl_Position = projection * vertex;
+}
@@ -0,0 +1,13 @@
+uniform mat4 tex_mat;
+uniform mat4 tex_mat2;
+uniform mat4 projection;
+
+in vec4 vertex;
+out vec2 tex_coord1;
+out vec2 tex_coord2;
+
+void main(void) {
+   tex_coord1 = (tex_mat * vertex).st;
+   tex_coord2 = (tex_mat2 * vertex).st;
+   gl_Position = projection * vertex;
+}
@@ -21,6 +21,13 @@
 /*
  * Prototypes
  */
+static uint64_t transBits( const glTexture* t, int x, int y );
+static int firstBit( uint64_t m );
+#if DEBUGGING
+static int CollideSpritePixel( const glTexture* at, const int asx, const int asy, const Vector2d* ap,
+      const glTexture* bt, const int bsx, const int bsy, const Vector2d* bp,
+      Vector2d* crash );
+#endif /* DEBUGGING */
 static int pointInPolygon( const CollPoly* at, const Vector2d* ap,
       float x, float y );
 static int LineOnPolygon( const CollPoly* at, const Vector2d* ap,
@@ -85,12 +92,55 @@ void LoadPolygon( CollPoly* polygon, xmlNodePtr node )
 }
 
 
+/**
+ * @brief Gets 64 pixels of a row of the transparency bitmask.
+ *
+ *    @param t Texture to get pixels of.
+ *    @param x X position of the first pixel in the sheet.
+ *    @param y Y position of the row in the sheet.
+ *    @return Pixel x in bit 0, x+1 in bit 1 and so on, set if opaque.
+ */
+static uint64_t transBits( const glTexture* t, int x, int y )
+{
+   const uint64_t *row;
+   uint64_t m;
+   int w, s;
+
+   row = &t->transmask[ y*t->transpitch ];
+   w   = x / 64;
+   s   = x % 64;
+   m   = row[w] >> s;
+   if ((s != 0) && (w+1 < t->transpitch))
+      m |= row[w+1] << (64-s);
+   return m;
+}
+
+
+/**
+ * @brief Gets the position of the lowest set bit of a non-zero mask.
+ */
+static int firstBit( uint64_t m )
+{
+#if defined(__GNUC__)
+   return __builtin_ctzll( m );
+#else /* defined(__GNUC__) */
+   int i;
+   for (i=0; !(m & 1); i++)
+      m >>= 1;
+   return i;
+#endif /* defined(__GNUC__) */
+}
+
+
 /**
  * @brief Checks whether or not two sprites collide.
  *
  * This function does pixel perfect checks.  If the collision actually occurs,
  *  crash is set to store the real position of the collision.
  *
+ * Rows are skipped unless the opaque spans of both sprites overlap, then
+ *  tested 64 pixels at a time with the transparency bitmasks.
+ *
  *    @param[in] at Texture a.
  *    @param[in] asx Position of x of sprite a.
  *    @param[in] asy Position of y of sprite a.
@@ -112,14 +162,17 @@ int CollideSprite( const glTexture* at, const int asx, const int asy, const Vect
    int inter_x0, inter_x1, inter_y0, inter_y1;
    int rasy, rbsy;
    int abx,aby, bbx, bby;
+   int x0, x1;
+   const int16_t *sa, *sb;
+   uint64_t m;
 
 #if DEBUGGING
    /* Make sure the surfaces have transparency maps. */
-   if (at->trans == NULL) {
+   if (at->transmask == NULL) {
       WARN(_("Texture '%s' has no transparency map"), at->name);
       return 0;
    }
-   if (bt->trans == NULL) {
+   if (bt->transmask == NULL) {
       WARN(_("Texture '%s' has no transparency map"), bt->name);
       return 0;
    }
@@ -157,17 +210,29 @@ int CollideSprite( const glTexture* at, const int asx, const int asy, const Vect
    bbx =  bsx*(int)(bt->sw) - bx1;
    bby = rbsy*(int)(bt->sh) - by1;
 
-   for (y=inter_y0; y<=inter_y1; y++)
-      for (x=inter_x0; x<=inter_x1; x++)
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ((!gl_isTrans(at, abx + x, aby + y)) &&
-               (!gl_isTrans(bt, bbx + x, bby + y))) {
-
-            /* Set the crash position. */
-            crash->x = x;
-            crash->y = y;
-            return 1;
-         }
+   for (y=inter_y0; y<=inter_y1; y++) {
+      /* Only the columns where both sprite rows are opaque can collide. */
+      sa = &at->transspan[ 2*((aby+y)*(int)at->sx + asx) ];
+      sb = &bt->transspan[ 2*((bby+y)*(int)bt->sx + bsx) ];
+      if ((sa[0] < 0) || (sb[0] < 0))
+         continue;
+      x0 = MAX( inter_x0, MAX( sa[0] - abx, sb[0] - bbx ) );
+      x1 = MIN( inter_x1, MIN( sa[1] - abx, sb[1] - bbx ) );
+
+      /* Test 64 pixels at a time. */
+      for (x=x0; x<=x1; x+=64) {
+         m = transBits( at, abx + x, aby + y ) & transBits( bt, bbx + x, bby + y );
+         if (x1 - x < 63)
+            m &= ((uint64_t)1 << (x1 - x + 1)) - 1;
+         if (m == 0)
+            continue;
+
+         /* Set the crash position. */
+         crash->x = x + firstBit( m );
+         crash->y = y;
+         return 1;
+      }
+   }
 
    return 0;
 }
@@ -746,3 +811,161 @@ int CollideLinePolygon( const Vector2d* ap, double ad, double al,
    /* We hit. */
    return 1;
 }
+
+
+#if DEBUGGING
+/**
+ * @brief Checks whether or not two sprites collide one pixel at a time.
+ *
+ * Reference for CollideSprite, only used to benchmark and verify it.
+ *
+ *    @param[in] at Texture a.
+ *    @param[in] asx Position of x of sprite a.
+ *    @param[in] asy Position of y of sprite a.
+ *    @param[in] ap Position in space of sprite a.
+ *    @param[in] bt Texture b.
+ *    @param[in] bsx Position of x of sprite b.
+ *    @param[in] bsy Position of y of sprite b.
+ *    @param[in] bp Position in space of sprite b.
+ *    @param[out] crash Actual position of the collision (only set on collision).
+ *    @return 1 on collision, 0 else.
+ */
+static int CollideSpritePixel( const glTexture* at, const int asx, const int asy, const Vector2d* ap,
+      const glTexture* bt, const int bsx, const int bsy, const Vector2d* bp,
+      Vector2d* crash )
+{
+   int x,y;
+   int ax1,ax2, ay1,ay2;
+   int bx1,bx2, by1,by2;
+   int inter_x0, inter_x1, inter_y0, inter_y1;
+   int rasy, rbsy;
+   int abx,aby, bbx, bby;
+
+   /* a - cube coordinates */
+   ax1 = (int)VX(*ap) - (int)(at->sw)/2;
+   ay1 = (int)VY(*ap) - (int)(at->sh)/2;
+   ax2 = ax1 + (int)(at->sw) - 1;
+   ay2 = ay1 + (int)(at->sh) - 1;
+
+   /* b - cube coordinates */
+   bx1 = (int)VX(*bp) - (int)(bt->sw)/2;
+   by1 = (int)VY(*bp) - (int)(bt->sh)/2;
+   bx2 = bx1 + bt->sw - 1;
+   by2 = by1 + bt->sh - 1;
+
+   /* check if bounding boxes intersect */
+   if ((bx2 < ax1) || (ax2 < bx1)) return 0;
+   if ((by2 < ay1) || (ay2 < by1)) return 0;
+
+   /* define the remaining binding box */
+   inter_x0 = MAX( ax1, bx1 );
+   inter_x1 = MIN( ax2, bx2 );
+   inter_y0 = MAX( ay1, by1 );
+   inter_y1 = MIN( ay2, by2 );
+
+   /* real vertical sprite value (flipped) */
+   rasy = at->sy - asy - 1;
+   rbsy = bt->sy - bsy - 1;
+
+   /* set up the base points */
+   abx =  asx*(int)(at->sw) - ax1;
+   aby = rasy*(int)(at->sh) - ay1;
+   bbx =  bsx*(int)(bt->sw) - bx1;
+   bby = rbsy*(int)(bt->sh) - by1;
+
+   for (y=inter_y0; y<=inter_y1; y++)
+      for (x=inter_x0; x<=inter_x1; x++)
+         /* compute offsets for surface before pass to TransparentPixel test */
+         if ((!gl_isTrans(at, abx + x, aby + y)) &&
+               (!gl_isTrans(bt, bbx + x, bby + y))) {
+
+            /* Set the crash position. */
+            crash->x = x;
+            crash->y = y;
+            return 1;
+         }
+
+   return 0;
+}
+
+
+/**
+ * @brief Times CollideSprite against the pixel by pixel reference.
+ *
+ * Sweeps sprite b across sprite a for every pair of frames, checking both
+ *  functions agree.
+ *
+ *    @param at Texture a.
+ *    @param bt Texture b.
+ *    @param iter Number of sweeps to time.
+ */
+void CollideSpriteBenchmark( const glTexture* at, const glTexture* bt, int iter )
+{
+   int i, f, x, y, n, na, nb, hits, err;
+   int asx, asy, bsx, bsy;
+   double freq;
+   Uint64 t0, t1, t2;
+   Vector2d ap, bp, ca, cb;
+
+   if ((at->transmask == NULL) || (bt->transmask == NULL)) {
+      WARN(_("Texture '%s' has no transparency map"),
+            (at->transmask == NULL) ? at->name : bt->name);
+      return;
+   }
+   /* Spans built before the sheet was split into sprites would be read out of bounds. */
+   if ((at->transsx != (int)at->sx) || (bt->transsx != (int)bt->sx)) {
+      WARN(_("Texture '%s' has collision spans for the wrong number of sprites"),
+            (at->transsx != (int)at->sx) ? at->name : bt->name);
+      return;
+   }
+
+   vect_cset( &ap, 0., 0. );
+   na = (int)(at->sx*at->sy);
+   nb = (int)(bt->sx*bt->sy);
+   n  = MAX( na, nb );
+
+   /* Check they agree, going over every frame of both sheets. */
+   hits = 0;
+   err  = 0;
+   for (f=0; f<n; f++) {
+      asx = (f % na) % (int)at->sx;
+      asy = (f % na) / (int)at->sx;
+      bsx = (f % nb) % (int)bt->sx;
+      bsy = (f % nb) / (int)bt->sx;
+      for (y=-(int)(at->sh+bt->sh)/2; y<=(int)(at->sh+bt->sh)/2; y+=2) {
+         for (x=-(int)(at->sw+bt->sw)/2; x<=(int)(at->sw+bt->sw)/2; x+=2) {
+            vect_cset( &bp, x, y );
+            i = CollideSprite( at, asx, asy, &ap, bt, bsx, bsy, &bp, &ca );
+            if (i != CollideSpritePixel( at, asx, asy, &ap, bt, bsx, bsy, &bp, &cb )
+                  || (i && ((ca.x != cb.x) || (ca.y != cb.y))))
+               err++;
+            hits += i;
+         }
+      }
+   }
+
+   t0 = SDL_GetPerformanceCounter();
+   for (i=0; i<iter; i++) {
+      for (f=0; f<n; f++) {
+         vect_cset( &bp, (f % 16) - 8, (f / 16 % 16) - 8 );
+         CollideSpritePixel( at, (f % na) % (int)at->sx, (f % na) / (int)at->sx, &ap,
+               bt, (f % nb) % (int)bt->sx, (f % nb) / (int)bt->sx, &bp, &cb );
+      }
+   }
+   t1 = SDL_GetPerformanceCounter();
+   for (i=0; i<iter; i++) {
+      for (f=0; f<n; f++) {
+         vect_cset( &bp, (f % 16) - 8, (f / 16 % 16) - 8 );
+         CollideSprite( at, (f % na) % (int)at->sx, (f % na) / (int)at->sx, &ap,
+               bt, (f % nb) % (int)bt->sx, (f % nb) / (int)bt->sx, &bp, &ca );
+      }
+   }
+   t2 = SDL_GetPerformanceCounter();
+
+   freq = (double)SDL_GetPerformanceFrequency() / 1e6;
+   DEBUG(_("Collision benchmark: '%s' (%d frames) against '%s' (%d frames), %d hits, %d mismatches"),
+         at->name, na, bt->name, nb, hits, err);
+   DEBUG(_("   Pixel by pixel: %.3f us/test"), (double)(t1-t0)/freq/(iter*n));
+   DEBUG(_("   Bitmask: %.3f us/test"), (double)(t2-t1)/freq/(iter*n));
+}
+#endif /* DEBUGGING */
@@ -35,6 +35,9 @@ void LoadPolygon( CollPoly* polygon, xmlNodePtr node );
 int CollideSprite( const glTexture* at, const int asx, const int asy, const Vector2d* ap,
       const glTexture* bt, const int bsx, const int bsy, const Vector2d* bp,
       Vector2d* crash);
+#if DEBUGGING
+void CollideSpriteBenchmark( const glTexture* at, const glTexture* bt, int iter );
+#endif /* DEBUGGING */
 int CollideLineLine( double s1x, double s1y, double e1x, double e1y,
       double s2x, double s2y, double e2x, double e2y, Vector2d* crash );
 int CollideLineSprite( const Vector2d* ap, double ad, double al,
@@ -55,26 +55,69 @@ void cond_exit (void)
 
 
 /**
- * @brief Checks to see if a condition is true.
+ * @brief Compiles a condition into a Lua chunk.
  *
- *    @param cond Condition to check.
- *    @return 0 if is false, 1 if is true, -1 on error.
+ * The chunk is kept in the registry so it only has to be parsed once.
+ *
+ *    @param cond Condition to compile.
+ *    @return Reference to the chunk or LUA_REFNIL on error.
  */
-int cond_check( const char* cond )
+int cond_compile( const char *cond )
 {
-   int b;
    int ret;
 
    /* Load the string. */
    lua_pushstring(naevL, "return ");
    lua_pushstring(naevL, cond);
    lua_concat(naevL, 2);
-   ret = nlua_dobufenv(cond_env, lua_tostring(naevL,-1),
-                       lua_strlen(naevL,-1), "Lua Conditional");
+   ret = luaL_loadbuffer(naevL, lua_tostring(naevL,-1),
+                         lua_strlen(naevL,-1), "Lua Conditional");
+   if (ret != 0) {
+      WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
+      lua_pop(naevL, 2);
+      return LUA_REFNIL;
+   }
+   lua_remove(naevL, -2);
+
+   /* Run it in the conditional environment. */
+   nlua_pushenv(cond_env);
+   lua_setfenv(naevL, -2);
+   return luaL_ref(naevL, LUA_REGISTRYINDEX);
+}
+
+
+/**
+ * @brief Frees a compiled condition.
+ *
+ *    @param chunk Chunk to free.
+ */
+void cond_freeChunk( int chunk )
+{
+   if ((chunk == LUA_NOREF) || (chunk == LUA_REFNIL))
+      return;
+   luaL_unref(naevL, LUA_REGISTRYINDEX, chunk);
+}
+
+
+/**
+ * @brief Checks to see if a compiled condition is true.
+ *
+ *    @param chunk Chunk to check, from cond_compile.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
+int cond_checkChunk( int chunk )
+{
+   int b;
+   int ret;
+
+   /* Failed to compile. */
+   if ((chunk == LUA_NOREF) || (chunk == LUA_REFNIL))
+      return -1;
+
+   /* Run the chunk. */
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, chunk);
+   ret = nlua_pcall(cond_env, 0, 1);
    switch (ret) {
-      case  LUA_ERRSYNTAX:
-         WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
       case LUA_ERRRUN:
          WARN(_("Lua Conditional had a runtime error: %s"), lua_tostring(naevL, -1));
          goto cond_err;
@@ -109,3 +152,23 @@ cond_err:
    lua_settop(naevL, 0);
    return -1;
 }
+
+
+/**
+ * @brief Checks to see if a condition is true.
+ *
+ * Compiles the condition every call, use cond_compile and cond_checkChunk for
+ * conditions that are checked often.
+ *
+ *    @param cond Condition to check.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
+int cond_check( const char* cond )
+{
+   int chunk, ret;
+
+   chunk = cond_compile( cond );
+   ret   = cond_checkChunk( chunk );
+   cond_freeChunk( chunk );
+   return ret;
+}
@@ -10,6 +10,9 @@
 int cond_init (void);
 void cond_exit (void);
 int cond_check( const char *cond );
+int cond_compile( const char *cond );
+int cond_checkChunk( int chunk );
+void cond_freeChunk( int chunk );
 
 
 #endif /* COND_H */
@@ -221,6 +221,7 @@ void conf_setAudioDefaults (void)
    /* Sound. */
    conf.snd_voices   = VOICES_DEFAULT;
    conf.snd_pilotrel = PILOT_RELATIVE_DEFAULT;
+   conf.snd_cache    = SOUND_CACHE_DEFAULT;
    conf.al_efx       = USE_EFX_DEFAULT;
    conf.al_bufsize   = BUFFER_SIZE_DEFAULT;
    conf.nosound      = MUTE_SOUND_DEFAULT;
@@ -280,6 +281,8 @@ void conf_setVideoDefaults (void)
 
    /* Memory. */
    conf.engineglow   = ENGINE_GLOWS_DEFAULT;
+   conf.tex_cache    = TEXTURE_CACHE_DEFAULT;
+   conf.spfx_max     = SPFX_MAX_DEFAULT;
 }
 
 
@@ -355,6 +358,8 @@ int conf_loadConfig ( const char* file )
 
       /* Memory. */
       conf_loadBool( lEnv, "engineglow", conf.engineglow );
+      conf_loadInt( lEnv, "tex_cache", conf.tex_cache );
+      conf_loadInt( lEnv, "spfx_max", conf.spfx_max );
 
       /* Window. */
       w = h = 0;
@@ -385,6 +390,7 @@ int conf_loadConfig ( const char* file )
       conf_loadInt( lEnv, "snd_voices", conf.snd_voices );
       conf.snd_voices = MAX( VOICES_MIN, conf.snd_voices ); /* Must be at least 16. */
       conf_loadBool( lEnv, "snd_pilotrel", conf.snd_pilotrel );
+      conf_loadInt( lEnv, "snd_cache", conf.snd_cache );
       conf_loadBool( lEnv, "al_efx", conf.al_efx );
       conf_loadInt( lEnv, "al_bufsize", conf.al_bufsize );
       conf_loadBool( lEnv, "nosound", conf.nosound );
@@ -891,6 +897,15 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("engineglow",conf.engineglow);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Megabytes of textures to keep in video memory, unused textures past this get freed"));
+   conf_saveComment(_("Set to 0 to free textures as soon as they aren't used"));
+   conf_saveInt("tex_cache",conf.tex_cache);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Maximum number of special effects per layer, past this the smallest ones get dropped"));
+   conf_saveInt("spfx_max",conf.spfx_max);
+   conf_saveEmptyLine();
+
    /* Window. */
    conf_saveComment(_("The window size or screen resolution"));
    conf_saveComment(_("Set both of these to 0 to make Naev try the desktop resolution"));
@@ -947,6 +962,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("snd_pilotrel",conf.snd_pilotrel);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Megabytes of decoded sounds to keep in memory, sounds that aren't playing past this get freed. 0 never frees them"));
+   conf_saveInt("snd_cache",conf.snd_cache);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Enables EFX extension for OpenAL backend."));
    conf_saveBool("al_efx",conf.al_efx);
    conf_saveEmptyLine();
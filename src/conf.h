@@ -38,6 +38,8 @@
 #define FPS_MAX_DEFAULT                      60    /**< Maximum FPS. */
 #define SHOW_PAUSE_DEFAULT                   1     /**< Whether to display pause status. */
 #define ENGINE_GLOWS_DEFAULT                 1     /**< Whether to display engine glows. */
+#define TEXTURE_CACHE_DEFAULT                256   /**< Megabytes of textures to keep in video memory. */
+#define SPFX_MAX_DEFAULT                     2048  /**< Maximum special effects per layer. */
 #define MINIMIZE_DEFAULT                     1     /**< Whether to minimize on focus loss. */
 #define COLORBLIND_DEFAULT                   0     /**< Whether to enable colorblindness simulation. */
 #define BIG_ICONS_DEFAULT                    1     /**< Whether to display BIGGER icons. */
@@ -47,6 +49,7 @@
 #define FONT_SIZE_SMALL_DEFAULT              11    /**< Default small font size. */
 /* Audio options */
 #define VOICES_DEFAULT                       128   /**< Amount of voices to use. */
+#define SOUND_CACHE_DEFAULT                  32    /**< Megabytes of decoded sounds to keep. */
 #define VOICES_MIN                           16    /**< Minimum amount of voices to use. */
 #define PILOT_RELATIVE_DEFAULT               1     /**< Whether the sound is relative to the pilot (as opposed to the camera). */
 #define USE_EFX_DEFAULT                      1     /**< Whether or not to use EFX (if using OpenAL). */
@@ -82,6 +85,8 @@ typedef struct PlayerConf_s {
 
    /* Memory usage. */
    int engineglow; /**< Sets engine glow. */
+   int tex_cache; /**< Megabytes of textures to keep in video memory before evicting unused ones. */
+   int spfx_max; /**< Maximum number of special effects per layer. */
 
    /* Video options. */
    int width; /**< Width of the window to use. */
@@ -96,6 +101,7 @@ typedef struct PlayerConf_s {
    /* Sound. */
    int snd_voices; /**< Number of sound voices to use. */
    int snd_pilotrel; /**< Sound is relative to pilot when following. */
+   int snd_cache; /**< Megabytes of decoded sounds to keep before evicting unused ones, 0 is unlimited. */
    int al_efx; /**< Should EFX extension be used? (only applicable for OpenAL) */
    int al_bufsize; /**< Size of the buffer (in kilobytes) to use for music. */
    int nosound; /**< Whether or not sound is on. */
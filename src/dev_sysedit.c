@@ -448,6 +448,7 @@ static void sysedit_btnRename( unsigned int wid_unused, char *unused )
          free(p->name);
 
          p->name = name;
+         systems_reconstructNames();
          window_modifyText( sysedit_widEdit, "txtName", p->name );
          dpl_savePlanet( p );
       }
@@ -1481,6 +1482,7 @@ static void sysedit_editJumpClose( unsigned int wid, char *unused )
       jp_rmFlag( j, JP_HIDDEN );
       jp_rmFlag( j, JP_EXITONLY );
    }
+   map_invalidateJumpGraph();
    j->hide  = pow2( atof(window_getInput( sysedit_widEdit, "inpHide" )) );
 
    window_close( wid, unused );
@@ -718,6 +718,7 @@ static void uniedit_renameSys (void)
       free(sys->name);
 
       sys->name = name;
+      systems_reconstructNames();
       dsys_saveSystem(sys);
 
       /* Re-save adjacent systems. */
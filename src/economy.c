@@ -10,12 +10,23 @@
  * Economy is handled with Nodal Analysis.  Systems are modelled as nodes,
  *  jump routes are resistances and production is modelled as node intensity.
  *  This is then solved with linear algebra after each time increment.
+ *
+ * The admittance matrix is symmetric positive definite, so it gets a sparse
+ *  Cholesky factorization that is only redone when the jump topology
+ *  changes. All the commodities are then solved together with blocked
+ *  triangular solves in the threadpool, and the results are picked up by a
+ *  later economy_update().
+ *
+ * The solved node potentials scale the sinusoidal planet prices: systems
+ *  with a surplus of a commodity sell it cheaper than the ones short of it.
  */
 
 
 /** @cond */
 #include <stdint.h>
 #include <stdio.h>
+#include "SDL.h"
+#include "SDL_atomic.h"
 
 #ifdef HAVE_SUITESPARSE_CS_H
 #include <suitesparse/cs.h>
@@ -39,6 +50,7 @@
 #include "rng.h"
 #include "space.h"
 #include "spfx.h"
+#include "threadpool.h"
 
 
 /*
@@ -49,6 +61,8 @@
 #define ECON_FACTION_MOD   0.1 /**< Modifier on Base for faction standings. */
 #define ECON_PROD_MODIFIER 500000. /**< Production modifier, divide production by this amount. */
 #define ECON_PROD_VAR      0.01 /**< Defines the variability of production. */
+#define ECON_PRICE_VAR     0.1 /**< Maximum relative price change caused by the nodal analysis. */
+#define ECON_RNG_SEED      0x9E3779B97F4A7C15ULL /**< Seed of the production random walk. */
 
 
 /* systems stack. */
@@ -64,17 +78,45 @@ extern Commodity* commodity_stack;
  */
 static int econ_initialized   = 0; /**< Is economy system initialized? */
 static int econ_queued        = 0; /**< Whether there are any queued updates. */
-static cs *econ_G             = NULL; /**< Admittance matrix. */
+static int econ_dirty         = 1; /**< Whether the jumps changed and econ_G must be rebuilt. */
+static cs *econ_G             = NULL; /**< Admittance matrix, owned by the solver job while one runs. */
+static css *econ_S            = NULL; /**< Symbolic Cholesky analysis of econ_G. */
+static csn *econ_N            = NULL; /**< Cholesky factorization of econ_G. */
+static double *econ_prodfactor = NULL; /**< Production factor of each planet, by id (array.h). */
+static ntime_t econ_dt        = 0; /**< Time not yet fed to the simulation. */
+static uint64_t econ_rng      = ECON_RNG_SEED; /**< State of the production random walk, kept apart from the gameplay RNG. */
+static int *econ_index        = NULL; /**< Economy commodity index by commodity stack index, or -1. */
 int *econ_comm         = NULL; /**< Commodities to calculate. */
 
 
+/**
+ * @brief Solve of all the commodities running in the threadpool.
+ */
+typedef struct EconJob_s {
+   cs *G; /**< New admittance matrix to factorize, NULL to reuse the factorization. */
+   int n; /**< Number of systems. */
+   int k; /**< Number of commodities. */
+   double *B; /**< Intensities in, node potentials out, n rows of k values. */
+   int ret; /**< 0 on success. */
+   SDL_atomic_t done; /**< Set when the job is finished. */
+} EconJob;
+static EconJob *econ_job      = NULL; /**< Running solve, if any. */
+
+
 /*
  * Prototypes.
  */
 /* Economy. */
-//static double econ_calcJumpR( StarSystem *A, StarSystem *B );
-//static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price );
-//static int econ_createGMatrix (void);
+static double econ_calcJumpR( StarSystem *A, StarSystem *B );
+static int econ_hasJump( const StarSystem *A, const StarSystem *B );
+static void econ_calcSysI( double *B, int k, ntime_t dt );
+static cs* econ_createGMatrix (void);
+static int econ_factor( const cs *G, css **S, csn **N );
+static void econ_solveBlock( const css *S, const csn *N, double *B, int n, int k );
+static double econ_rand2Sigma (void);
+static int econ_solve( void *data );
+static void econ_launch (void);
+static void econ_collect( int wait );
 
 /*
  * Externed prototypes.
@@ -112,11 +154,10 @@ credits_t economy_getPrice( const Commodity *com,
 credits_t economy_getPriceAtTime( const Commodity *com,
                                   const StarSystem *sys, const Planet *p, ntime_t tme )
 {
-   int i, k;
+   int i, e;
    double price;
    double t;
    CommodityPrice *commPrice;
-   (void) sys;
    /* Get current time in periods.
     * Note, taking off and landing takes about 1e7 ntime, which is 1 period.
     * Time does not advance when on a planet.
@@ -124,37 +165,31 @@ credits_t economy_getPriceAtTime( const Commodity *com,
     */
    t = ntime_convertSeconds( tme ) / NT_PERIOD_SECONDS;
 
-   /* Get position in stack. */
-   k = com - commodity_stack;
-
-   /* Find what commodity that is. */
-   for (i=0; i<array_size(econ_comm); i++)
-      if (econ_comm[i] == k)
-         break;
-
-   /* Check if found. */
-   if (i >= array_size(econ_comm)) {
+   /* Only commodities with a price are in the economy, see commodity_load. */
+   if (com->price <= 0.) {
       WARN(_("Price for commodity '%s' not known."), com->name);
       return 0;
    }
 
    /* and get the index on this planet */
-   for ( i=0; i<p->ncommodities; i++) {
-     if ( ( strcmp(p->commodities[i]->name, com->name) == 0 ) )
-       break;
-   }
-   if (i >= p->ncommodities) {
+   i = planet_commodityIndex( p, com );
+   if (i < 0) {
      WARN(_("Price for commodity '%s' not known on this planet."), com->name);
      return 0;
    }
    commPrice = &p->commodityPrice[i];
    /* Calculate price. */
-   /* price  = (double) com->price; */
-   /* price *= sys->prices[i]; */
    price = (commPrice->price + commPrice->sysVariation
             * sin(2 * M_PI * t / commPrice->sysPeriod)
          + commPrice->planetVariation
             * sin(2 * M_PI * t / commPrice->planetPeriod));
+
+   /* Supply and demand from the nodal analysis. */
+   if ((sys != NULL) && (sys->prices != NULL) && (econ_index != NULL)) {
+      e = econ_index[ com - commodity_stack ];
+      if (e >= 0)
+         price *= sys->prices[e];
+   }
    return (credits_t) (price+0.5);/* +0.5 to round */
 }
 
@@ -169,18 +204,11 @@ credits_t economy_getPriceAtTime( const Commodity *com,
  */
 int economy_getAveragePlanetPrice( const Commodity *com, const Planet *p, credits_t *mean, double *std )
 {
-   int i,k;
+   int i;
    CommodityPrice *commPrice;
-   /* Get position in stack */
-   k = com - commodity_stack;
-
-   /* Find what commodity this is */
-   for ( i=0; i<array_size(econ_comm); i++ )
-      if (econ_comm[i] == k)
-         break;
 
-   /* Check if found */
-   if ( i>= array_size(econ_comm)) {
+   /* Only commodities with a price are in the economy, see commodity_load. */
+   if (com->price <= 0.) {
       WARN(_("Average price for commodity '%s' not known."), com->name);
       *mean=0;
       *std=0;
@@ -188,11 +216,8 @@ int economy_getAveragePlanetPrice( const Commodity *com, const Planet *p, credit
    }
 
    /* and get the index on this planet */
-   for ( i=0; i<p->ncommodities; i++) {
-     if ( ( strcmp(p->commodities[i]->name, com->name) == 0 ) )
-       break;
-   }
-   if (i >= p->ncommodities) {
+   i = planet_commodityIndex( p, com );
+   if (i < 0) {
       WARN(_("Price for commodity '%s' not known on this planet."), com->name);
       *mean = 0;
       *std = 0;
@@ -229,16 +254,9 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
    double av = 0;
    double av2 = 0;
    int cnt = 0;
-   /* Get position in stack */
-   k = com - commodity_stack;
 
-   /* Find what commodity this is */
-   for ( i=0; i<array_size(econ_comm); i++ )
-      if (econ_comm[i] == k)
-         break;
-
-   /* Check if found */
-   if ( i>= array_size(econ_comm)) {
+   /* Only commodities with a price are in the economy, see commodity_load. */
+   if (com->price <= 0.) {
       WARN(_("Average price for commodity '%s' not known."), com->name);
       *mean = 0;
       *std = 0;
@@ -249,11 +267,8 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
       for ( j=0; j<sys->nplanets; j++) {
          p = sys->planets[j];
          /* and get the index on this planet */
-         for ( k=0; k<p->ncommodities; k++) {
-            if ( ( strcmp(p->commodities[k]->name, com->name) == 0 ) )
-               break;
-         }
-         if (k < p->ncommodities) {
+         k = planet_commodityIndex( p, com );
+         if (k >= 0) {
             commPrice=&p->commodityPrice[k];
             if ( commPrice->cnt>0) {
                av+=commPrice->sum/commPrice->cnt;
@@ -273,7 +288,6 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
 }
 
 
-#if 0
 /**
  * @brief Calculates the resistance between two star systems.
  *
@@ -307,106 +321,453 @@ static double econ_calcJumpR( StarSystem *A, StarSystem *B )
 
 
 /**
- * @brief Calculates the intensity in a system node.
- *
- * @todo Make it time/item dependent.
+ * @brief Checks to see if a system has a jump to another.
  */
-static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price )
+static int econ_hasJump( const StarSystem *A, const StarSystem *B )
 {
    int i;
-   double I;
-   double prodfactor, p;
-   double ddt;
+   for (i=0; i<A->njumps; i++)
+      if (A->jumps[i].target == B)
+         return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Gets a random mu within two-sigma for the production random walk.
+ *
+ * Uses its own xorshift generator so the economy doesn't change the gameplay
+ *  random sequence.
+ */
+static double econ_rand2Sigma (void)
+{
+   double u;
+
+   econ_rng ^= econ_rng << 13;
+   econ_rng ^= econ_rng >> 7;
+   econ_rng ^= econ_rng << 17;
+   u = (double)(econ_rng >> 11) / (double)(1ULL << 53);
+   return NormalInverse( 0.022750132 + u*(1.-0.022750132*2.) );
+}
+
+
+/**
+ * @brief Calculates the intensity of every system node for every commodity.
+ *
+ * Each inhabited planet produces the commodities it trades, based on the
+ *  sqrt of its population and a production factor that wanders randomly
+ *  around its base value.
+ *
+ *    @param[out] B Intensities, a row of k commodities per system.
+ *    @param k Number of commodities.
+ *    @param dt Time elapsed, 0 leaves the production factors untouched.
+ */
+static void econ_calcSysI( double *B, int k, ntime_t dt )
+{
+   int i, j, c, e;
+   double prodfactor, p, ddt;
+   StarSystem *sys;
    Planet *planet;
 
-   ddt = (double)(dt / NTIME_UNIT_LENGTH);
+   ddt = ntime_convertSeconds( dt ) / NT_PERIOD_SECONDS;
+
+   for (i=0; i<array_size(systems_stack); i++) {
+      sys = &systems_stack[i];
+      memset( &B[i*k], 0, k*sizeof(double) );
+
+      for (j=0; j<sys->nplanets; j++) {
+         planet = sys->planets[j];
+         if (!planet_hasService(planet, PLANET_SERVICE_INHABITED))
+            continue;
 
-   /* Calculate production level. */
-   p = 0.;
-   for (i=0; i<sys->nplanets; i++) {
-      planet = sys->planets[i];
-      if (planet_hasService(planet, PLANET_SERVICE_INHABITED)) {
          /*
           * Calculate production.
           */
          /* We base off the current production. */
-         prodfactor  = planet->cur_prodfactor;
-         /* Add a variability factor based on the Gaussian distribution. */
-         prodfactor += ECON_PROD_VAR * RNG_2SIGMA() * ddt;
-         /* Add a tendency to return to the planet's base production. */
-         prodfactor -= ECON_PROD_VAR *
-               (planet->cur_prodfactor - prodfactor)*ddt;
-         /* Save for next iteration. */
-         planet->cur_prodfactor = prodfactor;
+         prodfactor  = econ_prodfactor[ planet->id ];
+         if (ddt > 0.) {
+            /* Add a variability factor based on the Gaussian distribution. */
+            prodfactor += ECON_PROD_VAR * econ_rand2Sigma() * ddt;
+            /* Add a tendency to return to the planet's base production. */
+            prodfactor -= ECON_PROD_VAR * (prodfactor - 1.) * ddt;
+            /* Save for next iteration. */
+            econ_prodfactor[ planet->id ] = prodfactor;
+         }
          /* We base off the sqrt of the population otherwise it changes too fast. */
-         p += prodfactor * sqrt(planet->population);
+         p = prodfactor * sqrt(planet->population) / ECON_PROD_MODIFIER;
+
+         /* The intensity is basically the modified production. */
+         for (c=0; c<planet->ncommodities; c++) {
+            e = econ_index[ planet->commodities[c] - commodity_stack ];
+            if (e >= 0)
+               B[ i*k + e ] += p;
+         }
       }
    }
-
-   /* The intensity is basically the modified production. */
-   I = p / ECON_PROD_MODIFIER;
-
-   return I;
 }
 
 
 /**
  * @brief Creates the admittance matrix.
  *
- *    @return 0 on success.
+ *    @return The new matrix.
  */
-static int econ_createGMatrix (void)
+static cs* econ_createGMatrix (void)
 {
    int ret;
-   int i, j;
-   double R, Rsum;
-   cs *M;
-   StarSystem *sys;
+   int i, j, t, n;
+   double R;
+   cs *M, *G;
+   StarSystem *sys, *target;
 
    /* Create the matrix. */
-   M = cs_spalloc( array_size(systems_stack), array_size(systems_stack), 1, 1, 1 );
+   n = array_size(systems_stack);
+   M = cs_spalloc( n, n, 1, 1, 1 );
    if (M == NULL)
       ERR(_("Unable to create CSparse Matrix."));
 
    /* Fill the matrix. */
-   for (i=0; i < array_size(systems_stack); i++) {
-      sys   = &systems_stack[i];
-      Rsum = 0.;
+   for (i=0; i<n; i++) {
+      sys = &systems_stack[i];
+
+      /* We add a resistance for dampening, it keeps G positive definite. */
+      cs_entry( M, i, i, 1./ECON_SELF_RES );
+
+      for (j=0; j<sys->njumps; j++) {
+         target = sys->jumps[j].target;
+         t      = target->id;
 
-      /* Set some values. */
-      for (j=0; j < sys->njumps; j++) {
+         /* Add each route once even when both ends have the jump. */
+         if ((t == i) || ((t < i) && econ_hasJump( target, sys )))
+            continue;
 
          /* Get the resistances. */
-         R     = econ_calcJumpR( sys, sys->jumps[j].target );
-         R     = 1./R; /* Must be inverted. */
-         Rsum += R;
+         R = 1. / econ_calcJumpR( sys, target ); /* Must be inverted. */
 
          /* Matrix is symmetrical and non-diagonal is negative. */
-         ret = cs_entry( M, i, sys->jumps[j].target->id, -R );
-         if (ret != 1)
-            WARN(_("Unable to enter CSparse Matrix Cell."));
-         ret = cs_entry( M, sys->jumps[j].target->id, i, -R );
+         ret  = cs_entry( M, i, t, -R );
+         ret &= cs_entry( M, t, i, -R );
+         ret &= cs_entry( M, i, i, R );
+         ret &= cs_entry( M, t, t, R );
          if (ret != 1)
             WARN(_("Unable to enter CSparse Matrix Cell."));
       }
-
-      /* Set the diagonal. */
-      Rsum += 1./ECON_SELF_RES; /* We add a resistance for dampening. */
-      cs_entry( M, i, i, Rsum );
    }
 
-   /* Compress M matrix and put into G. */
-   cs_spfree( econ_G );
-   econ_G = cs_compress( M );
-   if (econ_G == NULL)
+   /* Compress M matrix and sum the duplicate entries. */
+   G = cs_compress( M );
+   if ((G == NULL) || !cs_dupl( G ))
       ERR(_("Unable to create economy G Matrix."));
 
    /* Clean up. */
    cs_spfree(M);
 
+   return G;
+}
+
+
+/**
+ * @brief Computes the Cholesky factorization of the admittance matrix.
+ *
+ *    @param G Matrix to factorize.
+ *    @param[out] S Symbolic analysis (fill-reducing ordering).
+ *    @param[out] N Numeric factorization.
+ *    @return 0 on success.
+ */
+static int econ_factor( const cs *G, css **S, csn **N )
+{
+   *S = cs_schol( 1, G );
+   *N = (*S == NULL) ? NULL : cs_chol( G, *S );
+   if (*N == NULL) {
+      cs_sfree( *S );
+      *S = NULL;
+      return -1;
+   }
    return 0;
 }
-#endif
+
+
+/**
+ * @brief Solves G X = B for all the commodities at once.
+ *
+ * Same as cs_ipvec, cs_lsolve, cs_ltsolve and cs_pvec, but walking each
+ *  column of L once for the whole block of right hand sides.
+ *
+ *    @param S Symbolic analysis of G.
+ *    @param N Cholesky factorization of G.
+ *    @param[in,out] B Right hand sides in, solutions out, n rows of k values.
+ *    @param n Number of systems.
+ *    @param k Number of commodities.
+ */
+static void econ_solveBlock( const css *S, const csn *N, double *B, int n, int k )
+{
+   int i, j, c, p, r;
+   double *X, *x, *y, d, l;
+   const cs *L = N->L;
+
+   X = malloc( n*k*sizeof(double) );
+
+   /* x = P b */
+   for (i=0; i<n; i++) {
+      r = (S->pinv != NULL) ? S->pinv[i] : i;
+      memcpy( &X[r*k], &B[i*k], k*sizeof(double) );
+   }
+
+   /* L y = x, diagonal is the first entry of each column. */
+   for (j=0; j<n; j++) {
+      x = &X[j*k];
+      d = L->x[ L->p[j] ];
+      for (c=0; c<k; c++)
+         x[c] /= d;
+      for (p=L->p[j]+1; p<L->p[j+1]; p++) {
+         y = &X[ L->i[p]*k ];
+         l = L->x[p];
+         for (c=0; c<k; c++)
+            y[c] -= l * x[c];
+      }
+   }
+
+   /* L' z = y */
+   for (j=n-1; j>=0; j--) {
+      x = &X[j*k];
+      for (p=L->p[j]+1; p<L->p[j+1]; p++) {
+         y = &X[ L->i[p]*k ];
+         l = L->x[p];
+         for (c=0; c<k; c++)
+            x[c] -= l * y[c];
+      }
+      d = L->x[ L->p[j] ];
+      for (c=0; c<k; c++)
+         x[c] /= d;
+   }
+
+   /* b = P' z */
+   for (i=0; i<n; i++) {
+      r = (S->pinv != NULL) ? S->pinv[i] : i;
+      memcpy( &B[i*k], &X[r*k], k*sizeof(double) );
+   }
+
+   free(X);
+}
+
+
+/**
+ * @brief Runs an economy solve, in the threadpool.
+ *
+ * Owns econ_G and its factorization until it's done.
+ */
+static int econ_solve( void *data )
+{
+   EconJob *job = (EconJob*) data;
+
+   /* Topology changed, factorize the new matrix. */
+   if (job->G != NULL) {
+      cs_nfree( econ_N );
+      cs_sfree( econ_S );
+      cs_spfree( econ_G );
+      econ_G  = job->G;
+      job->G  = NULL;
+      econ_N  = NULL;
+      econ_S  = NULL;
+      if (econ_factor( econ_G, &econ_S, &econ_N ))
+         WARN(_("Failed to factorize the Economy System."));
+   }
+
+   if (econ_N != NULL) {
+      econ_solveBlock( econ_S, econ_N, job->B, job->n, job->k );
+      job->ret = 0;
+   }
+   else
+      job->ret = -1;
+
+   SDL_AtomicSet( &job->done, 1 );
+   return job->ret;
+}
+
+
+/**
+ * @brief Starts solving the economy with the pending time in the threadpool.
+ */
+static void econ_launch (void)
+{
+   int i, n, k;
+   EconJob *job;
+
+   n = array_size(systems_stack);
+   k = array_size(econ_comm);
+   if ((n == 0) || (k == 0))
+      return;
+
+   job = calloc( 1, sizeof(EconJob) );
+   job->n = n;
+   job->k = k;
+   job->B = malloc( n*k*sizeof(double) );
+
+   /* New planets start at their base production. */
+   if (econ_prodfactor == NULL)
+      econ_prodfactor = array_create( double );
+   for (i=array_size(econ_prodfactor); i<array_size(planet_getAll()); i++)
+      array_push_back( &econ_prodfactor, 1. );
+
+   econ_calcSysI( job->B, k, econ_dt );
+   econ_dt = 0;
+
+   /* Rebuild the matrix only when the jumps changed. */
+   if (econ_dirty) {
+      job->G = econ_createGMatrix();
+      econ_dirty = 0;
+   }
+
+   econ_job = job;
+   threadpool_newJob( econ_solve, job );
+}
+
+
+/**
+ * @brief Stores the results of a finished solve in the system prices.
+ *
+ *    @param wait Whether to wait for a running solve to finish.
+ */
+static void econ_collect( int wait )
+{
+   int i, j;
+   double x, min, max;
+   EconJob *job = econ_job;
+
+   if (job == NULL)
+      return;
+   if (!SDL_AtomicGet( &job->done )) {
+      if (!wait)
+         return;
+      while (!SDL_AtomicGet( &job->done ))
+         SDL_Delay( 1 );
+   }
+   econ_job = NULL;
+
+   /* Discard results if the universe changed under the solve. */
+   if ((job->ret == 0) && (job->n == array_size(systems_stack))
+         && (job->k == array_size(econ_comm))) {
+      /*
+       * Potentials are scaled per commodity so the system with the biggest
+       * surplus sells ECON_PRICE_VAR cheaper and the one with the biggest
+       * shortage ECON_PRICE_VAR more expensive.
+       */
+      for (j=0; j<job->k; j++) {
+         min = +HUGE_VAL;
+         max = -HUGE_VAL;
+         for (i=0; i<job->n; i++) {
+            x   = job->B[i*job->k + j];
+            min = MIN( min, x );
+            max = MAX( max, x );
+         }
+         for (i=0; i<job->n; i++) {
+            if (systems_stack[i].prices == NULL)
+               continue;
+            x = (max > min) ? (job->B[i*job->k + j] - min) / (max - min) : 0.5;
+            systems_stack[i].prices[j] = 1. + ECON_PRICE_VAR * (1. - 2.*x);
+         }
+      }
+   }
+   else if (job->ret != 0)
+      WARN(_("Failed to solve the Economy System."));
+
+   cs_spfree( job->G );
+   free( job->B );
+   free( job );
+}
+
+
+#if DEBUGGING
+/**
+ * @brief Times the economy solvers on the current universe.
+ *
+ * Compares a QR solve per commodity (the old approach), a Cholesky
+ *  solve per commodity and the stored factorization with the blocked solve.
+ *
+ *    @param iter Number of solves to time.
+ */
+void economy_benchmark( int iter )
+{
+   int i, j, c, n, k;
+   double *B, *X, *R, err, freq;
+   Uint64 t0, t1, t2, t3, t4;
+   cs *G;
+   css *S;
+   csn *N;
+
+   n = array_size(systems_stack);
+   k = array_size(econ_comm);
+   if ((n == 0) || (k == 0) || (iter <= 0) || (econ_index == NULL))
+      return;
+
+   /* Make sure the solver isn't touching anything. */
+   econ_collect( 1 );
+   if (econ_prodfactor == NULL)
+      econ_prodfactor = array_create( double );
+   for (i=array_size(econ_prodfactor); i<array_size(planet_getAll()); i++)
+      array_push_back( &econ_prodfactor, 1. );
+
+   B = malloc( n*k*sizeof(double) );
+   econ_calcSysI( B, k, 0 );
+   X = malloc( n*k*sizeof(double) );
+   R = malloc( n*sizeof(double) );
+
+   freq = (double)SDL_GetPerformanceFrequency() / 1000.;
+   t0 = SDL_GetPerformanceCounter();
+   G = econ_createGMatrix();
+   t1 = SDL_GetPerformanceCounter();
+
+   /* QR per commodity. */
+   for (i=0; i<iter; i++) {
+      for (c=0; c<k; c++) {
+         for (j=0; j<n; j++)
+            R[j] = B[j*k+c];
+         cs_qrsol( 3, G, R );
+      }
+   }
+   t2 = SDL_GetPerformanceCounter();
+
+   /* Cholesky per commodity, refactoring every time. */
+   for (i=0; i<iter; i++) {
+      for (c=0; c<k; c++) {
+         for (j=0; j<n; j++)
+            R[j] = B[j*k+c];
+         cs_cholsol( 1, G, R );
+      }
+   }
+   t3 = SDL_GetPerformanceCounter();
+
+   /* Stored factorization, blocked solve. */
+   if (econ_factor( G, &S, &N )) {
+      WARN(_("Failed to factorize the Economy System."));
+      S = NULL;
+      N = NULL;
+   }
+   err = 0.;
+   for (i=0; (N != NULL) && (i<iter); i++) {
+      memcpy( X, B, n*k*sizeof(double) );
+      econ_solveBlock( S, N, X, n, k );
+   }
+   t4 = SDL_GetPerformanceCounter();
+
+   /* Check the blocked solve against the last QR solve. */
+   for (j=0; (N != NULL) && (j<n); j++)
+      err = MAX( err, fabs( X[j*k+k-1] - R[j] ) );
+
+   DEBUG(_("Economy benchmark: %d systems, %d commodities, %d iterations"), n, k, iter);
+   DEBUG(_("   G matrix: %.3f ms, %d non-zeros"), (double)(t1-t0)/freq, (int)G->p[n]);
+   DEBUG(_("   QR per commodity: %.3f ms/solve"), (double)(t2-t1)/freq/iter);
+   DEBUG(_("   Cholesky per commodity: %.3f ms/solve"), (double)(t3-t2)/freq/iter);
+   DEBUG(_("   Stored Cholesky, blocked: %.3f ms/solve (max error %g)"), (double)(t4-t3)/freq/iter, err);
+
+   cs_nfree( N );
+   cs_sfree( S );
+   cs_spfree( G );
+   free( B );
+   free( X );
+   free( R );
+}
+#endif /* DEBUGGING */
 
 
 /**
@@ -416,18 +777,27 @@ static int econ_createGMatrix (void)
  */
 int economy_init (void)
 {
-   int i;
+   int i, j;
 
    /* Must not be initialized. */
    if (econ_initialized)
       return 0;
 
-   /* Allocate price space. */
+   /* Allocate price space, prices are unchanged until the first solve. */
    for (i=0; i<array_size(systems_stack); i++) {
       free(systems_stack[i].prices);
-      systems_stack[i].prices = calloc(array_size(econ_comm), sizeof(double));
+      systems_stack[i].prices = malloc(array_size(econ_comm) * sizeof(double));
+      for (j=0; j<array_size(econ_comm); j++)
+         systems_stack[i].prices[j] = 1.;
    }
 
+   /* Map the commodities the planets trade to the ones being solved. */
+   econ_index = malloc( MAX(1,array_size(commodity_stack)) * sizeof(int) );
+   for (i=0; i<array_size(commodity_stack); i++)
+      econ_index[i] = -1;
+   for (i=0; i<array_size(econ_comm); i++)
+      econ_index[ econ_comm[i] ] = i;
+
    /* Mark economy as initialized. */
    econ_initialized = 1;
 
@@ -471,9 +841,8 @@ int economy_refresh (void)
    if (econ_initialized == 0)
       return 0;
 
-   /* Create the resistance matrix. */
-   //if (econ_createGMatrix())
-   //   return -1;
+   /* The jumps may have changed. */
+   econ_dirty = 1;
 
    /* Initialize the prices. */
    economy_update( 0 );
@@ -482,83 +851,40 @@ int economy_refresh (void)
 }
 
 
+/**
+ * @brief Marks the jump topology as changed so the admittance matrix gets
+ *  rebuilt and refactorized on the next solve.
+ */
+void economy_topologyChanged (void)
+{
+   econ_dirty = 1;
+}
+
+
 /**
  * @brief Updates the economy.
  *
+ * Stores the results of a finished solve and starts a new one in the
+ *  threadpool, so prices lag behind by one update.
+ *
  *    @param dt Deltatick in NTIME.
  */
 int economy_update( unsigned int dt )
 {
-   (void)dt;
-#if 0
-   int i, j;
-   double *X;
-   double scale, offset;
-   /*double min, max;*/
+   econ_queued = 0;
 
    /* Economy must be initialized. */
    if (econ_initialized == 0)
       return 0;
 
-   /* Create the vector to solve the system. */
-   X = malloc(sizeof(double)*array_size(systems_stack));
-   if (X == NULL) {
-      WARN(_("Out of Memory"));
-      return -1;
-   }
-
-   /* Calculate the results for each price set. */
-   for (j=0; j<array_size(econ_comm); j++) {
-
-
-      /* First we must load the vector with intensities. */
-      for (i=0; i<array_size(systems_stack); i++)
-         X[i] = econ_calcSysI( dt, &systems_stack[i], j );
-
-      /* Solve the system. */
-      /** @TODO This should be improved to try to use better factorizations (LU/Cholesky)
-       * if possible or just outright try to use some other library that does fancy stuff
-       * like UMFPACK. Would be also interesting to see if it could be optimized so we
-       * store the factorization or update that instead of handling it individually. Another
-       * point of interest would be to split loops out to make the solving faster, however,
-       * this may be trickier to do (although it would surely let us use cholesky always if we
-       * enforce that condition). */
-      ret = cs_qrsol( 3, econ_G, X );
-      if (ret != 1)
-         WARN(_("Failed to solve the Economy System."));
-
-      /*
-       * Get the minimum and maximum to scale.
-       */
-      /*
-      min = +HUGE_VALF;
-      max = -HUGE_VALF;
-      for (i=0; i<array_size(systems_stack); i++) {
-         if (X[i] < min)
-            min = X[i];
-         if (X[i] > max)
-            max = X[i];
-      }
-      scale = 1. / (max - min);
-      offset = 0.5 - min * scale;
-      */
-
-      /*
-       * I'm not sure I like the filtering of the results, but it would take
-       * much more work to get a good system working without the need of post
-       * filtering.
-       */
-      scale    = 1.;
-      offset   = 1.;
-      for (i=0; i<array_size(systems_stack); i++)
-         systems_stack[i].prices[j] = X[i] * scale + offset;
-   }
+   /* Pick up the previous solve. */
+   econ_collect( 0 );
 
-   /* Clean up. */
-   free(X);
+   /* Time keeps adding up while a solve is running. */
+   econ_dt += dt;
+   if (econ_job == NULL)
+      econ_launch();
 
-#endif
-   econ_queued = 0;
    return 0;
 }
 
@@ -574,6 +900,9 @@ void economy_destroy (void)
    if (!econ_initialized)
       return;
 
+   /* The solver may still be using the matrix. */
+   econ_collect( 1 );
+
    /* Clean up the prices in the systems stack. */
    for (i=0; i<array_size(systems_stack); i++) {
       free(systems_stack[i].prices);
@@ -581,13 +910,25 @@ void economy_destroy (void)
    }
 
    /* Destroy the economy matrix. */
+   cs_nfree( econ_N );
+   econ_N = NULL;
+   cs_sfree( econ_S );
+   econ_S = NULL;
    cs_spfree( econ_G );
    econ_G = NULL;
+   econ_dirty = 1;
+   array_free( econ_prodfactor );
+   econ_prodfactor = NULL;
+   free( econ_index );
+   econ_index = NULL;
+   econ_rng = ECON_RNG_SEED;
+   econ_dt = 0;
 
    /* Economy is now deinitialized. */
    econ_initialized = 0;
 }
 
+
 /**
  * @brief Used during startup to set price and variation of the economy, depending on planet information.
  *
@@ -687,8 +1028,12 @@ static void economy_modifySystemCommodityPrice(StarSystem *sys)
 {
    int i,j,k;
    Planet *planet;
-   CommodityPrice *avprice=NULL;
-   int nav=0;
+   CommodityPrice *avprice;
+   int nav;
+
+   /* Indexed by commodity, updateTime counts the planets selling it. */
+   nav=array_size(commodity_stack);
+   avprice=calloc( nav, sizeof(CommodityPrice) );
 
    for ( i=0; i<sys->nplanets; i++ ) {
       planet=sys->planets[i];
@@ -708,32 +1053,21 @@ static void economy_modifySystemCommodityPrice(StarSystem *sys)
             so shorter period.  Between 1 to 6 jumps.  Make the base time 1000.*/
          planet->commodityPrice[j].sysPeriod = 2000. / (sys->njumps + 1);
 
-         for ( k=0; k<nav; k++) {
-            if ( ( strcmp( planet->commodities[j]->name, avprice[k].name ) == 0 ) ) {
-               avprice[k].updateTime++;
-               avprice[k].price+=planet->commodityPrice[j].price;
-               avprice[k].planetPeriod+=planet->commodityPrice[j].planetPeriod;
-               avprice[k].sysPeriod+=planet->commodityPrice[j].sysPeriod;
-               avprice[k].planetVariation+=planet->commodityPrice[j].planetVariation;
-               avprice[k].sysVariation+=planet->commodityPrice[j].sysVariation;
-               break;
-            }
-         }
-         if ( k == nav ) {/* first visit of this commodity for this system */
-            nav++;
-            avprice=realloc( avprice, nav * sizeof(CommodityPrice) );
+         k = planet->commodities[j] - commodity_stack;
+         if ( avprice[k].updateTime == 0 ) /* first visit of this commodity for this system */
             avprice[k].name=planet->commodities[j]->name;
-            avprice[k].updateTime=1;
-            avprice[k].price=planet->commodityPrice[j].price;
-            avprice[k].planetPeriod=planet->commodityPrice[j].planetPeriod;
-            avprice[k].sysPeriod=planet->commodityPrice[j].sysPeriod;
-            avprice[k].planetVariation=planet->commodityPrice[j].planetVariation;
-            avprice[k].sysVariation=planet->commodityPrice[j].sysVariation;
-         }
+         avprice[k].updateTime++;
+         avprice[k].price+=planet->commodityPrice[j].price;
+         avprice[k].planetPeriod+=planet->commodityPrice[j].planetPeriod;
+         avprice[k].sysPeriod+=planet->commodityPrice[j].sysPeriod;
+         avprice[k].planetVariation+=planet->commodityPrice[j].planetVariation;
+         avprice[k].sysVariation+=planet->commodityPrice[j].sysVariation;
       }
    }
    /* Do some inter-planet averaging */
    for ( k=0; k<nav; k++ ) {
+      if ( avprice[k].updateTime == 0 )
+         continue;
       avprice[k].price/=avprice[k].updateTime;
       avprice[k].planetPeriod/=avprice[k].updateTime;
       avprice[k].sysPeriod/=avprice[k].updateTime;
@@ -744,15 +1078,13 @@ static void economy_modifySystemCommodityPrice(StarSystem *sys)
    for ( i=0; i<sys->nplanets; i++ ) {
       planet=sys->planets[i];
       for ( j=0; j<planet->ncommodities; j++ ) {
-         for ( k=0; k<nav; k++ ) {
-            if ( ( strcmp( planet->commodities[j]->name, avprice[k].name ) == 0 ) ) {
-               planet->commodityPrice[j].price*=0.25;
-               planet->commodityPrice[j].price+=0.75*avprice[k].price;
-               planet->commodityPrice[j].sysVariation=0.2*avprice[k].planetVariation;
-            }
-         }
+         k = planet->commodities[j] - commodity_stack;
+         planet->commodityPrice[j].price*=0.25;
+         planet->commodityPrice[j].price+=0.75*avprice[k].price;
+         planet->commodityPrice[j].sysVariation=0.2*avprice[k].planetVariation;
       }
    }
+   free( sys->averagePrice );
    sys->averagePrice=avprice;
    sys->ncommodities=nav;
 }
@@ -769,21 +1101,20 @@ static void economy_smoothCommodityPrice(StarSystem *sys)
    int nav=sys->ncommodities;
    CommodityPrice *avprice=sys->averagePrice;
    double price;
-   int n,i,j,k;
+   int n,i,j;
    /*Now modify based on neighbouring systems */
    /*First, calculate mean price of neighbouring systems */
 
    for ( j =0; j<nav; j++ ) {/* for each commodity in this system */
+      if ( avprice[j].updateTime == 0 )
+         continue;
       price=0.;
       n=0;
       for ( i=0; i<sys->njumps; i++ ) {/* for each neighbouring system */
          neighbour=sys->jumps[i].target;
-         for ( k=0; k<neighbour->ncommodities; k++ ) {
-            if ( ( strcmp( neighbour->averagePrice[k].name, avprice[j].name ) == 0 ) ) {
-               price+=neighbour->averagePrice[k].price;
-               n++;
-               break;
-            }
+         if ( neighbour->averagePrice[j].updateTime > 0 ) {
+            price+=neighbour->averagePrice[j].price;
+            n++;
          }
       }
       if (n!=0)
@@ -812,19 +1143,15 @@ static void economy_calcUpdatedCommodityPrice(StarSystem *sys)
    for ( i=0; i<sys->nplanets; i++ ) {
       planet=sys->planets[i];
       for ( j=0; j<planet->ncommodities; j++ ) {
-         for ( k=0; k<nav; k++ ) {
-            if ( ( strcmp(avprice[k].name, planet->commodities[j]->name) == 0 ) ) {
-               planet->commodityPrice[j].price = (
-                     0.25*planet->commodityPrice[j].price
-                        + 0.75*avprice[k].price );
-               planet->commodityPrice[j].planetVariation = (
-                     0.1 * (0.5*avprice[k].planetVariation
-                           + 0.5*planet->commodityPrice[j].planetVariation) );
-               planet->commodityPrice[j].planetVariation *= planet->commodityPrice[j].price;
-               planet->commodityPrice[j].sysVariation *= planet->commodityPrice[j].price;
-               break;
-            }
-         }
+         k = planet->commodities[j] - commodity_stack;
+         planet->commodityPrice[j].price = (
+               0.25*planet->commodityPrice[j].price
+                  + 0.75*avprice[k].price );
+         planet->commodityPrice[j].planetVariation = (
+               0.1 * (0.5*avprice[k].planetVariation
+                     + 0.5*planet->commodityPrice[j].planetVariation) );
+         planet->commodityPrice[j].planetVariation *= planet->commodityPrice[j].price;
+         planet->commodityPrice[j].sysVariation *= planet->commodityPrice[j].price;
       }
    }
    free( sys->averagePrice );
@@ -916,7 +1243,9 @@ void economy_averageSeenPrices( const Planet *p )
    Commodity *c;
    CommodityPrice *cp;
    credits_t price;
+   StarSystem *sys;
    t = ntime_get();
+   sys = system_get( planet_getSystem( p->name ) );
    for ( i = 0 ; i < p->ncommodities ; i++ ) {
       c=p->commodities[i];
       cp=&p->commodityPrice[i];
@@ -924,7 +1253,7 @@ void economy_averageSeenPrices( const Planet *p )
          cp->updateTime = t;
          /* Calculate values for mean and std */
          cp->cnt++;
-         price = economy_getPrice(c, NULL, p);
+         price = economy_getPrice(c, sys, p);
          cp->sum += price;
          cp->sum2 += price*price;
       }
@@ -939,14 +1268,16 @@ void economy_averageSeenPricesAtTime( const Planet *p, const ntime_t tupdate )
    Commodity *c;
    CommodityPrice *cp;
    credits_t price;
+   StarSystem *sys;
    t = ntime_get();
+   sys = system_get( planet_getSystem( p->name ) );
    for ( i = 0 ; i < p->ncommodities ; i++ ) {
       c=p->commodities[i];
       cp=&p->commodityPrice[i];
       if ( cp->updateTime < t ) { /* has not yet been updated at present time. */
          cp->updateTime = t;
          cp->cnt++;
-         price = economy_getPriceAtTime(c, NULL, p, tupdate);
+         price = economy_getPriceAtTime(c, sys, p, tupdate);
          cp->sum += price;
          cp->sum2 += price*price;
       }
@@ -21,9 +21,13 @@ void economy_addQueuedUpdate (void);
 int economy_execQueued (void);
 int economy_update( unsigned int dt );
 int economy_refresh (void);
+void economy_topologyChanged (void);
 void economy_destroy (void);
 void economy_clearKnown (void);
 void economy_clearSinglePlanet(Planet *p);
+#if DEBUGGING
+void economy_benchmark( int iter );
+#endif /* DEBUGGING */
 
 /*
  * Price stuff.
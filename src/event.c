@@ -65,6 +65,7 @@ typedef struct EventData_ {
 
    EventTrigger_t trigger; /**< What triggers the event. */
    char *cond; /**< Conditional Lua code to execute. */
+   int cond_chunk; /**< Compiled conditional, LUA_NOREF until first checked. */
    double chance; /**< Chance of appearing. */
    int priority; /**< Event priority: 0 = main plot, 5 = default, 10 = insignificant. */
 } EventData;
@@ -406,7 +407,9 @@ void events_trigger( EventTrigger_t trigger )
 
       /* Test conditional. */
       if (event_data[i].cond != NULL) {
-         c = cond_check(event_data[i].cond);
+         if (event_data[i].cond_chunk == LUA_NOREF)
+            event_data[i].cond_chunk = cond_compile( event_data[i].cond );
+         c = cond_checkChunk( event_data[i].cond_chunk );
          if (c<0) {
             WARN(_("Conditional for event '%s' failed to run."), event_data[i].name);
             continue;
@@ -439,6 +442,7 @@ static int event_parseXML( EventData *temp, const xmlNodePtr parent )
    char *buf;
 
    memset( temp, 0, sizeof(EventData) );
+   temp->cond_chunk = LUA_NOREF;
 
    /* get the name */
    xmlr_attr_strd(parent, "name", temp->name);
@@ -646,6 +650,7 @@ static void event_freeData( EventData *event )
    free( event->lua );
    free( event->sourcefile );
    free( event->cond );
+   cond_freeChunk( event->cond_chunk );
 #if DEBUGGING
    memset( event, 0, sizeof(EventData) );
 #endif /* DEBUGGING */
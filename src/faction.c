@@ -23,6 +23,7 @@
 #include "hook.h"
 #include "log.h"
 #include "ndata.h"
+#include "nhash.h"
 #include "nlua.h"
 #include "nluadef.h"
 #include "nxml.h"
@@ -46,6 +47,10 @@
 #define faction_isFlag(fa,f)  ((fa)->flags & (f))
 #define faction_isKnown_(fa)   ((fa)->flags & (FACTION_KNOWN))
 
+#define FACTION_GRID_BITS     (8*sizeof(unsigned int)) /**< Bits per word of the relation grids. */
+#define faction_gridTest(g,a,b) \
+   ((g)[(a)*faction_gridw + (b)/FACTION_GRID_BITS] & (1u << ((b)%FACTION_GRID_BITS))) /**< Tests a relation bit. */
+
 /**
  * @struct Faction
  *
@@ -87,6 +92,17 @@ typedef struct Faction_ {
 } Faction;
 
 static Faction* faction_stack = NULL; /**< Faction stack. */
+static NameHash faction_names; /**< Name index of the faction stack. */
+
+/*
+ * Relation grids, bit (a,b) is set if either faction lists the other. They
+ * mirror the enemies/allies arrays so areEnemies and areAllies don't have to
+ * search them.
+ */
+static unsigned int *faction_enemygrid = NULL; /**< Enemy bit matrix. */
+static unsigned int *faction_allygrid  = NULL; /**< Ally bit matrix. */
+static int faction_gridn = 0; /**< Number of factions covered by the grids. */
+static int faction_gridw = 0; /**< Words per row of the grids. */
 
 
 /*
@@ -94,6 +110,10 @@ static Faction* faction_stack = NULL; /**< Faction stack. */
  */
 /* static */
 static int faction_getRaw( const char *name );
+static void faction_indexNames (void);
+static void faction_computeGrid (void);
+static void faction_gridSet( unsigned int *grid, int a, int b, int set );
+static int faction_listHas( const int *list, int o );
 static void faction_freeOne( Faction *f );
 static void faction_sanitizePlayer( Faction* faction );
 static void faction_modPlayerLua( int f, double mod, const char *source, int secondary );
@@ -118,17 +138,99 @@ static int faction_getRaw( const char* name )
       return FACTION_PLAYER;
 
    if (name != NULL) {
-      for (i=0; i<array_size(faction_stack); i++)
-         if (strcmp(faction_stack[i].name, name)==0)
-            break;
-
-      if (i != array_size(faction_stack))
+      i = nhash_get( &faction_names, name );
+      if (i >= 0)
          return i;
    }
    return -1;
 }
 
 
+/**
+ * @brief Rebuilds the name index of the faction stack.
+ */
+static void faction_indexNames (void)
+{
+   int i;
+
+   nhash_clear( &faction_names );
+   for (i=0; i<array_size(faction_stack); i++)
+      nhash_add( &faction_names, faction_stack[i].name, i );
+}
+
+
+/**
+ * @brief Sets or clears a symmetric relation in a grid.
+ */
+static void faction_gridSet( unsigned int *grid, int a, int b, int set )
+{
+   unsigned int m;
+
+   /* Not covered yet, will be picked up when the grid is recomputed. */
+   if ((grid == NULL) || (a >= faction_gridn) || (b >= faction_gridn))
+      return;
+
+   if (set) {
+      m = 1u << (b%FACTION_GRID_BITS);
+      grid[ a*faction_gridw + b/FACTION_GRID_BITS ] |= m;
+      m = 1u << (a%FACTION_GRID_BITS);
+      grid[ b*faction_gridw + a/FACTION_GRID_BITS ] |= m;
+   }
+   else {
+      m = 1u << (b%FACTION_GRID_BITS);
+      grid[ a*faction_gridw + b/FACTION_GRID_BITS ] &= ~m;
+      m = 1u << (a%FACTION_GRID_BITS);
+      grid[ b*faction_gridw + a/FACTION_GRID_BITS ] &= ~m;
+   }
+}
+
+
+/**
+ * @brief Checks to see if a faction list contains a faction.
+ */
+static int faction_listHas( const int *list, int o )
+{
+   int i;
+   for (i=0; i<array_size(list); i++)
+      if (list[i] == o)
+         return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Recomputes the relation grids from the enemies and allies lists.
+ *
+ * Has to be called whenever the faction stack changes size.
+ */
+static void faction_computeGrid (void)
+{
+   int i, j, n;
+   Faction *f;
+
+   free( faction_enemygrid );
+   free( faction_allygrid );
+
+   n = array_size(faction_stack);
+   faction_gridn = n;
+   faction_gridw = (n + FACTION_GRID_BITS - 1) / FACTION_GRID_BITS;
+   faction_enemygrid = calloc( MAX(1, n*faction_gridw), sizeof(unsigned int) );
+   faction_allygrid  = calloc( MAX(1, n*faction_gridw), sizeof(unsigned int) );
+   if ((faction_enemygrid == NULL) || (faction_allygrid == NULL))
+      ERR(_("Out of Memory"));
+
+   for (i=0; i<n; i++) {
+      f = &faction_stack[i];
+      for (j=0; j<array_size(f->enemies); j++)
+         if (faction_isFaction(f->enemies[j]) && (f->enemies[j] != i))
+            faction_gridSet( faction_enemygrid, i, f->enemies[j], 1 );
+      for (j=0; j<array_size(f->allies); j++)
+         if (faction_isFaction(f->allies[j]) && (f->allies[j] != i))
+            faction_gridSet( faction_allygrid, i, f->allies[j], 1 );
+   }
+}
+
+
 /**
  * @brief Checks to see if a faction exists by name.
  *
@@ -512,6 +614,7 @@ void faction_addEnemy( int f, int o )
 
    tmp = &array_grow( &ff->enemies );
    *tmp = o;
+   faction_gridSet( faction_enemygrid, f, o, 1 );
 }
 
 
@@ -538,6 +641,9 @@ void faction_rmEnemy( int f, int o )
    for (i=0;i<array_size(ff->enemies);i++) {
       if (ff->enemies[i] == o) {
          array_erase( &ff->enemies, &ff->enemies[i], &ff->enemies[i+1] );
+         /* Still enemies if the other side lists us. */
+         if (faction_isFaction(o) && !faction_listHas( faction_stack[o].enemies, f ))
+            faction_gridSet( faction_enemygrid, f, o, 0 );
          return;
       }
    }
@@ -586,6 +692,7 @@ void faction_addAlly( int f, int o )
 
    tmp = &array_grow( &ff->allies );
    *tmp = o;
+   faction_gridSet( faction_allygrid, f, o, 1 );
 }
 
 
@@ -612,6 +719,9 @@ void faction_rmAlly( int f, int o )
    for (i=0;i<array_size(ff->allies);i++) {
       if (ff->allies[i] == o) {
          array_erase( &ff->allies, &ff->allies[i], &ff->allies[i+1] );
+         /* Still allies if the other side lists us. */
+         if (faction_isFaction(o) && !faction_listHas( faction_stack[o].allies, f ))
+            faction_gridSet( faction_allygrid, f, o, 0 );
          return;
       }
    }
@@ -1141,23 +1251,16 @@ const char *faction_getStandingBroad( int f, int bribed, int override )
  */
 int areEnemies( int a, int b)
 {
-   Faction *fa, *fb;
-   int i;
-
    if (a==b) return 0; /* luckily our factions aren't masochistic */
 
    /* handle a */
-   if (faction_isFaction(a))
-      fa = &faction_stack[a];
-   else { /* a is invalid */
+   if (!faction_isFaction(a)) { /* a is invalid */
       WARN(_("Faction id '%d' is invalid."), a);
       return 0;
    }
 
    /* handle b */
-   if (faction_isFaction(b))
-      fb = &faction_stack[b];
-   else { /* b is invalid */
+   if (!faction_isFaction(b)) { /* b is invalid */
       WARN(_("Faction id '%d' is invalid."), b);
       return 0;
    }
@@ -1170,14 +1273,7 @@ int areEnemies( int a, int b)
       return faction_isPlayerEnemy(a);
    }
 
-   for (i=0;i<array_size(fa->enemies);i++)
-      if (fa->enemies[i] == b)
-         return 1;
-   for (i=0;i<array_size(fb->enemies);i++)
-      if (fb->enemies[i] == a)
-         return 1;
-
-   return 0;
+   return faction_gridTest( faction_enemygrid, a, b ) != 0;
 }
 
 
@@ -1190,24 +1286,17 @@ int areEnemies( int a, int b)
  */
 int areAllies( int a, int b )
 {
-   Faction *fa, *fb;
-   int i;
-
    /* If they are the same they must be allies. */
    if (a==b) return 1;
 
    /* handle a */
-   if (faction_isFaction(a))
-      fa = &faction_stack[a];
-   else { /* a is invalid */
+   if (!faction_isFaction(a)) { /* a is invalid */
       WARN(_("Faction id '%d' is invalid."), a);
       return 0;
    }
 
    /* handle b */
-   if (faction_isFaction(b))
-      fb = &faction_stack[b];
-   else { /* b is invalid */
+   if (!faction_isFaction(b)) { /* b is invalid */
       WARN(_("Faction id '%d' is invalid."), b);
       return 0;
    }
@@ -1220,15 +1309,85 @@ int areAllies( int a, int b )
       return faction_isPlayerFriend(a);
    }
 
-   for (i=0;i<array_size(fa->allies);i++)
-      if (fa->allies[i] == b)
-         return 1;
-   for (i=0;i<array_size(fb->allies);i++)
-      if (fb->allies[i] == a)
-         return 1;
+   return faction_gridTest( faction_allygrid, a, b ) != 0;
+}
 
-   return 0;
+
+#if DEBUGGING
+/**
+ * @brief Times the relation grids against searching the relation lists.
+ *
+ * Every pair of non-player factions is checked with both, any mismatch is
+ *  reported.
+ *
+ *    @param iter Number of rounds over all the pairs.
+ */
+void faction_benchmark( int iter )
+{
+   int i, a, b, n, e, l, bad, sum;
+   double freq;
+   Uint64 t0, t1, t2;
+   Faction *fa, *fb;
+
+   n = array_size(faction_stack);
+   if ((n < 2) || (iter <= 0))
+      return;
+
+   /* Check they agree. */
+   bad = 0;
+   for (a=0; a<n; a++) {
+      for (b=0; b<n; b++) {
+         if ((a == b) || (a == FACTION_PLAYER) || (b == FACTION_PLAYER))
+            continue;
+         fa = &faction_stack[a];
+         fb = &faction_stack[b];
+         e  = faction_listHas( fa->enemies, b ) || faction_listHas( fb->enemies, a );
+         l  = faction_listHas( fa->allies, b ) || faction_listHas( fb->allies, a );
+         if ((e != areEnemies( a, b )) || (l != areAllies( a, b )))
+            bad++;
+      }
+   }
+
+   freq = (double)SDL_GetPerformanceFrequency() / 1e9;
+   sum  = 0;
+
+   /* Searching the lists, as done before the grids. */
+   t0 = SDL_GetPerformanceCounter();
+   for (i=0; i<iter; i++) {
+      for (a=1; a<n; a++) {
+         fa = &faction_stack[a];
+         for (b=1; b<n; b++) {
+            if (a == b)
+               continue;
+            fb = &faction_stack[b];
+            sum += faction_listHas( fa->enemies, b ) || faction_listHas( fb->enemies, a );
+            sum += faction_listHas( fa->allies, b ) || faction_listHas( fb->allies, a );
+         }
+      }
+   }
+   t1 = SDL_GetPerformanceCounter();
+
+   /* Relation grids. */
+   for (i=0; i<iter; i++) {
+      for (a=1; a<n; a++) {
+         for (b=1; b<n; b++) {
+            if (a == b)
+               continue;
+            sum += areEnemies( a, b );
+            sum += areAllies( a, b );
+         }
+      }
+   }
+   t2 = SDL_GetPerformanceCounter();
+
+   i = iter * (n-1) * (n-2);
+   DEBUG(_("Faction relation benchmark: %d factions, %d iterations, checksum %d"), n, iter, sum);
+   DEBUG(_("   Relation lists: %.1f ns/pair"), (double)(t1-t0)/freq/i);
+   DEBUG(_("   Relation grids: %.1f ns/pair"), (double)(t2-t1)/freq/i);
+   if (bad > 0)
+      WARN(_("Relation grids disagree with the relation lists for %d pairs!"), bad);
 }
+#endif /* DEBUGGING */
 
 
 /**
@@ -1526,6 +1685,7 @@ int factions_load (void)
          f->oflags = f->flags;
       }
    } while (xml_nextNode(node));
+   faction_indexNames();
 
    /* Second pass - sets allies and enemies */
    node = factions;
@@ -1572,6 +1732,9 @@ int factions_load (void)
 
    xmlFreeDoc(doc);
 
+   /* Set up the relation grids. */
+   faction_computeGrid();
+
    DEBUG( n_( "Loaded %d Faction", "Loaded %d Factions", array_size(faction_stack) ), array_size(faction_stack) );
 
    return 0;
@@ -1612,6 +1775,14 @@ void factions_free (void)
       faction_freeOne( &faction_stack[i] );
    array_free(faction_stack);
    faction_stack = NULL;
+   nhash_free(&faction_names);
+
+   free(faction_enemygrid);
+   free(faction_allygrid);
+   faction_enemygrid = NULL;
+   faction_allygrid  = NULL;
+   faction_gridn     = 0;
+   faction_gridw     = 0;
 }
 
 
@@ -1772,6 +1943,10 @@ void factions_clearDynamic (void)
          i--;
       }
    }
+
+   /* Indices have shifted. */
+   faction_indexNames();
+   faction_computeGrid();
 }
 
 
@@ -1799,6 +1974,7 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
    f->env         = LUA_NOREF;
    f->sched_env   = LUA_NOREF;
    f->flags       = FACTION_STATIC | FACTION_INVISIBLE | FACTION_DYNAMIC | FACTION_KNOWN;
+   nhash_add( &faction_names, f->name, f-faction_stack );
    if (base>=0) {
       bf = &faction_stack[base];
 
@@ -1811,11 +1987,11 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
 
       for (i=0; i<array_size(bf->allies); i++) {
          tmp = &array_grow( &f->allies );
-         *tmp = i;
+         *tmp = bf->allies[i];
       }
       for (i=0; i<array_size(bf->enemies); i++) {
          tmp = &array_grow( &f->enemies );
-         *tmp = i;
+         *tmp = bf->enemies[i];
       }
 
       f->player_def = bf->player_def;
@@ -1826,5 +2002,8 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
       f->equip_env = bf->equip_env;
    }
 
+   /* The stack grew. */
+   faction_computeGrid();
+
    return f-faction_stack;
 }
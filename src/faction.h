@@ -62,6 +62,9 @@ char faction_getColourChar( int f );
 /* works with only factions */
 int areEnemies( int a, int b );
 int areAllies( int a, int b );
+#if DEBUGGING
+void faction_benchmark( int iter );
+#endif /* DEBUGGING */
 
 /* load/free */
 int factions_load (void);
@@ -39,6 +39,8 @@
 #define HASH_LUT_SIZE 512 /**< Size of glyph look up table. */
 #define DEFAULT_TEXTURE_SIZE 1024 /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_RUN_CACHE_SIZE 512 /**< Number of slots in the text run cache. */
+#define FONT_MEMO_SIZE 256 /**< Number of slots in the width/height memo caches. */
 
 
 /**
@@ -137,8 +139,6 @@ typedef struct glFontStash_s {
    int tw; /**< Width of textures. */
    int th; /**< Height of textures. */
    glFontTex *tex; /**< Textures. */
-   gl_vbo *vbo_tex; /**< VBO associated to texture coordinates. */
-   gl_vbo *vbo_vert; /**< VBO associated to vertex coordinates. */
    GLfloat *vbo_tex_data; /**< Copy of texture coordinate data. */
    GLshort *vbo_vert_data; /**< Copy of vertex coordinate data. */
    int nvbo; /**< Amount of vbo data. */
@@ -152,6 +152,52 @@ typedef struct glFontStash_s {
    int refcount; /**< Reference counting. */
 } glFontStash;
 
+
+/**
+ * @brief Part of a text run drawn with a single texture and colour.
+ */
+typedef struct glFontRunSeg_s {
+   GLint first; /**< First vertex of the segment. */
+   GLsizei count; /**< Number of vertices in the segment. */
+   int tex_index; /**< Texture of the stash to use. */
+   int setcol; /**< Whether a colour code precedes the segment. */
+   const glColour *col; /**< Colour set by the code (NULL means base colour). */
+} glFontRunSeg;
+
+
+/**
+ * @brief Cached glyph quads of a piece of text.
+ *
+ * Positions are in distance field units relative to the pen start, so the
+ * run can be drawn anywhere with the projection set up by
+ * gl_fontRenderStart().
+ */
+typedef struct glFontRun_s {
+   int stash; /**< Stash index + 1, 0 if the slot is empty. */
+   int state_in; /**< Escape state at the start of the run. */
+   uint32_t hash; /**< Hash of the text. */
+   size_t len; /**< Length of the text. */
+   char *text; /**< Copy of the text. */
+   gl_vbo *vbo; /**< Positions followed by texture coordinates. */
+   GLsizei nvert; /**< Number of vertices. */
+   glFontRunSeg *segs; /**< Segments to draw (array.h). */
+   int state_out; /**< Escape state at the end of the run. */
+   int setcol; /**< Whether the run contains colour codes. */
+   const glColour *lastcol; /**< Last colour set by a code. */
+} glFontRun;
+
+
+/**
+ * @brief Memoized text metric.
+ */
+typedef struct glFontMemo_s {
+   int stash; /**< Stash index + 1, 0 if the slot is empty. */
+   int width; /**< Wrapping width used. */
+   uint32_t hash; /**< Hash of the text. */
+   char *text; /**< Copy of the text. */
+   int value; /**< Memoized result. */
+} glFontMemo;
+
 /**
  * Available fonts stashes.
  */
@@ -168,6 +214,13 @@ static const glColour *font_lastCol    = NULL; /**< Stores last colour used (act
 static int font_restoreLast      = 0; /**< Restore last colour. */
 
 
+/* Text caches. */
+static glFontRun font_runs[ FONT_RUN_CACHE_SIZE ]; /**< Cached text runs, direct mapped. */
+static GLfloat *font_runData = NULL; /**< Scratch buffer for building runs (array.h). */
+static glFontMemo font_memoWidth[ FONT_MEMO_SIZE ]; /**< Memoized gl_printWidthRaw results. */
+static glFontMemo font_memoHeight[ FONT_MEMO_SIZE ]; /**< Memoized gl_printHeightRaw results. */
+
+
 /*
  * prototypes
  */
@@ -176,14 +229,16 @@ static size_t font_limitSize( glFontStash *stsh, int *width, const char *text, c
 static const glColour* gl_fontGetColour( uint32_t ch );
 /* Get unicode glyphs from cache. */
 static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
-/* Render.
- * TODO this should be changed to be more like font-stash (https://github.com/akrinke/Font-Stash)
- * In particular, instead of writing char by char, they should be batched up by textures and rendered
- * when gl_fontRenderEnd() is called, saving lots of opengl calls.
- */
+/* Render. */
 static void gl_fontRenderStart( const glFontStash *stsh, double x, double y, const glColour *c, double outlineR );
-static int gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch, const glColour *c, int state );
+static int gl_fontRenderText( glFontStash *stsh, const char *text, size_t len, const glColour *c, int state );
 static void gl_fontRenderEnd (void);
+/* Text caches. */
+static uint32_t font_hashText( const char *text, size_t len );
+static glFontRun* gl_fontGetRun( glFontStash *stsh, const char *text, size_t len, int state );
+static void gl_fontBuildRun( glFontStash *stsh, glFontRun *run );
+static glFontMemo* gl_fontGetMemo( glFontMemo *memo, const glFontStash *stsh, int width, const char *text, int *found );
+static void gl_fontFlushCache( const glFontStash *stsh );
 /* Fussy layout concerns. */
 static void gl_fontKernStart (void);
 static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph );
@@ -359,10 +414,6 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    vbo_vert[ 5 ] = vy;
    vbo_vert[ 6 ] = vx+vw; /* Bottom right. */
    vbo_vert[ 7 ] = vy;
-   /* Update vbos. */
-   gl_vboData( stsh->vbo_tex,  sizeof(GLfloat)*n,  stsh->vbo_tex_data );
-   gl_vboData( stsh->vbo_vert, sizeof(GLshort)*n, stsh->vbo_vert_data );
-
    /* Add space for the new character. */
    gr->x += ch->w;
 
@@ -370,10 +421,6 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    glyph->vbo_id = (n-8)/2;
    glyph->tex_index = tex - stsh->tex;
 
-   /* Since the VBOs have possibly changed, we have to reset the data. */
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2, GL_SHORT, 0 );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2, GL_FLOAT, 0 );
-
    return 0;
 }
 
@@ -617,20 +664,13 @@ int gl_printWidthForText( const glFont *ft_font, const char *text,
 void gl_printRaw( const glFont *ft_font, double x, double y, const glColour* c,
       double outlineR, const char *text )
 {
-   int s;
-   size_t i;
-   uint32_t ch;
-
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
    /* Render it. */
-   s = 0;
-   i = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   while ((ch = u8_nextchar( text, &i )))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   gl_fontRenderText( stsh, text, strlen(text), c, 0 );
    gl_fontRenderEnd();
 }
 
@@ -692,9 +732,7 @@ void gl_print( const glFont *ft_font,
 int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
       const glColour* c, double outlineR, const char *text)
 {
-   int s;
-   size_t ret, i;
-   uint32_t ch;
+   size_t ret;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
@@ -704,11 +742,8 @@ int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
    ret = font_limitSize( stsh, NULL, text, max );
 
    /* Render it. */
-   s = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   i = 0;
-   while ((ch = u8_nextchar( text, &i )) && (i <= ret))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   gl_fontRenderText( stsh, text, ret, c, 0 );
    gl_fontRenderEnd();
 
    return ret;
@@ -767,9 +802,8 @@ int gl_printMidRaw(
       const char *text
       )
 {
-   int n, s;
-   size_t ret, i;
-   uint32_t ch;
+   int n;
+   size_t ret;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
@@ -781,11 +815,8 @@ int gl_printMidRaw(
    x += (double)(width - n)/2.;
 
    /* Render it. */
-   s = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   i = 0;
-   while ((ch = u8_nextchar( text, &i )) && (i <= ret))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   gl_fontRenderText( stsh, text, ret, c, 0 );
    gl_fontRenderEnd();
 
    return ret;
@@ -850,8 +881,8 @@ int gl_printTextRaw( const glFont *ft_font,
 {
    int p, s, l, lp;
    double x,y;
-   size_t i, ret;
-   uint32_t ch;
+   size_t ret;
+   char ch;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
@@ -868,7 +899,6 @@ int gl_printTextRaw( const glFont *ft_font,
    gl_printRestoreClear();
 
    ch = text[0]; /* In case of a 0-width first line (ret==p) below, we just care if text is empty or not. */
-   i = 0;
    s = 0;
    lp = 0;
    p = 0; /* where we last drew up to */
@@ -882,15 +912,14 @@ int gl_printTextRaw( const glFont *ft_font,
 
       /* Render it. */
       gl_fontRenderStart( stsh, x, y, c, outlineR );
-      for (i=p; i<ret; ) {
-         ch = u8_nextchar( text, &i);
-         s = gl_fontRenderGlyph( stsh, ch, c, s );
-      }
+      s = gl_fontRenderText( stsh, &text[p], ret-p, c, s );
       gl_fontRenderEnd();
 
+      if (ret > (size_t)p)
+         ch = text[ret-1];
       if (ch == '\0')
          break;
-      p = i;
+      p = ret;
       if ((text[p] == '\n') || (text[p] == ' '))
          p++; /* Skip "empty char". */
       y -= line_height; /* move position down */
@@ -952,11 +981,18 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
    GLfloat n;
    size_t i;
    uint32_t ch;
+   int found;
+   glFontMemo *memo;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   /* Layout code asks for the same strings over and over. */
+   memo = gl_fontGetMemo( font_memoWidth, stsh, 0, text, &found );
+   if (found)
+      return memo->value;
+
    gl_fontKernStart();
    n = 0.;
    i = 0;
@@ -974,7 +1010,8 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
       n += gl_fontKernGlyph( stsh, ch, glyph ) + glyph->adv_x;
    }
 
-   return (int)round(n);
+   memo->value = (int)round(n);
+   return memo->value;
 }
 
 
@@ -1016,8 +1053,9 @@ int gl_printWidth( const glFont *ft_font, const char *fmt, ... )
 int gl_printHeightRaw( const glFont *ft_font,
       const int width, const char *text )
 {
-   int i, p;
+   int i, p, found;
    double y;
+   glFontMemo *memo;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
@@ -1026,6 +1064,11 @@ int gl_printHeightRaw( const glFont *ft_font,
    if (text[0] == '\0')
       return 0;
 
+   /* Try the memo first. */
+   memo = gl_fontGetMemo( font_memoHeight, gl_fontGetStash( ft_font ), width, text, &found );
+   if (found)
+      return memo->value;
+
    y = 0.;
    p = 0;
    do {
@@ -1034,7 +1077,8 @@ int gl_printHeightRaw( const glFont *ft_font,
       y += 1.5*(double)ft_font->h; /* move position down */
    } while (text[p-1] != '\0');
 
-   return (int) (y - 0.5*(double)ft_font->h) + 1;
+   memo->value = (int) (y - 0.5*(double)ft_font->h) + 1;
+   return memo->value;
 }
 
 /**
@@ -1168,6 +1212,7 @@ static void gl_fontRenderStart( const glFontStash* stsh, double x, double y, con
    else
       col = c;
 
+   gl_batchFlush();
    glUseProgram(shaders.font.program);
    gl_uniformAColor(shaders.font.color, col, a);
    if (outlineR == 0.)
@@ -1180,13 +1225,10 @@ static void gl_fontRenderStart( const glFontStash* stsh, double x, double y, con
    font_projection_mat = gl_Matrix4_Scale(font_projection_mat, scale, scale, 1 );
 
    font_restoreLast = 0;
-   gl_fontKernStart();
 
-   /* Activate the appropriate VBOs. */
+   /* Vertex data comes from the text runs. */
    glEnableVertexAttribArray( shaders.font.vertex );
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2, GL_SHORT, 0 );
    glEnableVertexAttribArray( shaders.font.tex_coord );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2, GL_FLOAT, 0 );
 }
 
 
@@ -1337,62 +1379,277 @@ static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph
 
 
 /**
- * @brief Renders a character.
+ * @brief Hashes a piece of text (FNV-1a).
  */
-static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c, int state )
+static uint32_t font_hashText( const char *text, size_t len )
 {
-   double scale;
-   double a;
+   size_t i;
+   uint32_t h = 2166136261u;
+   for (i=0; i<len; i++) {
+      h ^= (uint8_t)text[i];
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Gets the cached run of a piece of text, building it if needed.
+ *
+ *    @param stsh Stash to render with.
+ *    @param text Text of the run (need not be NUL terminated).
+ *    @param len Length of the text in bytes.
+ *    @param state Escape state at the start of the run.
+ *    @return The run to draw.
+ */
+static glFontRun* gl_fontGetRun( glFontStash *stsh, const char *text, size_t len, int state )
+{
+   uint32_t h;
+   int id;
+   glFontRun *run;
+
+   id = stsh - avail_fonts + 1;
+   h  = font_hashText( text, len ) ^ hashint( id*3 + state+1 );
+   run = &font_runs[ h & (FONT_RUN_CACHE_SIZE-1) ];
+   if ((run->stash == id) && (run->state_in == state) && (run->hash == h)
+         && (run->len == len) && (memcmp( run->text, text, len ) == 0))
+      return run;
+
+   /* Replace whatever was in the slot. */
+   free( run->text );
+   run->text = malloc( len+1 );
+   memcpy( run->text, text, len );
+   run->text[len] = '\0';
+   run->len      = len;
+   run->hash     = h;
+   run->stash    = id;
+   run->state_in = state;
+   gl_fontBuildRun( stsh, run );
+   return run;
+}
+
+
+/**
+ * @brief Lays out the glyphs of a run and uploads them.
+ *
+ * Mirrors the per glyph rendering: colour codes, kerning and the pen
+ * advance are resolved once here so drawing is one call per segment.
+ */
+static void gl_fontBuildRun( glFontStash *stsh, glFontRun *run )
+{
+   /* Triangle order for the quads stored as strips. */
+   static const int quad[6] = { 0, 1, 2, 2, 1, 3 };
+   int i, j, n, state, setcol;
+   size_t p;
+   uint32_t ch;
+   double scale, pen;
    const glColour *col;
-   int kern_adv_x;
+   glFontGlyph *glyph;
+   glFontRunSeg *seg;
+   GLfloat *v;
+
+   if (run->segs == NULL)
+      run->segs = array_create( glFontRunSeg );
+   else
+      array_resize( &run->segs, 0 );
+   if (font_runData == NULL)
+      font_runData = array_create( GLfloat );
+
+   scale  = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
+   pen    = 0.;
+   state  = run->state_in;
+   setcol = 0;
+   col    = NULL;
+   seg    = NULL;
+   run->setcol = 0;
+   gl_fontKernStart();
+
+   /* Lay out the glyphs as interleaved position and texture coordinates. */
+   array_resize( &font_runData, 0 );
+   p = 0;
+   while (p < run->len) {
+      ch = u8_nextchar( run->text, &p );
+
+      /* Handle escape sequences. */
+      if ((ch == FONT_COLOUR_CODE) && (state==0)) {
+         state = 1;
+         continue;
+      }
+      if (state == 1) {
+         col    = gl_fontGetColour( ch );
+         setcol = 1;
+         state  = 0;
+         run->setcol  = 1;
+         run->lastcol = col;
+         continue;
+      }
 
-   /* Handle escape sequences. */
-   if ((ch == FONT_COLOUR_CODE) && (state==0)) {/* Start sequence. */
-      return 1;
+      glyph = gl_fontGetGlyph( stsh, ch );
+      if (glyph == NULL) {
+         WARN(_("Unable to find glyph '%d'!"), ch );
+         state = -1;
+         continue;
+      }
+      state = 0;
+
+      pen += gl_fontKernGlyph( stsh, ch, glyph ) / scale;
+
+      /* New segment when the texture or colour changes. */
+      if ((seg == NULL) || setcol || (seg->tex_index != glyph->tex_index)) {
+         seg = &array_grow( &run->segs );
+         seg->first     = array_size(font_runData) / 4;
+         seg->count     = 0;
+         seg->tex_index = glyph->tex_index;
+         seg->setcol    = setcol;
+         seg->col       = col;
+         setcol = 0;
+      }
+
+      n = array_size( font_runData );
+      array_resize( &font_runData, n + 6*4 );
+      v = &font_runData[n];
+      for (i=0; i<6; i++) {
+         j = 2*(glyph->vbo_id + quad[i]);
+         v[4*i+0] = stsh->vbo_vert_data[j] + pen;
+         v[4*i+1] = stsh->vbo_vert_data[j+1];
+         v[4*i+2] = stsh->vbo_tex_data[j];
+         v[4*i+3] = stsh->vbo_tex_data[j+1];
+      }
+      seg->count += 6;
+
+      pen += glyph->adv_x / scale;
    }
-   if (state == 1) {
-      col = gl_fontGetColour( ch );
+   run->state_out = state;
+
+   run->nvert = array_size(font_runData) / 4;
+
+   if (run->nvert == 0)
+      return;
+   if (run->vbo == NULL)
+      run->vbo = gl_vboCreateStatic( sizeof(GLfloat)*4*run->nvert, font_runData );
+   else
+      gl_vboData( run->vbo, sizeof(GLfloat)*4*run->nvert, font_runData );
+}
+
+
+/**
+ * @brief Renders a piece of text through the run cache.
+ *
+ *    @param stsh Stash to render with.
+ *    @param text Text to render.
+ *    @param len Length of the text in bytes.
+ *    @param c Base colour (NULL is white).
+ *    @param state Escape state at the start of the text.
+ *    @return Escape state at the end of the text.
+ */
+static int gl_fontRenderText( glFontStash *stsh, const char *text, size_t len, const glColour *c, int state )
+{
+   int i;
+   double a;
+   glFontRun *run;
+   const glFontRunSeg *seg;
+
+   if (len == 0)
+      return state;
+
+   run = gl_fontGetRun( stsh, text, len, state );
+   if (run->nvert > 0) {
+      gl_vboActivateAttribOffset( run->vbo, shaders.font.vertex,
+            0, 2, GL_FLOAT, 4*sizeof(GLfloat) );
+      gl_vboActivateAttribOffset( run->vbo, shaders.font.tex_coord,
+            2*sizeof(GLfloat), 2, GL_FLOAT, 4*sizeof(GLfloat) );
+      gl_Matrix4_Uniform(shaders.font.projection, font_projection_mat);
+
       a = (c==NULL) ? 1. : c->a;
-      if (col != NULL)
-         gl_uniformAColor(shaders.font.color, col, a );
-      else if (c==NULL)
-         gl_uniformColor(shaders.font.color, &cWhite);
-      else
-         gl_uniformColor(shaders.font.color, c);
-      font_lastCol = col;
-      return 0;
+      for (i=0; i<array_size(run->segs); i++) {
+         seg = &run->segs[i];
+         if (seg->setcol) {
+            if (seg->col != NULL)
+               gl_uniformAColor(shaders.font.color, seg->col, a );
+            else if (c==NULL)
+               gl_uniformColor(shaders.font.color, &cWhite);
+            else
+               gl_uniformColor(shaders.font.color, c);
+         }
+         glBindTexture(GL_TEXTURE_2D, stsh->tex[seg->tex_index].id);
+         glDrawArrays( GL_TRIANGLES, seg->first, seg->count );
+      }
    }
 
-   /* Unicode goes here.
-    * First try to find the glyph. */
-   glFontGlyph *glyph;
-   glyph = gl_fontGetGlyph( stsh, ch );
-   if (glyph == NULL) {
-      WARN(_("Unable to find glyph '%d'!"), ch );
-      return -1;
-   }
+   if (run->setcol)
+      font_lastCol = run->lastcol;
+   return run->state_out;
+}
 
-   /* Kern if possible. */
-   scale = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
-   kern_adv_x = gl_fontKernGlyph( stsh, ch, glyph );
-   if (kern_adv_x) {
-      font_projection_mat = gl_Matrix4_Translate( font_projection_mat,
-            kern_adv_x/scale, 0, 0 );
-   }
 
-   /* Activate texture. */
-   glBindTexture(GL_TEXTURE_2D, stsh->tex[glyph->tex_index].id);
+/**
+ * @brief Looks up a memoized text metric.
+ *
+ *    @param memo Memo table to use.
+ *    @param stsh Stash the metric is for.
+ *    @param width Extra key (wrapping width).
+ *    @param text Text the metric is for.
+ *    @param[out] found Whether the slot already holds the value.
+ *    @return Slot to read or store the value in.
+ */
+static glFontMemo* gl_fontGetMemo( glFontMemo *memo, const glFontStash *stsh, int width, const char *text, int *found )
+{
+   uint32_t h;
+   int id;
+   glFontMemo *m;
+
+   id = stsh - avail_fonts + 1;
+   h  = font_hashText( text, strlen(text) ) ^ hashint( id*65599 + width );
+   m  = &memo[ h & (FONT_MEMO_SIZE-1) ];
+   if ((m->stash == id) && (m->width == width) && (m->hash == h)
+         && (strcmp( m->text, text ) == 0)) {
+      *found = 1;
+      return m;
+   }
 
-   gl_Matrix4_Uniform(shaders.font.projection, font_projection_mat);
+   free( m->text );
+   m->text  = strdup( text );
+   m->stash = id;
+   m->width = width;
+   m->hash  = h;
+   *found   = 0;
+   return m;
+}
 
-   /* Draw the element. */
-   glDrawArrays( GL_TRIANGLE_STRIP, glyph->vbo_id, 4 );
 
-   /* Translate matrix. */
-   font_projection_mat = gl_Matrix4_Translate( font_projection_mat,
-         glyph->adv_x/scale, 0, 0 );
+/**
+ * @brief Drops cached runs and metrics of a stash.
+ *
+ *    @param stsh Stash to flush (NULL flushes everything).
+ */
+static void gl_fontFlushCache( const glFontStash *stsh )
+{
+   int i, id;
 
-   return 0;
+   id = (stsh==NULL) ? 0 : stsh - avail_fonts + 1;
+   for (i=0; i<FONT_RUN_CACHE_SIZE; i++) {
+      glFontRun *run = &font_runs[i];
+      if ((run->stash == 0) || ((id != 0) && (run->stash != id)))
+         continue;
+      free( run->text );
+      gl_vboDestroy( run->vbo );
+      array_free( run->segs );
+      memset( run, 0, sizeof(glFontRun) );
+   }
+   for (i=0; i<FONT_MEMO_SIZE; i++) {
+      if ((font_memoWidth[i].stash != 0) && ((id == 0) || (font_memoWidth[i].stash == id))) {
+         free( font_memoWidth[i].text );
+         memset( &font_memoWidth[i], 0, sizeof(glFontMemo) );
+      }
+      if ((font_memoHeight[i].stash != 0) && ((id == 0) || (font_memoHeight[i].stash == id))) {
+         free( font_memoHeight[i].text );
+         memset( &font_memoHeight[i], 0, sizeof(glFontMemo) );
+      }
+   }
+   if (id == 0) {
+      array_free( font_runData );
+      font_runData = NULL;
+   }
 }
 
 
@@ -1529,12 +1786,10 @@ int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const ch
    stsh->glyphs = array_create( glFontGlyph );
    stsh->tex    = array_create( glFontTex );
 
-   /* Set up VBOs. */
+   /* Set up glyph vertex data, runs are built from it. */
    stsh->mvbo = 256;
    stsh->vbo_tex_data  = calloc( 8*stsh->mvbo, sizeof(GLfloat) );
    stsh->vbo_vert_data = calloc( 8*stsh->mvbo, sizeof(GLshort) );
-   stsh->vbo_tex  = gl_vboCreateStatic( sizeof(GLfloat)*8*stsh->mvbo,  stsh->vbo_tex_data );
-   stsh->vbo_vert = gl_vboCreateStatic( sizeof(GLshort)*8*stsh->mvbo, stsh->vbo_vert_data );
 
    return 0;
 }
@@ -1550,6 +1805,8 @@ int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const ch
 int gl_fontAddFallback( glFont* font, const char *fname )
 {
    glFontStash *stsh = gl_fontGetStash( font );
+   /* Missing glyphs may now be found. */
+   gl_fontFlushCache( stsh );
    return gl_fontstashAddFallback( stsh, fname, font->h );
 }
 
@@ -1665,6 +1922,7 @@ void gl_freeFont( glFont* font )
    if (--font_library_refs == 0) {
       FT_Done_FreeType( font_library );
       font_library = NULL;
+      gl_fontFlushCache( NULL );
    }
 
    free( stsh->fname );
@@ -1673,8 +1931,7 @@ void gl_freeFont( glFont* font )
    array_free( stsh->tex );
 
    array_free( stsh->glyphs );
-   gl_vboDestroy(stsh->vbo_tex);
-   gl_vboDestroy(stsh->vbo_vert);
+   gl_fontFlushCache( stsh );
    free(stsh->vbo_tex_data);
    free(stsh->vbo_vert_data);
    memset( stsh, 0, sizeof(glFontStash) );
@@ -31,11 +31,13 @@
 
 #include "hook.h"
 
+#include "array.h"
 #include "claim.h"
 #include "event.h"
 #include "log.h"
 #include "menu.h"
 #include "mission.h"
+#include "nhash.h"
 #include "nlua_hook.h"
 #include "nlua_pilot.h"
 #include "nstring.h"
@@ -82,6 +84,7 @@ typedef struct Hook_ {
 
    unsigned int id; /**< unique id */
    char *stack; /**< stack it's a part of */
+   int stackid; /**< Index of the stack in hook_stacks. */
    int created; /**< Hook has just been created. */
    int delete; /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating. */
@@ -110,11 +113,23 @@ typedef struct Hook_ {
 } Hook;
 
 
+/**
+ * @brief Hooks belonging to a single stack.
+ */
+typedef struct HookStack_ {
+   char *name; /**< Name of the stack. */
+   Hook **hooks; /**< Hooks in the stack in creation order (array.h). */
+} HookStack;
+
+
 /*
  * the stack
  */
 static unsigned int hook_id   = 0; /**< Unique hook id generator. */
 static Hook* hook_list        = NULL; /**< Stack of hooks. */
+static Hook** hook_ids        = NULL; /**< Hooks sorted by id (array.h). */
+static HookStack *hook_stacks = NULL; /**< Hooks grouped by stack (array.h). */
+static NameHash hook_stacknames; /**< Stack name to hook_stacks index. */
 static int hook_runningstack  = 0; /**< Check if stack is running. */
 static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
 
@@ -129,6 +144,11 @@ static void hooks_updateDateExecute( ntime_t change );
 static void hook_rmRaw( Hook *h );
 static void hooks_purgeList (void);
 static Hook* hook_get( unsigned int id );
+static int hook_idFind( unsigned int id );
+static void hook_idAdd( Hook *h );
+static void hook_idRemove( Hook *h );
+static void hook_setID( Hook *h, unsigned int id );
+static int hook_stackGet( const char *stack, int create );
 static unsigned int hook_genID (void);
 static Hook* hook_new( HookType_t type, const char *stack );
 static int hook_parseParam( lua_State *L, HookParam *param );
@@ -446,7 +466,6 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
 static unsigned int hook_genID (void)
 {
    unsigned int id;
-   Hook *h;
    id = ++hook_id; /* default id, not safe if loading */
 
    /* If not loading we can just return. */
@@ -454,9 +473,8 @@ static unsigned int hook_genID (void)
       return id;
 
    /* Must check ids for collisions. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (id == h->id) /* Check for collision. */
-         return hook_genID(); /* recursively try again */
+   if (hook_get( id ) != NULL)
+      return hook_genID(); /* recursively try again */
 
    return id;
 }
@@ -487,8 +505,13 @@ static Hook* hook_new( HookType_t type, const char *stack )
    new_hook->type    = type;
    new_hook->id      = hook_genID();
    new_hook->stack   = strdup(stack);
+   new_hook->stackid = hook_stackGet( stack, 1 );
    new_hook->created = 1;
 
+   /* Index it. */
+   hook_idAdd( new_hook );
+   array_push_back( &hook_stacks[ new_hook->stackid ].hooks, new_hook );
+
    /** @TODO fix this hack. */
    if (strcmp(stack,"safe")==0)
       new_hook->once = 1;
@@ -602,12 +625,32 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
  */
 static void hooks_purgeList (void)
 {
+   int i, j, k, n;
    Hook *h, *hl;
+   HookStack *hs;
 
    /* Do not run while stack is being run. */
    if (hook_runningstack)
       return;
 
+   /* Drop deleted hooks from the indices, keeping the order. */
+   j = 0;
+   for (i=0; i<array_size(hook_ids); i++)
+      if (!hook_ids[i]->delete)
+         hook_ids[j++] = hook_ids[i];
+   n = array_size(hook_ids) - j;
+   if (n == 0)
+      return;
+   array_erase( &hook_ids, &hook_ids[j], array_end(hook_ids) );
+   for (k=0; k<array_size(hook_stacks); k++) {
+      hs = &hook_stacks[k];
+      j  = 0;
+      for (i=0; i<array_size(hs->hooks); i++)
+         if (!hs->hooks[i]->delete)
+            hs->hooks[j++] = hs->hooks[i];
+      array_erase( &hs->hooks, &hs->hooks[j], array_end(hs->hooks) );
+   }
+
    /* Second pass to delete. */
    hl = NULL;
    h  = hook_list;
@@ -652,21 +695,28 @@ void hooks_updateDate( ntime_t change )
  */
 static void hooks_updateDateExecute( ntime_t change )
 {
-   int j;
+   int i, j, s;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
+   /* Date hooks all live in the "date" stack. */
+   s = hook_stackGet( "date", 0 );
+   if (s < 0)
+      return;
+
    /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   for (i=0; i<array_size(hook_stacks[s].hooks); i++)
+      hook_stacks[s].hooks[i]->created = 0;
 
    /* On j=0 we increment all timers and try to run, then on j=1 we update the timers. */
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      /* Newest first, hooks created while running are appended and skipped. */
+      for (i=array_size(hook_stacks[s].hooks)-1; i>=0; i--) {
+         h = hook_stacks[s].hooks[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
@@ -744,20 +794,28 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
  */
 void hooks_update( double dt )
 {
-   int j;
+   int i, j, s;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
+   /* Timer hooks all live in the "timer" stack. */
+   s = hook_stackGet( "timer", 0 );
+   if (s < 0) {
+      hooks_purgeList();
+      return;
+   }
+
    /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   for (i=0; i<array_size(hook_stacks[s].hooks); i++)
+      hook_stacks[s].hooks[i]->created = 0;
 
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (i=array_size(hook_stacks[s].hooks)-1; i>=0; i--) {
+         h = hook_stacks[s].hooks[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
@@ -900,7 +958,7 @@ int hook_hasEventParent( unsigned int parent )
 
 static int hooks_executeParam( const char* stack, HookParam *param )
 {
-   int j;
+   int i, j, s;
    int run;
    Hook *h;
 
@@ -908,17 +966,25 @@ static int hooks_executeParam( const char* stack, HookParam *param )
    if ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED))
       return 0;
 
+   /* Nothing was ever hooked on the stack. */
+   s = hook_stackGet( stack, 0 );
+   if (s < 0)
+      return 0;
+
    /* Reset the current stack's ran and creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (strcmp(stack, h->stack)==0) {
-         h->ran_once = 0;
-         h->created = 0;
-      }
+   for (i=0; i<array_size(hook_stacks[s].hooks); i++) {
+      h = hook_stacks[s].hooks[i];
+      h->ran_once = 0;
+      h->created = 0;
+   }
 
    run = 0;
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      /* Newest first like the hook list. The bucket may grow (and move) while
+       * running, so always index through hook_stacks. */
+      for (i=array_size(hook_stacks[s].hooks)-1; i>=0; i--) {
+         h = hook_stacks[s].hooks[i];
          /* Should be deleted. */
          if (h->delete)
             continue;
@@ -928,9 +994,6 @@ static int hooks_executeParam( const char* stack, HookParam *param )
          /* Don't update newly created hooks. */
          if (h->created != 0)
             continue;
-         /* Doesn't match stack. */
-         if (strcmp(stack, h->stack) != 0)
-            continue;
 
          /* Run hook. */
          hook_run( h, param, j );
@@ -1003,15 +1066,111 @@ int hooks_run( const char* stack )
  */
 static Hook* hook_get( unsigned int id )
 {
-   Hook *h;
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (h->id == id)
-         return h;
+   int i;
+   i = hook_idFind( id );
+   if ((i < array_size(hook_ids)) && (hook_ids[i]->id == id))
+      return hook_ids[i];
 
    return NULL;
 }
 
 
+/**
+ * @brief Finds where a hook id is or should be in hook_ids.
+ *
+ *    @param id ID to look for.
+ *    @return Index of the first hook with an id not smaller than id.
+ */
+static int hook_idFind( unsigned int id )
+{
+   int l, h, m;
+
+   /* New ids are generated increasing, so check the tail first. */
+   h = array_size(hook_ids);
+   if ((h == 0) || (hook_ids[h-1]->id < id))
+      return h;
+
+   l = 0;
+   while (l < h) {
+      m = (l+h) / 2;
+      if (hook_ids[m]->id < id)
+         l = m+1;
+      else
+         h = m;
+   }
+   return l;
+}
+
+
+/**
+ * @brief Adds a hook to the id index.
+ */
+static void hook_idAdd( Hook *h )
+{
+   int i, n;
+
+   if (hook_ids == NULL)
+      hook_ids = array_create( Hook* );
+
+   i = hook_idFind( h->id );
+   n = array_size(hook_ids);
+   array_push_back( &hook_ids, h );
+   memmove( &hook_ids[i+1], &hook_ids[i], (n-i) * sizeof(Hook*) );
+   hook_ids[i] = h;
+}
+
+
+/**
+ * @brief Removes a hook from the id index.
+ */
+static void hook_idRemove( Hook *h )
+{
+   int i;
+
+   i = hook_idFind( h->id );
+   if ((i < array_size(hook_ids)) && (hook_ids[i] == h))
+      array_erase( &hook_ids, &hook_ids[i], &hook_ids[i+1] );
+}
+
+
+/**
+ * @brief Changes the id of a hook, keeping the id index sorted.
+ */
+static void hook_setID( Hook *h, unsigned int id )
+{
+   hook_idRemove( h );
+   h->id = id;
+   hook_idAdd( h );
+}
+
+
+/**
+ * @brief Gets the index of a hook stack by name.
+ *
+ *    @param stack Name of the stack.
+ *    @param create Whether or not to create the stack if it doesn't exist.
+ *    @return Index of the stack in hook_stacks or -1 if not found.
+ */
+static int hook_stackGet( const char *stack, int create )
+{
+   int s;
+   HookStack *hs;
+
+   s = nhash_get( &hook_stacknames, stack );
+   if ((s >= 0) || !create)
+      return s;
+
+   if (hook_stacks == NULL)
+      hook_stacks = array_create( HookStack );
+   s        = array_size(hook_stacks);
+   hs       = &array_grow( &hook_stacks );
+   hs->name = strdup( stack );
+   hs->hooks = array_create( Hook* );
+   nhash_add( &hook_stacknames, hs->name, s );
+   return s;
+}
+
+
 /**
  * @brief Gets the lua env for a hook.
  */
@@ -1118,6 +1277,7 @@ static void hook_free( Hook *h )
  */
 void hook_cleanup (void)
 {
+   int i;
    Hook *h, *hn;
 
    if (hook_runningstack)
@@ -1134,6 +1294,17 @@ void hook_cleanup (void)
    }
    /* safe defaults just in case */
    hook_list  = NULL;
+
+   /* Clear the indices. */
+   array_free( hook_ids );
+   hook_ids = NULL;
+   for (i=0; i<array_size(hook_stacks); i++) {
+      free( hook_stacks[i].name );
+      array_free( hook_stacks[i].hooks );
+   }
+   array_free( hook_stacks );
+   hook_stacks = NULL;
+   nhash_free( &hook_stacknames );
 }
 
 
@@ -1354,7 +1525,7 @@ static int hook_parse( xmlNodePtr base )
          /* Set the id. */
          if (id != 0) {
             h = hook_get( new_id );
-            h->id = id;
+            hook_setID( h, id );
 
             /* Additional info. */
             if (is_date) {
@@ -120,6 +120,7 @@ static void land_stranded (void);
 static void land_createMainTab( unsigned int wid );
 static void land_cleanupWindow( unsigned int wid, char *name );
 static void land_changeTab( unsigned int wid, char *wgt, int old, int tab );
+static void land_saveDone( int ret, void *data );
 /* spaceport bar */
 static void bar_getDim( int wid,
       int *w, int *h, int *iw, int *ih, int *bw, int *bh );
@@ -1309,6 +1310,20 @@ static void land_changeTab( unsigned int wid, char *wgt, int old, int tab )
 }
 
 
+/**
+ * @brief Alerts the player if the takeoff save failed.
+ *
+ *    @param ret Result of the save, 0 on success.
+ *    @param data Unused.
+ */
+static void land_saveDone( int ret, void *data )
+{
+   (void) data;
+   if (ret < 0)
+      dialogue_alert( _("Failed to save game! You should exit and check the log to see what happened and then file a bug report!") );
+}
+
+
 /**
  * @brief Makes the player take off if landed.
  *
@@ -1379,8 +1394,8 @@ void takeoff( int delay )
    player.p->nav_hyperspace = h;
 
    /* cleanup */
-   if (save_all() < 0) /* must be before cleaning up planet */
-      dialogue_alert( _("Failed to save game! You should exit and check the log to see what happened and then file a bug report!") );
+   if (save_allAsync( land_saveDone, NULL ) < 0) /* must be before cleaning up planet */
+      land_saveDone( -1, NULL );
 
    /* time goes by, triggers hook before takeoff */
    if (delay)
@@ -11,6 +11,7 @@
 
 /** @cond */
 #include "physfs.h"
+#include "SDL.h"
 
 #include "naev.h"
 /** @endcond */
@@ -35,6 +36,7 @@
 #include "nxml.h"
 #include "outfit.h"
 #include "player.h"
+#include "save.h"
 #include "shiplog.h"
 #include "space.h"
 #include "toolkit.h"
@@ -46,6 +48,8 @@
 #define BUTTON_WIDTH    200 /**< Button width. */
 #define BUTTON_HEIGHT   30 /**< Button height. */
 
+#define LOAD_INDEX_PATH "saves/index.xml" /**< Cached metadata of the saves. */
+
 
 /**
  * @brief Struct containing a file's name and stat structure.
@@ -56,6 +60,19 @@ typedef struct filedata {
 } filedata_t;
 
 
+/**
+ * @brief Cached metadata of a saved game.
+ *
+ * Only trusted while the file still has the same modification time and size.
+ */
+typedef struct nsaveIndex_s {
+   char *file; /**< File name in the saves directory. */
+   PHYSFS_sint64 modtime; /**< Modification time of the file. */
+   PHYSFS_sint64 size; /**< Size of the file. */
+   nsave_t save; /**< Metadata, path is not set. */
+} nsaveIndex_t;
+
+
 static nsave_t *load_saves = NULL; /**< Array of save.s */
 extern int save_loaded; /**< From save.c */
 
@@ -94,6 +111,13 @@ static int load_gameInternal( const char* file, const char* version );
 static int load_enumerateCallback( void* data, const char* origdir, const char* fname );
 static int load_sortCompare( const void *p1, const void *p2 );
 static xmlDocPtr load_xml_parsePhysFS( const char* filename );
+static void load_copySave( nsave_t *dest, const nsave_t *src );
+static nsaveIndex_t* load_indexRead (void);
+static int load_indexWrite( const nsaveIndex_t *idx );
+static void load_indexFree( nsaveIndex_t *idx );
+static nsaveIndex_t* load_indexGet( nsaveIndex_t *idx, const char *file );
+static void load_indexSet( nsaveIndex_t **idx, const char *file,
+      const PHYSFS_Stat *stat, const nsave_t *ns );
 
 
 /**
@@ -183,6 +207,265 @@ static int load_load( nsave_t *save, const char *path )
 }
 
 
+/**
+ * @brief Frees the contents of a save structure.
+ *
+ *    @param ns Save to free.
+ */
+void load_freeSave( nsave_t *ns )
+{
+   free(ns->path);
+   free(ns->name);
+   free(ns->version);
+   free(ns->data);
+   free(ns->planet);
+   free(ns->shipname);
+   free(ns->shipmodel);
+   memset( ns, 0, sizeof(nsave_t) );
+}
+
+
+/**
+ * @brief Deep copies a save structure.
+ */
+static void load_copySave( nsave_t *dest, const nsave_t *src )
+{
+#define STRDUP(s) (((s) != NULL) ? strdup(s) : NULL)
+   dest->path      = STRDUP( src->path );
+   dest->name      = STRDUP( src->name );
+   dest->version   = STRDUP( src->version );
+   dest->data      = STRDUP( src->data );
+   dest->planet    = STRDUP( src->planet );
+   dest->date      = src->date;
+   dest->credits   = src->credits;
+   dest->shipname  = STRDUP( src->shipname );
+   dest->shipmodel = STRDUP( src->shipmodel );
+#undef STRDUP
+}
+
+
+/**
+ * @brief Reads the cached metadata of the saves.
+ *
+ *    @return Array (array.h) of cached saves, NULL if there is no cache.
+ */
+static nsaveIndex_t* load_indexRead (void)
+{
+   xmlDocPtr doc;
+   xmlNodePtr root, node, cur;
+   nsaveIndex_t *idx, *e;
+
+   if (!PHYSFS_exists( LOAD_INDEX_PATH ))
+      return NULL;
+
+   doc = load_xml_parsePhysFS( LOAD_INDEX_PATH );
+   if (doc == NULL)
+      return NULL;
+   root = doc->xmlChildrenNode;
+   if ((root == NULL) || !xml_isNode(root, "saves")) {
+      xmlFreeDoc(doc);
+      return NULL;
+   }
+
+   idx  = array_create( nsaveIndex_t );
+   node = root->xmlChildrenNode;
+   do {
+      xml_onlyNodes(node);
+      if (!xml_isNode(node, "save"))
+         continue;
+
+      e = &array_grow( &idx );
+      memset( e, 0, sizeof(nsaveIndex_t) );
+      xmlr_attr_strd( node, "file", e->file );
+      xmlr_attr_long( node, "modtime", e->modtime );
+      xmlr_attr_long( node, "size", e->size );
+      cur = node->xmlChildrenNode;
+      do {
+         xml_onlyNodes(cur);
+         xmlr_strd(cur, "name", e->save.name);
+         xmlr_strd(cur, "version", e->save.version);
+         xmlr_strd(cur, "data", e->save.data);
+         xmlr_strd(cur, "planet", e->save.planet);
+         xmlr_long(cur, "date", e->save.date);
+         xmlr_ulong(cur, "credits", e->save.credits);
+         xmlr_strd(cur, "shipname", e->save.shipname);
+         xmlr_strd(cur, "shipmodel", e->save.shipmodel);
+      } while (xml_nextNode(cur));
+
+      /* Drop broken entries. */
+      if (e->file == NULL) {
+         load_freeSave( &e->save );
+         array_erase( &idx, e, e+1 );
+      }
+   } while (xml_nextNode(node));
+
+   xmlFreeDoc(doc);
+   return idx;
+}
+
+
+/**
+ * @brief Writes the cached metadata of the saves.
+ *
+ *    @param idx Array (array.h) of cached saves.
+ *    @return 0 on success.
+ */
+static int load_indexWrite( const nsaveIndex_t *idx )
+{
+   int i;
+   char file[PATH_MAX];
+   xmlDocPtr doc;
+   xmlTextWriterPtr writer;
+   const nsaveIndex_t *e;
+
+   writer = xmlNewTextWriterDoc(&doc, 0);
+   if (writer == NULL) {
+      WARN(_("testXmlwriterDoc: Error creating the xml writer"));
+      return -1;
+   }
+   xmlw_setParams( writer );
+   xmlw_start(writer);
+   xmlw_startElem(writer, "saves");
+   for (i=0; i<array_size(idx); i++) {
+      e = &idx[i];
+      xmlw_startElem(writer, "save");
+      xmlw_attr(writer, "file", "%s", e->file);
+      xmlw_attr(writer, "modtime", "%"PRIi64, (int64_t)e->modtime);
+      xmlw_attr(writer, "size", "%"PRIi64, (int64_t)e->size);
+      if (e->save.name != NULL)
+         xmlw_elem(writer, "name", "%s", e->save.name);
+      if (e->save.version != NULL)
+         xmlw_elem(writer, "version", "%s", e->save.version);
+      if (e->save.data != NULL)
+         xmlw_elem(writer, "data", "%s", e->save.data);
+      if (e->save.planet != NULL)
+         xmlw_elem(writer, "planet", "%s", e->save.planet);
+      xmlw_elem(writer, "date", "%"PRIi64, e->save.date);
+      xmlw_elem(writer, "credits", "%"PRId64, e->save.credits);
+      if (e->save.shipname != NULL)
+         xmlw_elem(writer, "shipname", "%s", e->save.shipname);
+      if (e->save.shipmodel != NULL)
+         xmlw_elem(writer, "shipmodel", "%s", e->save.shipmodel);
+      xmlw_endElem(writer); /* "save" */
+   }
+   xmlw_endElem(writer); /* "saves" */
+   xmlw_done(writer);
+   xmlFreeTextWriter(writer);
+
+   nsnprintf(file, PATH_MAX, "%s/%s", PHYSFS_getWriteDir(), LOAD_INDEX_PATH);
+   if (xmlSaveFileEnc(file, doc, "UTF-8") < 0) {
+      WARN(_("Failed to write saved game index '%s'."), file);
+      xmlFreeDoc(doc);
+      return -1;
+   }
+   xmlFreeDoc(doc);
+   return 0;
+}
+
+
+/**
+ * @brief Frees the cached metadata of the saves.
+ */
+static void load_indexFree( nsaveIndex_t *idx )
+{
+   int i;
+   for (i=0; i<array_size(idx); i++) {
+      free( idx[i].file );
+      load_freeSave( &idx[i].save );
+   }
+   array_free( idx );
+}
+
+
+/**
+ * @brief Gets the cached metadata of a save file.
+ *
+ *    @param idx Array (array.h) of cached saves.
+ *    @param file File name in the saves directory.
+ *    @return The cached save or NULL if not cached.
+ */
+static nsaveIndex_t* load_indexGet( nsaveIndex_t *idx, const char *file )
+{
+   int i;
+   for (i=0; i<array_size(idx); i++)
+      if (strcmp( idx[i].file, file ) == 0)
+         return &idx[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Sets the cached metadata of a save file.
+ *
+ *    @param[in,out] idx Array (array.h) of cached saves, created if NULL.
+ *    @param file File name in the saves directory.
+ *    @param stat Current status of the file.
+ *    @param ns Metadata of the save.
+ */
+static void load_indexSet( nsaveIndex_t **idx, const char *file,
+      const PHYSFS_Stat *stat, const nsave_t *ns )
+{
+   nsaveIndex_t *e;
+
+   if (*idx == NULL)
+      *idx = array_create( nsaveIndex_t );
+
+   e = load_indexGet( *idx, file );
+   if (e == NULL) {
+      e = &array_grow( idx );
+      memset( e, 0, sizeof(nsaveIndex_t) );
+      e->file = strdup( file );
+   }
+   else
+      load_freeSave( &e->save );
+   e->modtime = stat->modtime;
+   e->size    = stat->filesize;
+   load_copySave( &e->save, ns );
+   free( e->save.path );
+   e->save.path = NULL;
+}
+
+
+/**
+ * @brief Updates the cached metadata of a freshly written save.
+ *
+ * Called by the save job in the threadpool, load_refresh waits for it with
+ *  save_flush before touching the index.
+ *
+ *    @param ns Metadata of the save, path must be set.
+ *    @param backup Whether the previous save was just backed up.
+ */
+void load_indexUpdate( const nsave_t *ns, int backup )
+{
+   char buf[PATH_MAX];
+   const char *file;
+   nsaveIndex_t *idx, *e;
+   nsave_t old;
+   PHYSFS_Stat stat;
+
+   idx  = load_indexRead();
+   file = strrchr( ns->path, '/' );
+   file = (file != NULL) ? file+1 : ns->path;
+
+   /* The backup is a copy of the old save, so it keeps the old metadata. */
+   e = load_indexGet( idx, file );
+   nsnprintf( buf, sizeof(buf), "%s.backup", ns->path );
+   if (backup && (e != NULL) && PHYSFS_stat( buf, &stat )
+         && (stat.filesize == e->size)) {
+      load_copySave( &old, &e->save ); /* e may move when the index grows. */
+      nsnprintf( buf, sizeof(buf), "%s.backup", file );
+      load_indexSet( &idx, buf, &stat, &old );
+      load_freeSave( &old );
+   }
+
+   if (PHYSFS_stat( ns->path, &stat ))
+      load_indexSet( &idx, file, &stat, ns );
+
+   load_indexWrite( idx );
+   load_indexFree( idx );
+}
+
+
 /**
  * @brief Loads or refreshes saved games.
  */
@@ -191,12 +474,16 @@ int load_refresh (void)
    char buf[PATH_MAX];
    filedata_t *files, tmp;
    size_t len;
-   int i, ok;
+   int i, j, ok, dirty;
    nsave_t *ns;
+   nsaveIndex_t *idx, *e;
 
    if (load_saves != NULL)
       load_free();
 
+   /* The last save may still be being written. */
+   save_flush();
+
    /* load the saves */
    files = array_create( filedata_t );
    PHYSFS_enumerate( "saves", load_enumerateCallback, &files );
@@ -225,17 +512,47 @@ int load_refresh (void)
       files[i+1]  = tmp;
    }
 
-   /* Allocate and parse. */
+   /* Allocate and parse, only saves that changed since they were cached. */
    ok = 0;
    ns = NULL;
+   idx = load_indexRead();
+   dirty = (idx == NULL);
    load_saves = array_create_size( nsave_t, array_size(files) );
    for (i=0; i<array_size(files); i++) {
       if (!ok)
          ns = &array_grow( &load_saves );
       nsnprintf( buf, sizeof(buf), "saves/%s", files[i].name );
+      e = load_indexGet( idx, files[i].name );
+      if ((e != NULL) && (e->modtime == files[i].stat.modtime)
+            && (e->size == files[i].stat.filesize)) {
+         load_copySave( ns, &e->save );
+         ns->path = strdup( buf );
+         ok = 0;
+         continue;
+      }
       ok = load_load( ns, buf );
+      if (!ok) {
+         load_indexSet( &idx, files[i].name, &files[i].stat, ns );
+         dirty = 1;
+      }
    }
 
+   /* Forget saves that are gone. */
+   for (i=array_size(idx)-1; i>=0; i--) {
+      for (j=0; j<array_size(files); j++)
+         if (strcmp( idx[i].file, files[j].name ) == 0)
+            break;
+      if (j < array_size(files))
+         continue;
+      free( idx[i].file );
+      load_freeSave( &idx[i].save );
+      array_erase( &idx, &idx[i], &idx[i+1] );
+      dirty = 1;
+   }
+   if (dirty)
+      load_indexWrite( idx );
+   load_indexFree( idx );
+
    /* If the save was invalid, array is 1 member too large. */
    if (ok)
       array_resize( &load_saves, array_size(load_saves)-1 );
@@ -310,18 +627,9 @@ static int load_sortCompare( const void *p1, const void *p2 )
 void load_free (void)
 {
    int i;
-   nsave_t *ns;
 
-   for (i=0; i<array_size(load_saves); i++) {
-      ns = &load_saves[i];
-      free(ns->path);
-      free(ns->name);
-      free(ns->version);
-      free(ns->data);
-      free(ns->planet);
-      free(ns->shipname);
-      free(ns->shipmodel);
-   }
+   for (i=0; i<array_size(load_saves); i++)
+      load_freeSave( &load_saves[i] );
    array_free( load_saves );
    load_saves = NULL;
 }
@@ -640,8 +948,14 @@ static int load_gameInternal( const char* file, const char* version )
    xmlNodePtr node;
    xmlDocPtr doc;
    Planet *pnt;
+   Uint32 time_ms;
    int version_diff = (version!=NULL) ? naev_versionCompare(version) : 0;
 
+   time_ms = SDL_GetTicks();
+
+   /* The last save may still be being written. */
+   save_flush();
+
    /* Make sure it exists. */
    if (!PHYSFS_exists( file )) {
       dialogue_alert( _("Saved game file seems to have been deleted.") );
@@ -718,6 +1032,8 @@ static int load_gameInternal( const char* file, const char* version )
    /* Set loaded. */
    save_loaded = 1;
 
+   DEBUG( _("Loaded saved game '%s' in %.3f s"), file, (SDL_GetTicks() - time_ms) / 1000. );
+
    return 0;
 
 err_doc:
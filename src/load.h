@@ -43,7 +43,9 @@ int load_game( nsave_t *ns );
 
 int load_refresh (void);
 void load_free (void);
+void load_freeSave( nsave_t *ns );
 const nsave_t *load_getList (void);
+void load_indexUpdate( const nsave_t *ns, int backup );
 
 
 #endif /* LOAD_H */
@@ -40,6 +40,7 @@
 
 #define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before
                                  aborting. */
+#define MAP_DIST_FILTERS   4 /**< Number of ignore_known/show_hidden combinations. */
 
 #define MAP_MARKER_CYCLE  750 /**< Time of a mission marker's animation cycle in milliseconds. */
 
@@ -102,6 +103,8 @@ static void map_selectCur (void);
 static void map_genModeList(void);
 static void map_update_commod_av_price();
 static void map_window_close( unsigned int wid, char *str );
+/* Pathfinding. */
+static void A_free (void);
 
 
 /**
@@ -142,6 +145,8 @@ void map_exit (void)
 
    gl_freeTexture( gl_faction_disk );
 
+   A_free();
+
    if (decorator_stack != NULL) {
       for (i=0; i<array_size(decorator_stack); i++)
          gl_freeTexture( decorator_stack[i].image );
@@ -355,15 +360,11 @@ static void map_update_commod_av_price()
             double thisPrice;
             for ( j=0 ; j<sys->nplanets; j++) {
                p=sys->planets[j];
-               for ( k=0; k<p->ncommodities; k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice+=thisPrice;
-                        sumCnt+=1;
-                        break;
-                     }
-                  }
+               k = planet_commodityIndex( p, c );
+               if ( (k >= 0) && (p->commodityPrice[k].cnt > 0) ) {/*commodity is known about*/
+                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
+                  sumPrice+=thisPrice;
+                  sumCnt+=1;
                }
             }
             if ( sumCnt>0 ) {
@@ -1337,15 +1338,13 @@ void map_renderCommod( double bx, double by, double x, double y,
       curMinPrice=0.;
       sys = system_getIndex( map_selected );
       if ( sys == cur_system && landed ) {
-         for ( k=0; k<land_planet->ncommodities; k++ ) {
-            if ( land_planet->commodities[k] == c ) {
-               /* current planet has the commodity of interest */
-               curMinPrice = land_planet->commodityPrice[k].sum / land_planet->commodityPrice[k].cnt;
-               curMaxPrice = curMinPrice;
-               break;
-            }
+         k = planet_commodityIndex( land_planet, c );
+         if ( k >= 0 ) {
+            /* current planet has the commodity of interest */
+            curMinPrice = land_planet->commodityPrice[k].sum / land_planet->commodityPrice[k].cnt;
+            curMaxPrice = curMinPrice;
          }
-         if ( k == land_planet->ncommodities ) { /* commodity of interest not found */
+         else { /* commodity of interest not found */
             map_renderCommodIgnorance( x, y, sys, c );
             map_renderSysBlack(bx,by,x,y,w,h,r,editor);
             return;
@@ -1357,15 +1356,11 @@ void map_renderCommod( double bx, double by, double x, double y,
             maxPrice=0;
             for ( j=0 ; j<sys->nplanets; j++) {
                p=sys->planets[j];
-               for ( k=0; k<p->ncommodities; k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        if (thisPrice > maxPrice)maxPrice=thisPrice;
-                        if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
-                        break;
-                     }
-                  }
+               k = planet_commodityIndex( p, c );
+               if ( (k >= 0) && (p->commodityPrice[k].cnt > 0) ) {/*commodity is known about*/
+                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
+                  if (thisPrice > maxPrice)maxPrice=thisPrice;
+                  if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
                }
 
             }
@@ -1403,15 +1398,11 @@ void map_renderCommod( double bx, double by, double x, double y,
             maxPrice=0;
             for ( j=0 ; j<sys->nplanets; j++) {
                p=sys->planets[j];
-               for ( k=0; k<p->ncommodities; k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        if (thisPrice > maxPrice)maxPrice=thisPrice;
-                        if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
-                        break;
-                     }
-                  }
+               k = planet_commodityIndex( p, c );
+               if ( (k >= 0) && (p->commodityPrice[k].cnt > 0) ) {/*commodity is known about*/
+                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
+                  if (thisPrice > maxPrice)maxPrice=thisPrice;
+                  if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
                }
             }
 
@@ -1465,15 +1456,11 @@ void map_renderCommod( double bx, double by, double x, double y,
             int sumCnt=0;
             for ( j=0 ; j<sys->nplanets; j++) {
                p=sys->planets[j];
-               for ( k=0; k<p->ncommodities; k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice+=thisPrice;
-                        sumCnt+=1;
-                        break;
-                     }
-                  }
+               k = planet_commodityIndex( p, c );
+               if ( (k >= 0) && (p->commodityPrice[k].cnt > 0) ) {/*commodity is known about*/
+                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
+                  sumPrice+=thisPrice;
+                  sumCnt+=1;
                }
             }
 
@@ -2058,133 +2045,303 @@ void map_select( StarSystem *sys, char shifted )
  * in reality just Djikstras. I've removed the heurestic bit to make sure I
  * don't try to implement an admissible heuristic when I'm pretty sure there is
  * none.
+ *
+ * The jump graph is kept in compressed sparse row form and rebuilt lazily
+ * after map_invalidateJumpGraph(), which systems_reconstructJumps() and
+ * system_rmJump() call whenever jumps change. Per query state is stamped with a
+ * generation so nothing has to be cleared or allocated between searches.
  */
 /**
- * @brief Node structure for A* pathfinding.
+ * @brief Jump graph and search state for pathfinding.
  */
-typedef struct SysNode_ {
-   struct SysNode_ *next; /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem* sys; /**< System in node. */
-   int g; /**< step */
-} SysNode; /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
+typedef struct JumpGraph_ {
+   int valid; /**< Whether the graph matches the systems stack. */
+   int nsys; /**< Number of systems in the graph. */
+   int *start; /**< Offset of the first edge of each system, nsys+1 long. */
+   int *target; /**< Target system of each edge. */
+   int *jump; /**< Jump point of each edge in the source system. */
+
+   unsigned int gen; /**< Current search generation. */
+   unsigned int *open; /**< Generation each system was last opened in. */
+   unsigned int *closed; /**< Generation each system was last closed in. */
+   int *g; /**< Number of jumps to reach each system. */
+   int *parent; /**< System each system was reached from. */
+   unsigned int *order; /**< Open order of each system, to break ties. */
+   int *heap; /**< Binary heap of open systems. */
+   int *hpos; /**< Position of each open system in the heap. */
+   int nheap; /**< Number of systems in the heap. */
+} JumpGraph;
+static JumpGraph A_graph; /**< Jump graph used for pathfinding. */
+/**
+ * @brief Jump distances from each source system for one search filter.
+ *
+ * Rows are filled lazily with a breadth first search and go stale when the
+ * generation is bumped.
+ */
+typedef struct JumpDistCache_ {
+   unsigned int gen; /**< Current generation. */
+   unsigned int *rowgen; /**< Generation each row was computed in. */
+   int **dist; /**< Jumps from each source to each system, -1 if unreachable. */
+} JumpDistCache;
+static JumpDistCache A_dist[MAP_DIST_FILTERS]; /**< Distance caches indexed by search filter. */
 /* prototypes */
-static SysNode* A_newNode( StarSystem* sys );
-static int A_g( SysNode* n );
-static SysNode* A_add( SysNode *first, SysNode *cur );
-static SysNode* A_rm( SysNode *first, StarSystem *cur );
-static SysNode* A_in( SysNode *first, StarSystem *cur );
-static SysNode* A_lowest( SysNode *first );
-static void A_freeList( SysNode *first );
+static void A_build (void);
+static int A_less( int a, int b );
+static void A_heapUp( int i );
+static void A_heapDown( int i );
+static void A_push( int sys );
+static int A_pop (void);
+static int A_canJump( const JumpPoint *jp, const StarSystem *sys,
+      int ignore_known, int show_hidden );
+static const int* A_distRow( int src, int ignore_known, int show_hidden );
 static int map_decorator_parse( MapDecorator *temp, xmlNodePtr parent );
-/** @brief Creates a new node link to star system. */
-static SysNode* A_newNode( StarSystem* sys )
+/** @brief Builds the jump graph from the systems stack. */
+static void A_build (void)
 {
-   SysNode* n;
+   int i, k, n, nsys;
+   StarSystem *sys;
 
-   n        = malloc(sizeof(SysNode));
+   A_free();
+
+   nsys = array_size( systems_stack );
+   n    = 0;
+   for (i=0; i<nsys; i++)
+      n += systems_stack[i].njumps;
+
+   A_graph.nsys   = nsys;
+   A_graph.start  = malloc( sizeof(int) * (nsys+1) );
+   A_graph.target = malloc( sizeof(int) * MAX(n,1) );
+   A_graph.jump   = malloc( sizeof(int) * MAX(n,1) );
+   A_graph.open   = calloc( MAX(nsys,1), sizeof(unsigned int) );
+   A_graph.closed = calloc( MAX(nsys,1), sizeof(unsigned int) );
+   A_graph.g      = malloc( sizeof(int) * MAX(nsys,1) );
+   A_graph.parent = malloc( sizeof(int) * MAX(nsys,1) );
+   A_graph.order  = malloc( sizeof(unsigned int) * MAX(nsys,1) );
+   A_graph.heap   = malloc( sizeof(int) * MAX(nsys,1) );
+   A_graph.hpos   = malloc( sizeof(int) * MAX(nsys,1) );
+   A_graph.gen    = 0;
+
+   n = 0;
+   for (i=0; i<nsys; i++) {
+      sys = &systems_stack[i];
+      A_graph.start[i] = n;
+      for (k=0; k<sys->njumps; k++) {
+         A_graph.target[n] = sys->jumps[k].targetid;
+         A_graph.jump[n]   = k;
+         n++;
+      }
+   }
+   A_graph.start[nsys] = n;
+   A_graph.valid = 1;
+}
+/** @brief Frees the jump graph and the distance caches. */
+static void A_free (void)
+{
+   int i, j;
 
-   n->next  = NULL;
-   n->sys   = sys;
+   free( A_graph.start );
+   free( A_graph.target );
+   free( A_graph.jump );
+   free( A_graph.open );
+   free( A_graph.closed );
+   free( A_graph.g );
+   free( A_graph.parent );
+   free( A_graph.order );
+   free( A_graph.heap );
+   free( A_graph.hpos );
+   for (i=0; i<MAP_DIST_FILTERS; i++) {
+      for (j=0; j<A_graph.nsys; j++)
+         if (A_dist[i].dist != NULL)
+            free( A_dist[i].dist[j] );
+      free( A_dist[i].dist );
+      free( A_dist[i].rowgen );
+   }
+   memset( &A_graph, 0, sizeof(JumpGraph) );
+   memset( A_dist, 0, sizeof(A_dist) );
+}
+/** @brief Compares two open systems, lower cost first then first opened. */
+static int A_less( int a, int b )
+{
+   if (A_graph.g[a] != A_graph.g[b])
+      return (A_graph.g[a] < A_graph.g[b]);
+   return (A_graph.order[a] < A_graph.order[b]);
+}
+/** @brief Moves a heap element up until the heap is ordered. */
+static void A_heapUp( int i )
+{
+   int p, s;
 
-   n->gnext = A_gc;
-   A_gc     = n;
+   s = A_graph.heap[i];
+   while (i > 0) {
+      p = (i-1) / 2;
+      if (!A_less( s, A_graph.heap[p] ))
+         break;
+      A_graph.heap[i] = A_graph.heap[p];
+      A_graph.hpos[ A_graph.heap[i] ] = i;
+      i = p;
+   }
+   A_graph.heap[i] = s;
+   A_graph.hpos[s] = i;
+}
+/** @brief Moves a heap element down until the heap is ordered. */
+static void A_heapDown( int i )
+{
+   int c, s;
 
-   return n;
+   s = A_graph.heap[i];
+   while ((c = 2*i+1) < A_graph.nheap) {
+      if ((c+1 < A_graph.nheap) && A_less( A_graph.heap[c+1], A_graph.heap[c] ))
+         c++;
+      if (!A_less( A_graph.heap[c], s ))
+         break;
+      A_graph.heap[i] = A_graph.heap[c];
+      A_graph.hpos[ A_graph.heap[i] ] = i;
+      i = c;
+   }
+   A_graph.heap[i] = s;
+   A_graph.hpos[s] = i;
 }
-/** @brief Gets the g from a node. */
-static int A_g( SysNode* n )
+/** @brief Adds a system to the open heap. */
+static void A_push( int sys )
 {
-   return n->g;
+   A_graph.heap[ A_graph.nheap ] = sys;
+   A_graph.nheap++;
+   A_heapUp( A_graph.nheap-1 );
 }
-/** @brief Adds a node to the linked list. */
-static SysNode* A_add( SysNode *first, SysNode *cur )
+/** @brief Removes the lowest ranking system from the open heap. */
+static int A_pop (void)
 {
-   SysNode *n;
+   int s;
 
-   if (first == NULL)
-      return cur;
+   s = A_graph.heap[0];
+   A_graph.nheap--;
+   if (A_graph.nheap > 0) {
+      A_graph.heap[0] = A_graph.heap[ A_graph.nheap ];
+      A_heapDown( 0 );
+   }
+   return s;
+}
 
-   n = first;
-   while (n->next != NULL)
-      n = n->next;
-   n->next = cur;
+/** @brief Checks to see if a jump can be used with the search filter. */
+static int A_canJump( const JumpPoint *jp, const StarSystem *sys,
+      int ignore_known, int show_hidden )
+{
+   /* Make sure it's reachable */
+   if (!ignore_known) {
+      if (!jp_isKnown(jp))
+         return 0;
+      if (!sys_isKnown(sys) && !space_sysReachable((StarSystem*)sys))
+         return 0;
+   }
+   if (jp_isFlag( jp, JP_EXITONLY ))
+      return 0;
 
-   return first;
+   /* Skip hidden jumps if they're not specifically requested */
+   if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ))
+      return 0;
+
+   return 1;
 }
-/* @brief Removes a node from a linked list. */
-static SysNode* A_rm( SysNode *first, StarSystem *cur )
+/** @brief Gets the cached jump distances from a system, filling them if needed. */
+static const int* A_distRow( int src, int ignore_known, int show_hidden )
 {
-   SysNode *n, *p;
-
-   if (first->sys == cur) {
-      n = first->next;
-      first->next = NULL;
-      return n;
+   JumpDistCache *c;
+   int *d, *queue;
+   int i, e, t, cur, head, tail;
+
+   c = &A_dist[ (ignore_known ? 1 : 0) | (show_hidden ? 2 : 0) ];
+   if (c->dist == NULL) {
+      c->dist   = calloc( A_graph.nsys, sizeof(int*) );
+      c->rowgen = calloc( A_graph.nsys, sizeof(unsigned int) );
+      c->gen    = 1;
    }
-
-   p = first;
-   n = p->next;
-   do {
-      if (n->sys == cur) {
-         n->next = NULL;
-         p->next = n->next;
-         break;
+   if ((c->dist[src] != NULL) && (c->rowgen[src] == c->gen))
+      return c->dist[src];
+
+   if (c->dist[src] == NULL)
+      c->dist[src] = malloc( sizeof(int) * A_graph.nsys );
+   c->rowgen[src] = c->gen;
+   d = c->dist[src];
+   for (i=0; i<A_graph.nsys; i++)
+      d[i] = -1;
+
+   /* Every jump costs the same so a breadth first search is enough. The heap
+    * is free between searches so it is used as the queue. */
+   queue = A_graph.heap;
+   head  = 0;
+   tail  = 0;
+   d[src] = 0;
+   queue[tail++] = src;
+   while (head < tail) {
+      cur = queue[head++];
+      for (e=A_graph.start[cur]; e<A_graph.start[cur+1]; e++) {
+         t = A_graph.target[e];
+         if (d[t] >= 0)
+            continue;
+         if (!A_canJump( &systems_stack[cur].jumps[ A_graph.jump[e] ],
+                  &systems_stack[t], ignore_known, show_hidden ))
+            continue;
+         d[t] = d[cur] + 1;
+         queue[tail++] = t;
       }
-      p = n;
-   } while ((n=n->next) != NULL);
+   }
 
-   return first;
+   return d;
 }
-/** @brief Checks to see if node is in linked list. */
-static SysNode* A_in( SysNode *first, StarSystem *cur )
-{
-   SysNode *n;
 
-   if (first == NULL)
-      return NULL;
+/**
+ * @brief Marks the jump graph as out of date, it gets rebuilt on the next search.
+ *
+ * Also drops every cached jump distance, including the ones that ignore what
+ * the player knows. Must be called whenever jumps are added or removed.
+ */
+void map_invalidateJumpGraph (void)
+{
+   int i;
 
-   n = first;
-   do {
-      if (n->sys == cur)
-         return n;
-   } while ((n=n->next) != NULL);
-   return NULL;
+   A_graph.valid = 0;
+   for (i=0; i<MAP_DIST_FILTERS; i++)
+      A_dist[i].gen++;
 }
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode* A_lowest( SysNode *first )
-{
-   SysNode *lowest, *n;
 
-   if (first == NULL)
-      return NULL;
+/**
+ * @brief Marks the cached jump distances that depend on what the player knows
+ *        as out of date.
+ *
+ * Must be called whenever the known flag of systems or jump points changes.
+ */
+void map_invalidateJumpDist (void)
+{
+   int i;
 
-   n = first;
-   lowest = n;
-   do {
-      if (n->g < lowest->g)
-         lowest = n;
-   } while ((n=n->next) != NULL);
-   return lowest;
+   for (i=0; i<MAP_DIST_FILTERS; i++)
+      if (!(i & 1))
+         A_dist[i].gen++;
 }
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
+
+/**
+ * @brief Gets the number of jumps between two systems.
+ *
+ * Results are cached per starting system so repeated queries from the same
+ * place are constant time.
+ *
+ *    @param start System to start from.
+ *    @param goal System to end at.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Number of jumps or -1 if there is no path.
+ */
+int map_getJumpDist( const StarSystem *start, const StarSystem *goal,
+      int ignore_known, int show_hidden )
 {
-   SysNode *p, *n;
+   if ((start == NULL) || (goal == NULL))
+      return -1;
 
-   if (first == NULL)
-      return;
+   /* Make sure the graph is up to date. */
+   if (!A_graph.valid || (A_graph.nsys != array_size(systems_stack)))
+      A_build();
 
-   p = NULL;
-   n = first;
-   do {
-      free(p);
-      p = n;
-   } while ((n=n->gnext) != NULL);
-   free(p);
+   return A_distRow( start->id, ignore_known, show_hidden )[ goal->id ];
 }
 
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
@@ -2208,17 +2365,13 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
     const char* sysend, int ignore_known, int show_hidden,
     StarSystem** old_data )
 {
-   int i, j, cost, ojumps;
+   int i, j, e, cost, ojumps;
+   int cur, s, t;
+   unsigned int order;
 
    StarSystem *sys, *ssys, *esys, **res;
    JumpPoint *jp;
 
-   SysNode *cur,   *neighbour;
-   SysNode *open,  *closed;
-   SysNode *ocost, *ccost;
-
-   A_gc = NULL;
-
    /* initial and target systems */
    ssys = system_get(sysstart); /* start */
    esys = system_get(sysend); /* goal */
@@ -2245,17 +2398,35 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
       return NULL;
    }
 
-   /* start the linked lists */
-   open     = closed = NULL;
-   cur      = A_newNode( ssys );
-   cur->parent = NULL;
-   cur->g   = 0;
-   open     = A_add( open, cur ); /* Initial open node is the start system */
+   /* Make sure the graph is up to date. */
+   if (!A_graph.valid || (A_graph.nsys != array_size(systems_stack)))
+      A_build();
 
+   /* New search generation, clear stamps on wrap around. */
+   A_graph.gen++;
+   if (A_graph.gen == 0) {
+      memset( A_graph.open, 0, sizeof(unsigned int) * A_graph.nsys );
+      memset( A_graph.closed, 0, sizeof(unsigned int) * A_graph.nsys );
+      A_graph.gen = 1;
+   }
+   A_graph.nheap = 0;
+   order = 0;
+
+   /* Initial open node is the start system */
+   s = ssys->id;
+   A_graph.open[s]   = A_graph.gen;
+   A_graph.g[s]      = 0;
+   A_graph.parent[s] = -1;
+   A_graph.order[s]  = order++;
+   A_push( s );
+
+   cur = -1;
    j = 0;
-   while ((cur = A_lowest(open))) {
+   while (A_graph.nheap > 0) {
+      cur = A_graph.heap[0];
+
       /* End condition. */
-      if (cur->sys == esys)
+      if (cur == esys->id)
          break;
 
       /* Break if infinite loop. */
@@ -2264,58 +2435,46 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
          break;
 
       /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost   = A_g(cur) + 1; /* Base unit is jump and always increases by 1. */
+      A_pop();
+      A_graph.closed[cur] = A_graph.gen;
+      cost = A_graph.g[cur] + 1; /* Base unit is jump and always increases by 1. */
 
-      for (i=0; i<cur->sys->njumps; i++) {
-         jp  = &cur->sys->jumps[i];
-         sys = jp->target;
+      for (e=A_graph.start[cur]; e<A_graph.start[cur+1]; e++) {
+         jp  = &systems_stack[cur].jumps[ A_graph.jump[e] ];
+         t   = A_graph.target[e];
+         sys = &systems_stack[t];
 
-         /* Make sure it's reachable */
-         if (!ignore_known) {
-            if (!jp_isKnown(jp))
-               continue;
-            if (!sys_isKnown(sys) && !space_sysReachable(sys))
-               continue;
-         }
-         if (jp_isFlag( jp, JP_EXITONLY ))
-            continue;
-
-         /* Skip hidden jumps if they're not specifically requested */
-         if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ))
+         if (!A_canJump( jp, sys, ignore_known, show_hidden ))
             continue;
 
          /* Check to see if it's already in the closed set. */
-         ccost = A_in(closed, sys);
-         if ((ccost != NULL) && (cost >= A_g(ccost)))
+         if ((A_graph.closed[t] == A_graph.gen) && (cost >= A_graph.g[t]))
             continue;
-            //closed = A_rm( closed, sys );
 
-         /* Remove if it exists and current is better. */
-         ocost = A_in(open, sys);
-         if (ocost != NULL) {
-            if (cost < A_g(ocost))
-               open = A_rm( open, sys ); /* New path is better */
-            else
+         /* Update if it exists and current is better. */
+         if (A_graph.open[t] == A_graph.gen) {
+            if (cost >= A_graph.g[t])
                continue; /* This node is worse, so ignore it. */
+            A_graph.g[t]      = cost; /* New path is better */
+            A_graph.parent[t] = cur;
+            A_graph.order[t]  = order++;
+            A_heapUp( A_graph.hpos[t] );
+            continue;
          }
 
-         /* Create the node. */
-         neighbour         = A_newNode( sys );
-         neighbour->parent = cur;
-         neighbour->g      = cost;
-         open              = A_add( open, neighbour );
+         /* Open the node. */
+         A_graph.open[t]   = A_graph.gen;
+         A_graph.closed[t] = 0;
+         A_graph.g[t]      = cost;
+         A_graph.parent[t] = cur;
+         A_graph.order[t]  = order++;
+         A_push( t );
       }
-
-      /* Safety check in case not linked. */
-      if (open == NULL)
-         break;
    }
 
    /* Build path backwards if not broken from loop. */
-   if ( cur != NULL && esys == cur->sys ) {
-      (*njumps) = A_g(cur);
+   if ( cur >= 0 && esys->id == cur ) {
+      (*njumps) = A_graph.g[cur];
       assert( *njumps > 0 );
       if (old_data == NULL)
          res      = malloc( sizeof(StarSystem*) * (*njumps) );
@@ -2325,8 +2484,8 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
       }
       /* Build path. */
       for (i=0; i<((*njumps)-ojumps); i++) {
-         res[(*njumps)-i-1] = cur->sys;
-         cur                = cur->parent;
+         res[(*njumps)-i-1] = &systems_stack[cur];
+         cur                = A_graph.parent[cur];
       }
    }
    else {
@@ -2335,8 +2494,6 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
       free( old_data );
    }
 
-   /* free the linked lists */
-   A_freeList(A_gc);
    return res;
 }
 
@@ -2361,6 +2518,7 @@ int map_map( const Outfit *map )
    for (i=0; i<array_size(map->u.map->jumps);i++)
       jp_setFlag(map->u.map->jumps[i], JP_KNOWN);
 
+   map_invalidateJumpDist();
    return 1;
 }
 
@@ -2414,6 +2572,7 @@ int localmap_map( const Outfit *lmap )
       if (mod*jp->hide <= detect)
          jp_setFlag( jp, JP_KNOWN );
    }
+   map_invalidateJumpDist();
 
    detect = lmap->u.lmap.asset_detect;
    for (i=0; i<cur_system->nplanets; i++) {
@@ -2598,3 +2757,233 @@ static int map_decorator_parse( MapDecorator *temp, xmlNodePtr parent ) {
 
    return 0;
 }
+
+
+#if DEBUGGING
+/*
+ * Reference pathfinding for map_jumpPathBenchmark(), the linked list A* that
+ *  map_getJumpPath() used before the jump graph.
+ */
+/**
+ * @brief Node structure for the reference A* pathfinding.
+ */
+typedef struct SysNode_ {
+   struct SysNode_ *next; /**< Next node */
+   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
+   struct SysNode_ *parent; /**< Parent node. */
+   StarSystem* sys; /**< System in node. */
+   int g; /**< step */
+} SysNode;
+static SysNode *Aref_gc = NULL; /**< All the nodes of the current search. */
+static SysNode* Aref_newNode( StarSystem* sys );
+static SysNode* Aref_add( SysNode *first, SysNode *cur );
+static SysNode* Aref_rm( SysNode *first, StarSystem *cur );
+static SysNode* Aref_in( SysNode *first, StarSystem *cur );
+static SysNode* Aref_lowest( SysNode *first );
+static void Aref_freeList( SysNode *first );
+static int Aref_getJumps( const char* sysstart, const char* sysend,
+      int ignore_known, int show_hidden );
+/** @brief Creates a new node link to star system. */
+static SysNode* Aref_newNode( StarSystem* sys )
+{
+   SysNode* n;
+   n        = malloc(sizeof(SysNode));
+   n->next  = NULL;
+   n->sys   = sys;
+   n->gnext = Aref_gc;
+   Aref_gc  = n;
+   return n;
+}
+/** @brief Adds a node to the linked list. */
+static SysNode* Aref_add( SysNode *first, SysNode *cur )
+{
+   SysNode *n;
+   if (first == NULL)
+      return cur;
+   n = first;
+   while (n->next != NULL)
+      n = n->next;
+   n->next = cur;
+   return first;
+}
+/** @brief Removes a node from a linked list. */
+static SysNode* Aref_rm( SysNode *first, StarSystem *cur )
+{
+   SysNode *n, *p;
+   if (first->sys == cur) {
+      n = first->next;
+      first->next = NULL;
+      return n;
+   }
+   p = first;
+   n = p->next;
+   do {
+      if (n->sys == cur) {
+         p->next = n->next;
+         n->next = NULL;
+         break;
+      }
+      p = n;
+   } while ((n=n->next) != NULL);
+   return first;
+}
+/** @brief Checks to see if node is in linked list. */
+static SysNode* Aref_in( SysNode *first, StarSystem *cur )
+{
+   SysNode *n;
+   for (n=first; n!=NULL; n=n->next)
+      if (n->sys == cur)
+         return n;
+   return NULL;
+}
+/** @brief Returns the lowest ranking node from a linked list of nodes. */
+static SysNode* Aref_lowest( SysNode *first )
+{
+   SysNode *lowest, *n;
+   lowest = first;
+   for (n=first; n!=NULL; n=n->next)
+      if (n->g < lowest->g)
+         lowest = n;
+   return lowest;
+}
+/** @brief Frees all the nodes of a search. */
+static void Aref_freeList( SysNode *first )
+{
+   SysNode *n;
+   while (first != NULL) {
+      n     = first->gnext;
+      free(first);
+      first = n;
+   }
+}
+/**
+ * @brief Gets the number of jumps between two systems with the reference A*.
+ *
+ *    @return Number of jumps or 0 if there is no path.
+ */
+static int Aref_getJumps( const char* sysstart, const char* sysend,
+      int ignore_known, int show_hidden )
+{
+   int i, j, cost, njumps;
+   StarSystem *sys, *ssys, *esys;
+   JumpPoint *jp;
+   SysNode *cur, *neighbour, *open, *closed, *ocost, *ccost;
+
+   ssys = system_get(sysstart);
+   esys = system_get(sysend);
+   if ((ssys == esys) || (ssys->njumps==0))
+      return 0;
+   if (!ignore_known && !sys_isKnown(esys) && !space_sysReachable(esys))
+      return 0;
+
+   Aref_gc     = NULL;
+   open        = closed = NULL;
+   cur         = Aref_newNode( ssys );
+   cur->parent = NULL;
+   cur->g      = 0;
+   open        = Aref_add( open, cur );
+
+   j = 0;
+   while ((cur = Aref_lowest(open))) {
+      if (cur->sys == esys)
+         break;
+      j++;
+      if (j > MAP_LOOP_PROT)
+         break;
+
+      open   = Aref_rm( open, cur->sys );
+      closed = Aref_add( closed, cur );
+      cost   = cur->g + 1;
+
+      for (i=0; i<cur->sys->njumps; i++) {
+         jp  = &cur->sys->jumps[i];
+         sys = jp->target;
+         if (!A_canJump( jp, sys, ignore_known, show_hidden ))
+            continue;
+
+         ccost = Aref_in(closed, sys);
+         if ((ccost != NULL) && (cost >= ccost->g))
+            continue;
+
+         ocost = Aref_in(open, sys);
+         if (ocost != NULL) {
+            if (cost < ocost->g)
+               open = Aref_rm( open, sys );
+            else
+               continue;
+         }
+
+         neighbour         = Aref_newNode( sys );
+         neighbour->parent = cur;
+         neighbour->g      = cost;
+         open              = Aref_add( open, neighbour );
+      }
+      if (open == NULL)
+         break;
+   }
+
+   njumps = ((cur != NULL) && (cur->sys == esys)) ? cur->g : 0;
+   Aref_freeList( Aref_gc );
+   Aref_gc = NULL;
+   return njumps;
+}
+
+
+/**
+ * @brief Times map_getJumpPath() against the old linked list A*.
+ *
+ * Runs a path query from every system to a spread of other systems on the
+ *  whole universe, and checks both find paths of the same length.
+ *
+ *    @param iter Number of rounds of queries.
+ */
+void map_jumpPathBenchmark( int iter )
+{
+   int i, r, n, nq, nj, err;
+   const char *a, *b;
+   StarSystem **path;
+   double freq;
+   Uint64 t0, t1, t2;
+
+   n = array_size(systems_stack);
+   if ((n < 2) || (iter <= 0))
+      return;
+
+   /* Check they agree. */
+   err = 0;
+   for (i=0; i<n; i++) {
+      a    = systems_stack[i].name;
+      b    = systems_stack[ (i*7+1) % n ].name;
+      nj   = 0;
+      path = map_getJumpPath( &nj, a, b, 1, 0, NULL );
+      free( path );
+      if (nj != Aref_getJumps( a, b, 1, 0 ))
+         err++;
+   }
+
+   nq = 0;
+   t0 = SDL_GetPerformanceCounter();
+   for (r=0; r<iter; r++) {
+      for (i=0; i<n; i++) {
+         Aref_getJumps( systems_stack[i].name,
+               systems_stack[ (i*7+r+1) % n ].name, 1, 0 );
+         nq++;
+      }
+   }
+   t1 = SDL_GetPerformanceCounter();
+   for (r=0; r<iter; r++) {
+      for (i=0; i<n; i++) {
+         nj   = 0;
+         path = map_getJumpPath( &nj, systems_stack[i].name,
+               systems_stack[ (i*7+r+1) % n ].name, 1, 0, NULL );
+         free( path );
+      }
+   }
+   t2 = SDL_GetPerformanceCounter();
+
+   freq = (double)SDL_GetPerformanceFrequency() / 1e6;
+   DEBUG(_("Jump path benchmark: %d systems, %d queries, %d mismatches"), n, nq, err);
+   DEBUG(_("   Linked list A*: %.3f us/query"), (double)(t1-t0)/freq/nq);
+   DEBUG(_("   Jump graph: %.3f us/query"), (double)(t2-t1)/freq/nq);
+}
+#endif /* DEBUGGING */
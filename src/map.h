@@ -39,6 +39,13 @@ void map_jump (void);
 /* manipulate universe stuff */
 StarSystem **map_getJumpPath( int *njumps, const char *sysstart, const char *sysend, int ignore_known, int show_hidden,
                               StarSystem **old_data ) WARN_IF( *njumps < 0, "njumps must be >= 0" );
+int map_getJumpDist( const StarSystem *start, const StarSystem *goal,
+      int ignore_known, int show_hidden );
+void map_invalidateJumpGraph (void);
+void map_invalidateJumpDist (void);
+#if DEBUGGING
+void map_jumpPathBenchmark( int iter );
+#endif /* DEBUGGING */
 int map_map( const Outfit *map );
 int map_isMapped( const Outfit* map );
 
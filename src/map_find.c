@@ -305,6 +305,10 @@ static int map_findDistance( StarSystem *sys, Planet *pnt, int *jumps, double *d
       return 0;
    }
 
+   /* Unknown, skip the path search. */
+   if (map_getJumpDist( cur_system, sys, 0, 1 ) < 0)
+      return -1;
+
    /* Calculate jump path. */
    slist = map_getJumpPath( jumps, cur_system->name, sys->name, 0, 1, NULL );
    if (slist==NULL)
@@ -274,7 +274,9 @@ static int mission_meetReq( int mission, int faction,
 
    /* Must meet Lua condition. */
    if (misn->avail.cond != NULL) {
-      c = cond_check(misn->avail.cond);
+      if (misn->avail.cond_chunk == LUA_NOREF)
+         misn->avail.cond_chunk = cond_compile( misn->avail.cond );
+      c = cond_checkChunk( misn->avail.cond_chunk );
       if (c < 0) {
          WARN(_("Conditional for mission '%s' failed to run"), misn->name);
          return 0;
@@ -582,6 +584,7 @@ static void mission_freeData( MissionData* mission )
    free(mission->avail.system);
    free(mission->avail.factions);
    free(mission->avail.cond);
+   cond_freeChunk(mission->avail.cond_chunk);
    free(mission->avail.done);
 
    /* Clear the memory. */
@@ -772,6 +775,7 @@ static int mission_parseXML( MissionData *temp, const xmlNodePtr parent )
 
    /* Defaults. */
    temp->avail.priority = 5;
+   temp->avail.cond_chunk = LUA_NOREF;
 
    /* get the name */
    xmlr_attr_strd(parent,"name",temp->name);
@@ -965,6 +969,66 @@ static int mission_parseFile( const char* file )
 }
 
 
+#if DEBUGGING
+/**
+ * @brief Times the mission conditions, compiled once versus parsed each check.
+ *
+ * Conditions that fail to run in the current state are skipped.
+ *
+ *    @param iter Number of rounds over all the conditions.
+ */
+void missions_condBenchmark( int iter )
+{
+   int i, j, n;
+   int *runs;
+   double freq;
+   Uint64 t0, t1, t2;
+   MissionAvail_t *avail;
+
+   if (iter <= 0)
+      return;
+
+   /* Compile the conditions and keep the ones that run. */
+   runs = array_create( int );
+   for (i=0; i<array_size(mission_stack); i++) {
+      avail = &mission_stack[i].avail;
+      if (avail->cond == NULL)
+         continue;
+      if (avail->cond_chunk == LUA_NOREF)
+         avail->cond_chunk = cond_compile( avail->cond );
+      if (cond_checkChunk( avail->cond_chunk ) >= 0)
+         array_push_back( &runs, i );
+   }
+   n = array_size(runs);
+   if (n == 0) {
+      array_free( runs );
+      return;
+   }
+
+   freq = (double)SDL_GetPerformanceFrequency() / 1e6;
+
+   /* Parsing the condition every check. */
+   t0 = SDL_GetPerformanceCounter();
+   for (j=0; j<iter; j++)
+      for (i=0; i<n; i++)
+         cond_check( mission_stack[ runs[i] ].avail.cond );
+   t1 = SDL_GetPerformanceCounter();
+
+   /* Compiled chunks. */
+   for (j=0; j<iter; j++)
+      for (i=0; i<n; i++)
+         cond_checkChunk( mission_stack[ runs[i] ].avail.cond_chunk );
+   t2 = SDL_GetPerformanceCounter();
+
+   DEBUG(_("Mission condition benchmark: %d conditions, %d iterations"), n, iter);
+   DEBUG(_("   Parsed every check: %.3f us/condition"), (double)(t1-t0)/freq/iter/n);
+   DEBUG(_("   Compiled once: %.3f us/condition"), (double)(t2-t1)/freq/iter/n);
+
+   array_free( runs );
+}
+#endif /* DEBUGGING */
+
+
 /**
  * @brief Frees all the mission data.
  */
@@ -60,6 +60,7 @@ typedef struct MissionAvail_s {
    int nfactions; /**< Number of factions in factions. */
 
    char* cond; /**< Condition that must be met (Lua). */
+   int cond_chunk; /**< Compiled condition, LUA_NOREF until first checked. */
    char* done; /**< Previous mission that must have been done. */
 
    int priority; /**< Mission priority: 0 = main plot, 5 = default, 10 = insignificant. */
@@ -169,6 +170,9 @@ void mission_cleanup( Mission* misn );
 void mission_shift( int pos );
 void missions_free (void);
 void missions_cleanup (void);
+#if DEBUGGING
+void missions_condBenchmark( int iter );
+#endif /* DEBUGGING */
 
 /*
  * Actually in nlua_misn.h
@@ -87,6 +87,7 @@
 #include "pilot.h"
 #include "player.h"
 #include "rng.h"
+#include "save.h"
 #include "semver.h"
 #include "ship.h"
 #include "slots.h"
@@ -127,6 +128,27 @@ const double fps_min    = 1./30.; /**< Minimum fps to run at. */
 static double fps_x     =  15.; /**< FPS X position. */
 static double fps_y     = -15.; /**< FPS Y position. */
 
+/*
+ * Loading stages.
+ */
+/**
+ * @brief A data loading stage.
+ *
+ * Stages are loaded in order on the main thread, as they create textures,
+ * sounds and Lua state. The stages with many data files also have a parse
+ * step that only reads and parses the files in the threadpool. It doesn't
+ * depend on any other stage, so all of them are started before the first
+ * stage loads and the files get parsed while the earlier stages run. Stages
+ * without a message are fast and don't update the loading screen.
+ */
+typedef struct LoadStage_ {
+   const char *name; /**< Name for the logs. */
+   const char *msg; /**< Loading screen message (untranslated). */
+   int (*parse)(void); /**< Starts parsing the files in the background, or NULL. */
+   int (*load)(void); /**< Loading function, waits for the parsing. */
+} LoadStage;
+
+
 #if HAS_LINUX && HAS_BFD && defined(DEBUGGING)
 static bfd *abfd      = NULL;
 static asymbol **syms = NULL;
@@ -139,6 +161,8 @@ static asymbol **syms = NULL;
 static void print_SDLversion (void);
 static void loadscreen_load (void);
 static void loadscreen_unload (void);
+static int load_maps (void);
+static int load_player (void);
 static void load_all (void);
 static void unload_all (void);
 static void display_fps( const double dt );
@@ -156,6 +180,30 @@ void loadscreen_render( double done, const char *msg ); /* nebula.c */
 void main_loop( int update ); /* dialogue.c */
 
 
+/**
+ * @brief The loading stages, order is very important as they're interdependent.
+ */
+static const LoadStage load_stages[] = {
+   { "slots", NULL, NULL, sp_load },
+   { "commodities", N_("Loading Commodities..."), NULL, commodity_load }, /* dep for space */
+   { "factions", N_("Loading Factions..."), NULL, factions_load }, /* dep for fleet, space, missions, AI */
+   { "AI", N_("Loading AI..."), NULL, ai_load }, /* dep for fleets */
+   { "missions", N_("Loading Missions..."), NULL, missions_load },
+   { "events", N_("Loading Events..."), NULL, events_load },
+   { "special effects", N_("Loading Special Effects..."), NULL, spfx_load }, /* dep for damage types, outfits */
+   { "damage types", N_("Loading Damage Types..."), NULL, dtype_load }, /* dep for outfits */
+   { "outfits", N_("Loading Outfits..."), outfit_prefetch, outfit_load }, /* dep for ships */
+   { "ships", N_("Loading Ships..."), ships_prefetch, ships_load }, /* dep for fleet */
+   { "fleets", N_("Loading Fleets..."), NULL, fleet_load }, /* dep for space */
+   { "techs", N_("Loading Techs..."), NULL, tech_load }, /* dep for space */
+   { "universe", N_("Loading the Universe..."), space_prefetch, space_load },
+   { "unidiffs", N_("Loading the UniDiffs..."), NULL, diff_loadAvailable },
+   { "maps", N_("Populating Maps..."), NULL, load_maps },
+   { "player", NULL, NULL, load_player },
+};
+#define LOAD_STAGES  (int)(sizeof(load_stages)/sizeof(load_stages[0])) /**< Number of loading stages. */
+
+
 /**
  * @brief Flags naev to quit.
  */
@@ -439,6 +487,9 @@ int main( int argc, char** argv )
    /* Save configuration. */
    conf_saveConfig(buf);
 
+   /* Make sure the last save made it to disk. */
+   save_flush();
+
    /* data unloading */
    unload_all();
 
@@ -608,50 +659,60 @@ static void loadscreen_unload (void)
 
 
 /**
- * @brief Loads all the data, makes main() simpler.
+ * @brief Loads the outfit maps and map data.
  */
-#define LOADING_STAGES     13. /**< Amount of loading stages. */
-void load_all (void)
+static int load_maps (void)
 {
-   /* We can do fast stuff here. */
-   sp_load();
-
-   /* order is very important as they're interdependent */
-   loadscreen_render( 1./LOADING_STAGES, _("Loading Commodities...") );
-   commodity_load(); /* dep for space */
-   loadscreen_render( 2./LOADING_STAGES, _("Loading Factions...") );
-   factions_load(); /* dep for fleet, space, missions, AI */
-   loadscreen_render( 3./LOADING_STAGES, _("Loading AI...") );
-   ai_load(); /* dep for fleets */
-   loadscreen_render( 4./LOADING_STAGES, _("Loading Missions...") );
-   missions_load(); /* no dep */
-   loadscreen_render( 5./LOADING_STAGES, _("Loading Events...") );
-   events_load(); /* no dep */
-   loadscreen_render( 6./LOADING_STAGES, _("Loading Special Effects...") );
-   spfx_load(); /* no dep */
-   loadscreen_render( 6./LOADING_STAGES, _("Loading Damage Types...") );
-   dtype_load(); /* no dep */
-   loadscreen_render( 7./LOADING_STAGES, _("Loading Outfits...") );
-   outfit_load(); /* dep for ships */
-   loadscreen_render( 8./LOADING_STAGES, _("Loading Ships...") );
-   ships_load(); /* dep for fleet */
-   loadscreen_render( 9./LOADING_STAGES, _("Loading Fleets...") );
-   fleet_load(); /* dep for space */
-   loadscreen_render( 10./LOADING_STAGES, _("Loading Techs...") );
-   tech_load(); /* dep for space */
-   loadscreen_render( 11./LOADING_STAGES, _("Loading the Universe...") );
-   space_load();
-   loadscreen_render( 12./LOADING_STAGES, _("Loading the UniDiffs...") );
-   diff_loadAvailable();
-   loadscreen_render( 13./LOADING_STAGES, _("Populating Maps...") );
    outfit_mapParse();
    background_init();
    map_load();
    map_system_load();
+   return 0;
+}
+
+
+/**
+ * @brief Initializes the subsystems that need all the data loaded.
+ */
+static int load_player (void)
+{
    pilots_init();
    weapon_init();
    player_init(); /* Initialize player stuff. */
+   return 0;
+}
+
+
+/**
+ * @brief Loads all the data, makes main() simpler.
+ */
+void load_all (void)
+{
+   Uint32 time_ms, stage_ms;
+   int i;
+   const LoadStage *stage;
+
+   time_ms = SDL_GetTicks();
+
+   /* Parse the data files of all the stages in the background. */
+   for (i=0; i<LOAD_STAGES; i++) {
+      stage = &load_stages[i];
+      if ((stage->parse != NULL) && (stage->parse() < 0))
+         WARN(_("Failed to parse %s"), stage->name);
+   }
+
+   for (i=0; i<LOAD_STAGES; i++) {
+      stage = &load_stages[i];
+      if (stage->msg != NULL)
+         loadscreen_render( (double)(i+1) / (LOAD_STAGES+1), _(stage->msg) );
+      stage_ms = SDL_GetTicks();
+      if (stage->load() < 0)
+         WARN(_("Failed to load %s"), stage->name);
+      DEBUG( _("Loaded %s in %.3f s"), stage->name, (SDL_GetTicks() - stage_ms) / 1000. );
+   }
    loadscreen_render( 1., _("Loading Completed!") );
+
+   DEBUG( _("Loaded all data in %.3f s"), (SDL_GetTicks() - time_ms) / 1000. );
 }
 /**
  * @brief Unloads all data, simplifies main().
@@ -712,6 +773,12 @@ void main_loop( int update )
    /* Safe hook should be run every frame regardless of whether game is paused or not. */
    hooks_run( "safe" );
 
+   /* Upload images decoded in the background. */
+   gl_texUpdate();
+
+   /* Report saves written in the background. */
+   save_update();
+
    /*
     * Handle render.
     */
@@ -997,6 +1064,11 @@ static void display_fps( const double dt )
 {
    double x,y;
    double dt_mod_base = 1.;
+#if DEBUGGING
+   int coll_tested, coll_pruned;
+   size_t tex_queued, tex_decoded, tex_uploaded;
+   int batch_draws, batch_sprites;
+#endif /* DEBUGGING */
 
    fps_dt  += dt;
    fps_cur += 1.;
@@ -1005,11 +1077,29 @@ static void display_fps( const double dt )
       fps_dt = fps_cur = 0.;
    }
 
+#if DEBUGGING
+   /* Always read to reset the counters. */
+   gl_batchStats( &batch_draws, &batch_sprites );
+#endif /* DEBUGGING */
+
    x = fps_x;
    y = fps_y;
    if (conf.fps_show) {
       gl_print( NULL, x, y, NULL, "%3.2f", fps );
       y -= gl_defFont.h + 5.;
+#if DEBUGGING
+      weapon_gridStats( &coll_tested, &coll_pruned );
+      gl_print( NULL, x, y, NULL, _("%d collision pairs (%d pruned)"),
+            coll_tested, coll_pruned );
+      y -= gl_defFont.h + 5.;
+      gl_texStats( &tex_queued, &tex_decoded, &tex_uploaded );
+      gl_print( NULL, x, y, NULL, _("Textures: %zu KiB queued, %zu KiB decoded, %zu KiB uploaded"),
+            tex_queued / 1024, tex_decoded / 1024, tex_uploaded / 1024 );
+      y -= gl_defFont.h + 5.;
+      gl_print( NULL, x, y, NULL, _("%d texture draw calls (%d sprites)"),
+            batch_draws, batch_sprites );
+      y -= gl_defFont.h + 5.;
+#endif /* DEBUGGING */
    }
 
    if ((player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
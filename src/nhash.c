@@ -0,0 +1,212 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nhash.c
+ *
+ * @brief Open addressing hash index for looking up stack elements by name.
+ *
+ * Used by the by-name getters (outfit_get, system_get, ...) which used to
+ * walk the whole stack with strcmp.
+ */
+
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "nhash.h"
+
+#include "log.h"
+
+
+#define NHASH_MIN_SIZE     64 /**< Minimum number of slots. */
+
+
+/*
+ * Prototypes.
+ */
+static unsigned int nhash_hash( const char *key );
+static void nhash_grow( NameHash *h );
+
+
+/**
+ * @brief FNV-1a hash of a string.
+ */
+static unsigned int nhash_hash( const char *key )
+{
+   unsigned int hash;
+   const unsigned char *c;
+
+   hash = 2166136261u;
+   for (c=(const unsigned char*)key; *c!='\0'; c++) {
+      hash ^= *c;
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+
+/**
+ * @brief Initializes an empty hash index.
+ *
+ *    @param h Index to initialize.
+ */
+void nhash_init( NameHash *h )
+{
+   memset( h, 0, sizeof(NameHash) );
+}
+
+
+/**
+ * @brief Removes all the keys from a hash index, keeping the memory.
+ *
+ *    @param h Index to clear.
+ */
+void nhash_clear( NameHash *h )
+{
+   if (h->keys != NULL)
+      memset( h->keys, 0, sizeof(const char*) * h->size );
+   h->n = 0;
+}
+
+
+/**
+ * @brief Frees a hash index.
+ *
+ *    @param h Index to free.
+ */
+void nhash_free( NameHash *h )
+{
+   free( h->keys );
+   free( h->values );
+   nhash_init( h );
+}
+
+
+/**
+ * @brief Doubles the slots of a hash index and rehashes the keys.
+ */
+static void nhash_grow( NameHash *h )
+{
+   int i, size;
+   const char **keys;
+   int *values;
+
+   keys   = h->keys;
+   values = h->values;
+   size   = h->size;
+
+   h->size   = MAX( NHASH_MIN_SIZE, 2*size );
+   h->keys   = calloc( h->size, sizeof(const char*) );
+   h->values = malloc( h->size * sizeof(int) );
+   if ((h->keys == NULL) || (h->values == NULL))
+      ERR(_("Out of Memory"));
+   h->n      = 0;
+
+   for (i=0; i<size; i++)
+      if (keys[i] != NULL)
+         nhash_add( h, keys[i], values[i] );
+
+   free( keys );
+   free( values );
+}
+
+
+/**
+ * @brief Adds a key to a hash index.
+ *
+ * If the key is already there the old value is kept, so with duplicate
+ * names the first element loaded wins like with a linear search.
+ *
+ *    @param h Index to add to.
+ *    @param key Key to add, not copied.
+ *    @param value Value to associate with the key.
+ *    @return 0 if added, 1 if the key was already in the index.
+ */
+int nhash_add( NameHash *h, const char *key, int value )
+{
+   unsigned int i, mask;
+
+   /* Keep the load factor under 1/2. */
+   if (2*(h->n+1) > h->size)
+      nhash_grow( h );
+
+   mask = h->size-1;
+   for (i=nhash_hash(key) & mask; h->keys[i]!=NULL; i=(i+1) & mask)
+      if (strcmp( h->keys[i], key )==0)
+         return 1;
+
+   h->keys[i]   = key;
+   h->values[i] = value;
+   h->n++;
+   return 0;
+}
+
+
+/**
+ * @brief Looks up a key in a hash index.
+ *
+ *    @param h Index to look in.
+ *    @param key Key to look up.
+ *    @return The value of the key or -1 if not found.
+ */
+int nhash_get( const NameHash *h, const char *key )
+{
+   unsigned int i, mask;
+
+   if ((h->n == 0) || (key == NULL))
+      return -1;
+
+   mask = h->size-1;
+   for (i=nhash_hash(key) & mask; h->keys[i]!=NULL; i=(i+1) & mask)
+      if (strcmp( h->keys[i], key )==0)
+         return h->values[i];
+
+   return -1;
+}
+
+
+/**
+ * @brief Removes a key from a hash index.
+ *
+ * The following keys of the probe sequence get shifted back so lookups
+ * don't need tombstones.
+ *
+ *    @param h Index to remove from.
+ *    @param key Key to remove.
+ *    @return The value the key had or -1 if not found.
+ */
+int nhash_remove( NameHash *h, const char *key )
+{
+   unsigned int i, j, k, mask;
+   int value;
+
+   if ((h->n == 0) || (key == NULL))
+      return -1;
+
+   mask = h->size-1;
+   for (i=nhash_hash(key) & mask; h->keys[i]!=NULL; i=(i+1) & mask)
+      if (strcmp( h->keys[i], key )==0)
+         break;
+   if (h->keys[i] == NULL)
+      return -1;
+   value = h->values[i];
+   h->n--;
+
+   /* Fill the hole with keys that would no longer be found. */
+   for (j=(i+1) & mask; h->keys[j]!=NULL; j=(j+1) & mask) {
+      k = nhash_hash( h->keys[j] ) & mask;
+      /* Key is still reachable if its home slot is between the hole and it. */
+      if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+         continue;
+      h->keys[i]   = h->keys[j];
+      h->values[i] = h->values[j];
+      i = j;
+   }
+   h->keys[i] = NULL;
+   return value;
+}
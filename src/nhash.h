@@ -0,0 +1,32 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NHASH_H
+#  define NHASH_H
+
+
+/**
+ * @brief Hash index mapping names to stack indices.
+ *
+ * Keys are not copied, they must point to the name owned by the indexed
+ * element and stay valid until the index is cleared.
+ */
+typedef struct NameHash_ {
+   const char **keys; /**< Interned keys, NULL if the slot is empty. */
+   int *values; /**< Values of the slots. */
+   int size; /**< Number of slots, always a power of two. */
+   int n; /**< Number of used slots. */
+} NameHash;
+
+
+void nhash_init( NameHash *h );
+void nhash_clear( NameHash *h );
+void nhash_free( NameHash *h );
+int nhash_add( NameHash *h, const char *key, int value );
+int nhash_get( const NameHash *h, const char *key );
+int nhash_remove( NameHash *h, const char *key );
+
+
+#endif /* NHASH_H */
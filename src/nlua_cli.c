@@ -16,13 +16,37 @@
 
 #include "nlua_cli.h"
 
+#include "collision.h"
+#include "economy.h"
+#include "faction.h"
 #include "log.h"
+#include "map.h"
 #include "mission.h"
 #include "nluadef.h"
+#include "opengl_tex.h"
+#include "outfit.h"
+#include "ship.h"
 
 
 /* CLI */
+static int cliL_texMemory( lua_State *L );
+#if DEBUGGING
+static int cliL_economyBenchmark( lua_State *L );
+static int cliL_collideBenchmark( lua_State *L );
+static int cliL_jumpPathBenchmark( lua_State *L );
+static int cliL_factionBenchmark( lua_State *L );
+static int cliL_condBenchmark( lua_State *L );
+static glTexture* cli_collideGfx( lua_State *L, int ind );
+#endif /* DEBUGGING */
 static const luaL_Reg cli_methods[] = {
+   { "texMemory", cliL_texMemory },
+#if DEBUGGING
+   { "economyBenchmark", cliL_economyBenchmark },
+   { "collideBenchmark", cliL_collideBenchmark },
+   { "jumpPathBenchmark", cliL_jumpPathBenchmark },
+   { "factionBenchmark", cliL_factionBenchmark },
+   { "condBenchmark", cliL_condBenchmark },
+#endif /* DEBUGGING */
    {0,0}
 }; /**< CLI Lua methods. */
 
@@ -39,3 +63,135 @@ int nlua_loadCLI( nlua_env env )
    return 0;
 }
 
+
+/**
+ * @brief Gets the estimated video memory used by textures.
+ *
+ * @usage cli.texMemory() -- Printed by the console
+ *
+ *    @luatreturn number Kilobytes of all the cached textures.
+ *    @luatreturn number Number of cached textures.
+ *    @luatreturn number Kilobytes of the cached textures not in use.
+ *    @luatreturn number Number of cached textures not in use.
+ * @luafunc texMemory
+ */
+static int cliL_texMemory( lua_State *L )
+{
+   int ntex, nunused;
+   size_t mem, unused;
+
+   mem = gl_texMemory( &ntex, &nunused, &unused );
+   lua_pushnumber( L, mem / 1024 );
+   lua_pushnumber( L, ntex );
+   lua_pushnumber( L, unused / 1024 );
+   lua_pushnumber( L, nunused );
+   return 4;
+}
+
+
+#if DEBUGGING
+/**
+ * @brief Times the economy solvers on the current universe.
+ *
+ * @usage cli.economyBenchmark( 10 ) -- Results are printed to the log
+ *
+ *    @luatparam[opt=10] number iter Number of solves to time.
+ * @luafunc economyBenchmark
+ */
+static int cliL_economyBenchmark( lua_State *L )
+{
+   economy_benchmark( luaL_optinteger( L, 1, 10 ) );
+   return 0;
+}
+
+
+/**
+ * @brief Gets the space sprite sheet of a ship or outfit for collideBenchmark.
+ */
+static glTexture* cli_collideGfx( lua_State *L, int ind )
+{
+   const char *name;
+   Ship *s;
+   Outfit *o;
+   glTexture *gfx;
+
+   name = luaL_checkstring( L, ind );
+   s    = ship_getW( name );
+   if (s != NULL)
+      return s->gfx_space;
+   o    = outfit_getW( name );
+   gfx  = (o != NULL) ? outfit_gfx( o ) : NULL;
+   if ((gfx == NULL) || outfit_isBeam( o ))
+      NLUA_ERROR( L, _("'%s' is not a ship nor a bolt or ammo outfit."), name );
+   return gfx;
+}
+
+
+/**
+ * @brief Times the pixel perfect collisions between two sprite sheets.
+ *
+ * Bolt outfit sheets have many frames, so they should be tested too.
+ *
+ * @usage cli.collideBenchmark( "Kestrel", "Llama" ) -- Results are printed to the log
+ * @usage cli.collideBenchmark( "Kestrel", "Laser Cannon MK1" ) -- Against a bolt
+ *
+ *    @luatparam string a Name of the first ship or outfit.
+ *    @luatparam string b Name of the second ship or outfit.
+ *    @luatparam[opt=10] number iter Number of sweeps to time.
+ * @luafunc collideBenchmark
+ */
+static int cliL_collideBenchmark( lua_State *L )
+{
+   glTexture *a, *b;
+
+   a = cli_collideGfx( L, 1 );
+   b = cli_collideGfx( L, 2 );
+   CollideSpriteBenchmark( a, b, luaL_optinteger( L, 3, 10 ) );
+   return 0;
+}
+
+
+/**
+ * @brief Times jump pathfinding on the whole universe.
+ *
+ * @usage cli.jumpPathBenchmark( 10 ) -- Results are printed to the log
+ *
+ *    @luatparam[opt=10] number iter Number of rounds of queries.
+ * @luafunc jumpPathBenchmark
+ */
+static int cliL_jumpPathBenchmark( lua_State *L )
+{
+   map_jumpPathBenchmark( luaL_optinteger( L, 1, 10 ) );
+   return 0;
+}
+
+
+/**
+ * @brief Times faction relation checks on all the factions.
+ *
+ * @usage cli.factionBenchmark( 1000 ) -- Results are printed to the log
+ *
+ *    @luatparam[opt=1000] number iter Number of rounds over all the faction pairs.
+ * @luafunc factionBenchmark
+ */
+static int cliL_factionBenchmark( lua_State *L )
+{
+   faction_benchmark( luaL_optinteger( L, 1, 1000 ) );
+   return 0;
+}
+
+
+/**
+ * @brief Times the mission conditions checked when landing.
+ *
+ * @usage cli.condBenchmark( 100 ) -- Results are printed to the log
+ *
+ *    @luatparam[opt=100] number iter Number of rounds over all the conditions.
+ * @luafunc condBenchmark
+ */
+static int cliL_condBenchmark( lua_State *L )
+{
+   missions_condBenchmark( luaL_optinteger( L, 1, 100 ) );
+   return 0;
+}
+#endif /* DEBUGGING */
@@ -21,6 +21,7 @@
 #include "nlua_system.h"
 #include "land_outfits.h"
 #include "log.h"
+#include "map.h"
 
 
 RETURNS_NONNULL static JumpPoint *luaL_validjumpSystem( lua_State *L, int ind, int *offset );
@@ -445,6 +446,7 @@ static int jumpL_setKnown( lua_State *L )
       jp_setFlag( jp, JP_KNOWN );
    else
       jp_rmFlag( jp, JP_KNOWN );
+   map_invalidateJumpDist();
 
    /* Update outfits image array. */
    if (changed)
@@ -472,6 +472,14 @@ static int texL_setFilter( lua_State *L )
    if (min==0 || mag==0)
       NLUA_INVALID_PARAMETER(L);
 
+   /* Parameters set on the placeholder would get lost. */
+   if (tex->pending)
+      gl_texFlush();
+   if (tex->atlas) {
+      WARN(_("Texture '%s' shares an atlas page, not changing its parameters."), tex->name);
+      return 0;
+   }
+
    glBindTexture( GL_TEXTURE_2D, tex->texture );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min );
@@ -505,6 +513,14 @@ static int texL_setWrap( lua_State *L )
    if (horiz==0 || vert==0 || depth==0)
       NLUA_INVALID_PARAMETER(L);
 
+   /* Parameters set on the placeholder would get lost. */
+   if (tex->pending)
+      gl_texFlush();
+   if (tex->atlas) {
+      WARN(_("Texture '%s' shares an atlas page, not changing its parameters."), tex->name);
+      return 0;
+   }
+
    glBindTexture( GL_TEXTURE_2D, tex->texture );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, horiz );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, vert );
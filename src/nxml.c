@@ -10,13 +10,52 @@
 
 
 /** @cond */
+#include "SDL.h"
+#include "SDL_mutex.h"
+
 #include "naev.h"
 /** @endcond */
 
 #include "nxml.h"
 
+#include "array.h"
+#include "log.h"
 #include "ndata.h"
 #include "nstring.h"
+#include "threadpool.h"
+
+
+#define XML_PARSE_JOBS     32 /**< Maximum number of parallel parsing jobs. */
+
+
+/**
+ * @brief A chunk of files to parse in a threadpool job.
+ */
+typedef struct XmlParseJob_ {
+   char *const *files; /**< Files to parse. */
+   xmlDocPtr *docs; /**< Where to put the documents. */
+   int start; /**< First file of the chunk. */
+   int end; /**< One past the last file of the chunk. */
+   SDL_sem *done; /**< Posted when the chunk is parsed. */
+} XmlParseJob;
+
+
+/**
+ * @brief Files being parsed in the background.
+ */
+struct XmlParseBatch_ {
+   char **files; /**< Files to parse (array.h). */
+   xmlDocPtr *docs; /**< Parsed documents (array.h). */
+   XmlParseJob *jobs; /**< Jobs parsing the chunks. */
+   int njobs; /**< Number of jobs. */
+   SDL_sem *done; /**< Posted once for each finished job. */
+};
+
+
+/*
+ * Prototypes.
+ */
+static int xml_parseJob( void *data );
 
 
 /**
@@ -100,3 +139,102 @@ xmlDocPtr xml_parsePhysFS( const char* filename )
    free( buf );
    return doc;
 }
+
+
+/**
+ * @brief Parses a chunk of files on a worker thread.
+ */
+static int xml_parseJob( void *data )
+{
+   int i;
+   XmlParseJob *job = (XmlParseJob*) data;
+
+   for (i=job->start; i<job->end; i++)
+      job->docs[i] = xml_parsePhysFS( job->files[i] );
+   SDL_SemPost( job->done );
+   return 0;
+}
+
+
+/**
+ * @brief Starts parsing a list of files in parallel on the threadpool.
+ *
+ * Only reading and parsing are done on the worker threads, the documents are
+ * meant to be processed on the calling thread after xml_parsePhysFSFinish.
+ * This lets a loader parse its files while the ones before it run.
+ *
+ *    @param files Files to parse (array.h), must not be changed until the
+ *           batch is finished.
+ *    @return The batch to pass to xml_parsePhysFSFinish.
+ */
+XmlParseBatch* xml_parsePhysFSStart( char **files )
+{
+   int i, n;
+   XmlParseBatch *batch;
+
+   n            = array_size( files );
+   batch        = calloc( 1, sizeof(XmlParseBatch) );
+   batch->files = files;
+   batch->docs  = array_create_size( xmlDocPtr, MAX(n,1) );
+   if (n == 0)
+      return batch;
+   array_resize( &batch->docs, n );
+
+   /* Split into chunks. */
+   batch->njobs = MIN( n, XML_PARSE_JOBS );
+   batch->jobs  = malloc( batch->njobs * sizeof(XmlParseJob) );
+   batch->done  = SDL_CreateSemaphore( 0 );
+   for (i=0; i<batch->njobs; i++) {
+      batch->jobs[i].files = files;
+      batch->jobs[i].docs  = batch->docs;
+      batch->jobs[i].start = (int)((long)n * i / batch->njobs);
+      batch->jobs[i].end   = (int)((long)n * (i+1) / batch->njobs);
+      batch->jobs[i].done  = batch->done;
+      threadpool_newJob( xml_parseJob, &batch->jobs[i] );
+   }
+
+   return batch;
+}
+
+
+/**
+ * @brief Waits for the files of a batch to be parsed.
+ *
+ *    @param batch Batch from xml_parsePhysFSStart, freed.
+ *    @param[out] files The files of the batch, can be NULL.
+ *    @return The parsed documents in the same order as the files, NULL where
+ *            parsing failed (array.h). Free the documents and the array.
+ */
+xmlDocPtr* xml_parsePhysFSFinish( XmlParseBatch *batch, char ***files )
+{
+   int i;
+   xmlDocPtr *docs;
+
+   for (i=0; i<batch->njobs; i++)
+      SDL_SemWait( batch->done );
+   if (batch->done != NULL)
+      SDL_DestroySemaphore( batch->done );
+
+   docs = batch->docs;
+   if (files != NULL)
+      *files = batch->files;
+   free( batch->jobs );
+   free( batch );
+   return docs;
+}
+
+
+/**
+ * @brief Parses a list of files in parallel on the threadpool.
+ *
+ * Only reading and parsing are done on the worker threads, the documents are
+ * meant to be processed on the calling thread.
+ *
+ *    @param files Files to parse (array.h).
+ *    @return The parsed documents in the same order as the files, NULL where
+ *            parsing failed (array.h). Free the documents and the array.
+ */
+xmlDocPtr* xml_parsePhysFSArray( char **files )
+{
+   return xml_parsePhysFSFinish( xml_parsePhysFSStart( files ), NULL );
+}
@@ -32,6 +32,9 @@
 #define XML_NODE_START  1
 #define XML_NODE_TEXT   3
 
+struct XmlParseBatch_;
+typedef struct XmlParseBatch_ XmlParseBatch; /**< Files being parsed in the background, see xml_parsePhysFSStart. */
+
 /**
  * @brief Only handle nodes.
  */
@@ -143,6 +146,9 @@ do {if (xmlTextWriterEndDocument(w) < 0) { \
  * Functions for generic complex reading.
  */
 xmlDocPtr xml_parsePhysFS( const char* filename );
+xmlDocPtr* xml_parsePhysFSArray( char **files );
+XmlParseBatch* xml_parsePhysFSStart( char **files );
+xmlDocPtr* xml_parsePhysFSFinish( XmlParseBatch *batch, char ***files );
 glTexture* xml_parseTexture( xmlNodePtr node,
       const char *path, int defsx, int defsy,
       const unsigned int flags );
@@ -0,0 +1,289 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file opengl_atlas.c
+ *
+ * @brief Packs sprite sheets into shared atlas pages.
+ *
+ * Textures loaded with OPENGL_TEX_ATLAS are copied into a larger page
+ * texture instead of getting their own, so sprites of different effects can
+ * be drawn in the same batch. The glTexture keeps its real dimensions and
+ * transparency map, only the texture and the atlas offsets change, see
+ * gl_blitTexture.
+ *
+ * Pages have no mipmaps, so textures wanting OPENGL_TEX_MIPMAPS always keep
+ * their own texture, otherwise they would alias when zoomed out.
+ *
+ * Pages are packed with shelves and space is only reclaimed when every
+ * texture in a page is freed.
+ */
+
+
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "opengl_atlas.h"
+
+#include "array.h"
+#include "conf.h"
+#include "log.h"
+#include "opengl.h"
+
+
+#define OPENGL_ATLAS_SIZE  2048 /**< Width and height of the atlas pages. */
+#define OPENGL_ATLAS_MAX   1024 /**< Images larger than this keep their own texture. */
+#define OPENGL_ATLAS_PAD   2    /**< Transparent border around the images so filtering doesn't bleed. */
+
+
+/**
+ * @brief Row of images in an atlas page.
+ */
+typedef struct glAtlasShelf_ {
+   int y; /**< Top of the shelf. */
+   int h; /**< Height of the shelf. */
+   int x; /**< Used width of the shelf. */
+} glAtlasShelf;
+
+
+/**
+ * @brief Texture holding many images.
+ */
+typedef struct glAtlasPage_ {
+   GLuint texture; /**< Page texture, 0 if the page is free. */
+   glAtlasShelf *shelves; /**< Shelves of the page (array.h). */
+   int top; /**< Height used by the shelves. */
+   int used; /**< Number of textures packed in the page. */
+} glAtlasPage;
+
+
+static glAtlasPage *gl_atlasPages = NULL; /**< Atlas pages (array.h). */
+
+
+/*
+ * Prototypes.
+ */
+static int gl_atlasFit( glAtlasPage *page, int w, int h, int *x, int *y );
+static int gl_atlasPageNew (void);
+
+
+/**
+ * @brief Finds room for an image in a page.
+ *
+ * Uses the shelf with the closest height or opens a new one.
+ *
+ *    @param page Page to pack into.
+ *    @param w Width of the image with padding.
+ *    @param h Height of the image with padding.
+ *    @param[out] x X position of the image.
+ *    @param[out] y Y position of the image.
+ *    @return 0 on success, -1 if it doesn't fit.
+ */
+static int gl_atlasFit( glAtlasPage *page, int w, int h, int *x, int *y )
+{
+   int i, best;
+   glAtlasShelf *s;
+
+   best = -1;
+   for (i=0; i<array_size(page->shelves); i++) {
+      s = &page->shelves[i];
+      if ((s->h < h) || (s->x + w > OPENGL_ATLAS_SIZE))
+         continue;
+      if ((best < 0) || (s->h < page->shelves[best].h))
+         best = i;
+   }
+
+   /* Don't waste tall shelves on small images if there's room left. */
+   if (((best < 0) || (page->shelves[best].h > 2*h)) &&
+         (page->top + h <= OPENGL_ATLAS_SIZE)) {
+      s     = &array_grow( &page->shelves );
+      s->y  = page->top;
+      s->h  = h;
+      s->x  = 0;
+      page->top += h;
+      best  = array_size(page->shelves)-1;
+   }
+   if (best < 0)
+      return -1;
+
+   s  = &page->shelves[best];
+   *x = s->x;
+   *y = s->y;
+   s->x += w;
+   return 0;
+}
+
+
+/**
+ * @brief Creates a new empty atlas page.
+ *
+ *    @return Index of the page.
+ */
+static int gl_atlasPageNew (void)
+{
+   int i;
+   glAtlasPage *page;
+   uint8_t *blank;
+
+   /* Reuse a freed page. */
+   page = NULL;
+   for (i=0; i<array_size(gl_atlasPages); i++) {
+      if (gl_atlasPages[i].texture == 0) {
+         page = &gl_atlasPages[i];
+         break;
+      }
+   }
+   if (page == NULL) {
+      if (gl_atlasPages == NULL)
+         gl_atlasPages = array_create( glAtlasPage );
+      page = &array_grow( &gl_atlasPages );
+      memset( page, 0, sizeof(glAtlasPage) );
+      i    = array_size(gl_atlasPages)-1;
+   }
+
+   page->top      = 0;
+   page->used     = 0;
+   if (page->shelves == NULL)
+      page->shelves = array_create( glAtlasShelf );
+   array_resize( &page->shelves, 0 );
+
+   /* Same filtering as gl_texParameters, but never wrap into the neighbours. */
+   glGenTextures( 1, &page->texture );
+   glBindTexture( GL_TEXTURE_2D, page->texture );
+   if (gl_screen.scale != 1.) {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   }
+   else {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   }
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+   /* Start transparent so the padding is. */
+   blank = calloc( OPENGL_ATLAS_SIZE * OPENGL_ATLAS_SIZE, 4 );
+   glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, OPENGL_ATLAS_SIZE, OPENGL_ATLAS_SIZE,
+         0, GL_RGBA, GL_UNSIGNED_BYTE, blank );
+   free( blank );
+   gl_checkErr();
+
+   return i;
+}
+
+
+/**
+ * @brief Packs an image into an atlas page.
+ *
+ * Only uncompressed RGBA images without mipmaps small enough to share a
+ * page are packed.
+ *
+ *    @param tex Texture to set up, the dimensions must be set already.
+ *    @param surface Image to pack, not freed.
+ *    @param flags Texture flags.
+ *    @return 0 if it was packed, -1 if it needs its own texture.
+ */
+int gl_atlasAdd( glTexture *tex, SDL_Surface *surface, unsigned int flags )
+{
+   int i, id, x, y, w, h;
+   glAtlasPage *page;
+
+   if ((flags & OPENGL_TEX_MIPMAPS) || gl_texHasCompress() ||
+         (surface->format->BytesPerPixel != 4) ||
+         (surface->w > OPENGL_ATLAS_MAX) || (surface->h > OPENGL_ATLAS_MAX))
+      return -1;
+
+   w      = surface->w + 2*OPENGL_ATLAS_PAD;
+   h      = surface->h + 2*OPENGL_ATLAS_PAD;
+
+   /* Find a compatible page with room. */
+   id = -1;
+   for (i=0; i<array_size(gl_atlasPages); i++) {
+      page = &gl_atlasPages[i];
+      if (page->texture == 0)
+         continue;
+      if (gl_atlasFit( page, w, h, &x, &y ) == 0) {
+         id = i;
+         break;
+      }
+   }
+   if (id < 0) {
+      id = gl_atlasPageNew();
+      if (gl_atlasFit( &gl_atlasPages[id], w, h, &x, &y ) != 0)
+         return -1;
+   }
+   page = &gl_atlasPages[id];
+   x   += OPENGL_ATLAS_PAD;
+   y   += OPENGL_ATLAS_PAD;
+
+   /* Upload. */
+   glBindTexture( GL_TEXTURE_2D, page->texture );
+   SDL_LockSurface( surface );
+   glPixelStorei( GL_UNPACK_ROW_LENGTH, surface->pitch / 4 );
+   glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, surface->w, surface->h,
+         GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels );
+   glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+   SDL_UnlockSurface( surface );
+   gl_checkErr();
+
+   page->used++;
+   tex->texture = page->texture;
+   tex->atlas   = id+1;
+   tex->ax      = (double)x / OPENGL_ATLAS_SIZE;
+   tex->ay      = (double)y / OPENGL_ATLAS_SIZE;
+   tex->aw      = (double)surface->w / OPENGL_ATLAS_SIZE;
+   tex->ah      = (double)surface->h / OPENGL_ATLAS_SIZE;
+   return 0;
+}
+
+
+/**
+ * @brief Removes a texture from its atlas page.
+ *
+ * The page is freed when it has no textures left.
+ *
+ *    @param tex Texture to remove.
+ */
+void gl_atlasRemove( glTexture *tex )
+{
+   glAtlasPage *page;
+
+   /* Pages may already be gone if the texture leaked past gl_exitTextures. */
+   if ((tex->atlas <= 0) || (tex->atlas > array_size(gl_atlasPages))) {
+      tex->atlas = 0;
+      return;
+   }
+
+   page = &gl_atlasPages[ tex->atlas-1 ];
+   tex->atlas   = 0;
+   tex->texture = 0;
+   page->used--;
+   if (page->used > 0)
+      return;
+
+   glDeleteTextures( 1, &page->texture );
+   page->texture = 0;
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Frees all the atlas pages.
+ */
+void gl_exitAtlas (void)
+{
+   int i;
+
+   for (i=0; i<array_size(gl_atlasPages); i++) {
+      if (gl_atlasPages[i].texture != 0)
+         glDeleteTextures( 1, &gl_atlasPages[i].texture );
+      array_free( gl_atlasPages[i].shelves );
+   }
+   array_free( gl_atlasPages );
+   gl_atlasPages = NULL;
+}
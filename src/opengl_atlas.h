@@ -0,0 +1,20 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef OPENGL_ATLAS_H
+#  define OPENGL_ATLAS_H
+
+
+#include "SDL.h"
+
+#include "opengl_tex.h"
+
+
+int gl_atlasAdd( glTexture *tex, SDL_Surface *surface, unsigned int flags );
+void gl_atlasRemove( glTexture *tex );
+void gl_exitAtlas (void);
+
+
+#endif /* OPENGL_ATLAS_H */
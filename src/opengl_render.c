@@ -42,6 +42,8 @@
 
 
 #define OPENGL_RENDER_VBO_SIZE      256 /**< Size of VBO. */
+#define OPENGL_BATCH_QUADS          1024 /**< Maximum quads per batched draw call. */
+#define OPENGL_BATCH_STRIDE         11 /**< Floats per batched vertex: position, both texture coordinates, colour and interpolation. */
 
 
 static gl_vbo *gl_renderVBO = 0; /**< VBO for rendering stuff. */
@@ -53,15 +55,37 @@ static gl_vbo *gl_triangleVBO = 0;
 static int gl_renderVBOtexOffset = 0; /**< VBO texture offset. */
 static int gl_renderVBOcolOffset = 0; /**< VBO colour offset. */
 
+/*
+ * Sprite batching.
+ */
+static gl_vbo *gl_batchVBO = NULL; /**< Streaming VBO for the batched quads. */
+static GLfloat *gl_batchData = NULL; /**< Batched vertices waiting to be drawn. */
+static int gl_batchN       = 0; /**< Number of batched quads. */
+static int gl_batchDepth   = 0; /**< Nesting of gl_batchBegin. */
+static GLuint gl_batchTexA = 0; /**< Texture of the batched quads. */
+static GLuint gl_batchTexB = 0; /**< Texture to interpolate to of the batched quads. */
+#if DEBUGGING
+static int gl_batchDraws   = 0; /**< Texture draw calls since gl_batchStats. */
+static int gl_batchSprites = 0; /**< Textures drawn since gl_batchStats. */
+#endif /* DEBUGGING */
+
 /*
  * prototypes
  */
 static void gl_drawCircleEmpty( const double cx, const double cy,
       const double r, const glColour *c );
+static gl_Matrix4 gl_texMatrix( const glTexture* t,
+      double tx, double ty, double tw, double th );
+static void gl_texCoord( const glTexture* t, double s, double u, GLfloat *out );
+static void gl_batchQuad( const glTexture* ta, const glTexture* tb, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle );
 
 
 void gl_beginSolidProgram(gl_Matrix4 projection, const glColour *c)
 {
+   gl_batchFlush();
    glUseProgram(shaders.solid.program);
    glEnableVertexAttribArray(shaders.solid.vertex);
    gl_uniformColor(shaders.solid.color, c);
@@ -78,6 +102,7 @@ void gl_endSolidProgram (void)
 
 void gl_beginSmoothProgram(gl_Matrix4 projection)
 {
+   gl_batchFlush();
    glUseProgram(shaders.smooth.program);
    glEnableVertexAttribArray(shaders.smooth.vertex);
    glEnableVertexAttribArray(shaders.smooth.vertex_color);
@@ -189,6 +214,234 @@ void gl_renderTriangleEmpty( double x, double y, double a, double s, double leng
 }
 
 
+/**
+ * @brief Starts batching texture blits.
+ *
+ * Until the matching gl_batchEnd, gl_blitTexture and
+ * gl_blitTextureInterpolate only queue their quads. They get drawn with a
+ * single call until the texture changes, the batch fills up or something
+ * else gets drawn. Anything rendering without the functions in this file
+ * must call gl_batchFlush first.
+ */
+void gl_batchBegin (void)
+{
+   gl_batchDepth++;
+}
+
+
+/**
+ * @brief Stops batching texture blits and draws the queued ones.
+ */
+void gl_batchEnd (void)
+{
+   gl_batchFlush();
+   if (gl_batchDepth > 0)
+      gl_batchDepth--;
+}
+
+
+/**
+ * @brief Draws the queued texture blits.
+ */
+void gl_batchFlush (void)
+{
+   GLsizei stride;
+
+   if (gl_batchN == 0)
+      return;
+
+   glUseProgram(shaders.texture_batch.program);
+
+   /* Bind the textures. */
+   glActiveTexture( GL_TEXTURE0 );
+   glBindTexture( GL_TEXTURE_2D, gl_batchTexA );
+   glActiveTexture( GL_TEXTURE1 );
+   glBindTexture( GL_TEXTURE_2D, gl_batchTexB );
+   glActiveTexture( GL_TEXTURE0 );
+
+   /* Upload the vertices. */
+   stride = sizeof(GLfloat) * OPENGL_BATCH_STRIDE;
+   gl_vboSubData( gl_batchVBO, 0, gl_batchN * 6 * stride, gl_batchData );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_tex );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_tex2 );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_color );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_inter );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_tex,
+         sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_tex2,
+         sizeof(GLfloat) * 4, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_color,
+         sizeof(GLfloat) * 6, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_inter,
+         sizeof(GLfloat) * 10, 1, GL_FLOAT, stride );
+
+   /* Set shader uniforms. */
+   glUniform1i(shaders.texture_batch.sampler1, 0);
+   glUniform1i(shaders.texture_batch.sampler2, 1);
+   gl_Matrix4_Uniform(shaders.texture_batch.projection, gl_view_matrix);
+
+   /* Draw. */
+   glDrawArrays( GL_TRIANGLES, 0, gl_batchN * 6 );
+#if DEBUGGING
+   gl_batchDraws++;
+#endif /* DEBUGGING */
+   gl_batchN = 0;
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.texture_batch.vertex );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_tex );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_tex2 );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_color );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_inter );
+
+   /* anything failed? */
+   gl_checkErr();
+
+   glUseProgram(0);
+}
+
+
+/**
+ * @brief Gets the matrix mapping the unit square to a texture region.
+ *
+ * Takes care of flipped images and images packed in an atlas.
+ *
+ *    @param t Texture to map to.
+ *    @param tx X position within the texture. [0:1]
+ *    @param ty Y position within the texture. [0:1]
+ *    @param tw Width within the texture. [0:1]
+ *    @param th Height within the texture. [0:1]
+ */
+static gl_Matrix4 gl_texMatrix( const glTexture* t,
+      double tx, double ty, double tw, double th )
+{
+   gl_Matrix4 tex_mat;
+
+   tex_mat = gl_Matrix4_Identity();
+   if (t->atlas) {
+      tex_mat = gl_Matrix4_Translate(tex_mat, t->ax, t->ay, 0);
+      tex_mat = gl_Matrix4_Scale(tex_mat, t->aw, t->ah, 1);
+   }
+   if (t->flags & OPENGL_TEX_VFLIP)
+      tex_mat = gl_Matrix4_Mult(tex_mat, gl_Matrix4_Ortho(-1, 1, 2, 0, 1, -1));
+   tex_mat = gl_Matrix4_Translate(tex_mat, tx, ty, 0);
+   tex_mat = gl_Matrix4_Scale(tex_mat, tw, th, 1);
+   return tex_mat;
+}
+
+
+/**
+ * @brief Gets the texture coordinates of a point, like gl_texMatrix.
+ *
+ *    @param t Texture to map to.
+ *    @param s X position within the texture. [0:1]
+ *    @param u Y position within the texture. [0:1]
+ *    @param[out] out Texture coordinates.
+ */
+static void gl_texCoord( const glTexture* t, double s, double u, GLfloat *out )
+{
+   /* Images are stored upside down. */
+   if (t->flags & OPENGL_TEX_VFLIP)
+      u = 1. - u;
+   if (t->atlas) {
+      s = t->ax + s*t->aw;
+      u = t->ay + u*t->ah;
+   }
+   out[0] = s;
+   out[1] = u;
+}
+
+
+/**
+ * @brief Queues a texture blit in the batch.
+ *
+ * Same parameters as gl_blitTextureInterpolate, tb is ta when not
+ * interpolating.
+ */
+static void gl_batchQuad( const glTexture* ta, const glTexture* tb, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle )
+{
+   /* Two triangles of the unit square. */
+   static const GLfloat corners[6][2] = {
+      { 0., 0. }, { 1., 0. }, { 0., 1. },
+      { 0., 1. }, { 1., 0. }, { 1., 1. } };
+   int i;
+   double u, v, dx, dy, ca, sa, hw, hh;
+   GLfloat *d;
+
+   /* Different textures can't share the draw call. */
+   if ((gl_batchN >= OPENGL_BATCH_QUADS) ||
+         (ta->texture != gl_batchTexA) || (tb->texture != gl_batchTexB))
+      gl_batchFlush();
+   gl_batchTexA = ta->texture;
+   gl_batchTexB = tb->texture;
+
+   if (c == NULL)
+      c = &cWhite;
+
+   hw = w/2.;
+   hh = h/2.;
+   ca = cos(angle);
+   sa = sin(angle);
+   d  = &gl_batchData[ gl_batchN * 6 * OPENGL_BATCH_STRIDE ];
+   for (i=0; i<6; i++) {
+      u = corners[i][0];
+      v = corners[i][1];
+
+      /* Position, rotated around the center. */
+      if (angle == 0.) {
+         d[0] = x + u*w;
+         d[1] = y + v*h;
+      }
+      else {
+         dx   = (u-.5)*w;
+         dy   = (v-.5)*h;
+         d[0] = x + hw + ca*dx - sa*dy;
+         d[1] = y + hh + sa*dx + ca*dy;
+      }
+
+      gl_texCoord( ta, tx + u*tw, ty + v*th, &d[2] );
+      gl_texCoord( tb, tx + u*tw, ty + v*th, &d[4] );
+
+      d[6]  = c->r;
+      d[7]  = c->g;
+      d[8]  = c->b;
+      d[9]  = c->a;
+      d[10] = inter;
+      d   += OPENGL_BATCH_STRIDE;
+   }
+   gl_batchN++;
+#if DEBUGGING
+   gl_batchSprites++;
+#endif /* DEBUGGING */
+}
+
+
+/**
+ * @brief Gets the texture draw statistics since the last call.
+ *
+ *    @param[out] draws Number of texture draw calls.
+ *    @param[out] sprites Number of textures drawn.
+ */
+void gl_batchStats( int *draws, int *sprites )
+{
+#if DEBUGGING
+   *draws   = gl_batchDraws;
+   *sprites = gl_batchSprites;
+   gl_batchDraws   = 0;
+   gl_batchSprites = 0;
+#else /* DEBUGGING */
+   *draws   = 0;
+   *sprites = 0;
+#endif /* DEBUGGING */
+}
+
+
 /**
  * @brief Texture blitting backend.
  *
@@ -214,6 +467,15 @@ void gl_blitTexture(  const glTexture* texture,
    double hw, hh; 
    gl_Matrix4 projection, tex_mat;
 
+   if (gl_batchDepth > 0) {
+      gl_batchQuad( texture, texture, 1., x, y, w, h, tx, ty, tw, th, c, angle );
+      return;
+   }
+#if DEBUGGING
+   gl_batchDraws++;
+   gl_batchSprites++;
+#endif /* DEBUGGING */
+
    glUseProgram(shaders.texture.program);
 
    /* Bind the texture. */
@@ -243,9 +505,7 @@ void gl_blitTexture(  const glTexture* texture,
          0, 2, GL_FLOAT, 0 );
 
    /* Set the texture. */
-   tex_mat = (texture->flags & OPENGL_TEX_VFLIP) ? gl_Matrix4_Ortho(-1, 1, 2, 0, 1, -1) : gl_Matrix4_Identity();
-   tex_mat = gl_Matrix4_Translate(tex_mat, tx, ty, 0);
-   tex_mat = gl_Matrix4_Scale(tex_mat, tw, th, 1);
+   tex_mat = gl_texMatrix( texture, tx, ty, tw, th );
 
    /* Set shader uniforms. */
    gl_uniformColor(shaders.texture.color, c);
@@ -306,7 +566,16 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
       return;
    }
 
-   gl_Matrix4 projection, tex_mat;
+   gl_Matrix4 projection, tex_mat, tex_mat2;
+
+   if (gl_batchDepth > 0) {
+      gl_batchQuad( ta, tb, inter, x, y, w, h, tx, ty, tw, th, c, 0. );
+      return;
+   }
+#if DEBUGGING
+   gl_batchDraws++;
+   gl_batchSprites++;
+#endif /* DEBUGGING */
 
    glUseProgram(shaders.texture_interpolate.program);
 
@@ -327,10 +596,9 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
    glEnableVertexAttribArray( shaders.texture_interpolate.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture_interpolate.vertex, 0, 2, GL_FLOAT, 0 );
 
-   /* Set the texture. */
-   tex_mat = (ta->flags & OPENGL_TEX_VFLIP) ? gl_Matrix4_Ortho(-1, 1, 2, 0, 1, -1) : gl_Matrix4_Identity();
-   tex_mat = gl_Matrix4_Translate(tex_mat, tx, ty, 0);
-   tex_mat = gl_Matrix4_Scale(tex_mat, tw, th, 1);
+   /* Set the textures, they may be packed in different places. */
+   tex_mat  = gl_texMatrix( ta, tx, ty, tw, th );
+   tex_mat2 = gl_texMatrix( tb, tx, ty, tw, th );
 
    /* Set shader uniforms. */
    glUniform1i(shaders.texture_interpolate.sampler1, 0);
@@ -339,6 +607,7 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
    glUniform1f(shaders.texture_interpolate.inter, inter);
    gl_Matrix4_Uniform(shaders.texture_interpolate.projection, projection);
    gl_Matrix4_Uniform(shaders.texture_interpolate.tex_mat, tex_mat);
+   gl_Matrix4_Uniform(shaders.texture_interpolate.tex_mat2, tex_mat2);
 
    /* Draw. */
    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
@@ -638,6 +907,7 @@ static void gl_drawCircleEmpty( const double cx, const double cy,
 {
    gl_Matrix4 projection;
 
+   gl_batchFlush();
    glUseProgram(shaders.circle.program);
 
    /* Set the vertex. */
@@ -669,6 +939,7 @@ static void gl_drawCircleFilled( const double cx, const double cy,
 {
    gl_Matrix4 projection;
 
+   gl_batchFlush();
    glUseProgram(shaders.circle_filled.program);
 
    /* Set the vertex. */
@@ -760,6 +1031,7 @@ void gl_clipRect( int x, int y, int w, int h )
    ry = (y + gl_screen.y) / gl_screen.myscale;
    rw = w / gl_screen.mxscale;
    rh = h / gl_screen.myscale;
+   gl_batchFlush();
    glScissor( rx, ry, rw, rh );
    glEnable( GL_SCISSOR_TEST );
 }
@@ -770,6 +1042,7 @@ void gl_clipRect( int x, int y, int w, int h )
  */
 void gl_unclipRect (void)
 {
+   gl_batchFlush();
    glDisable( GL_SCISSOR_TEST );
    glScissor( 0, 0, gl_screen.rw, gl_screen.rh );
 }
@@ -790,6 +1063,11 @@ int gl_initRender (void)
    gl_renderVBOtexOffset = sizeof(GLfloat) * OPENGL_RENDER_VBO_SIZE*2;
    gl_renderVBOcolOffset = sizeof(GLfloat) * OPENGL_RENDER_VBO_SIZE*(2+2);
 
+   /* Sprite batch, two triangles per quad. */
+   gl_batchData = malloc( sizeof(GLfloat) * OPENGL_BATCH_QUADS*6*OPENGL_BATCH_STRIDE );
+   gl_batchVBO  = gl_vboCreateStream( sizeof(GLfloat) *
+         OPENGL_BATCH_QUADS*6*OPENGL_BATCH_STRIDE, NULL );
+
    vertex[0] = 0.;
    vertex[1] = 0.;
    vertex[2] = 1.;
@@ -856,5 +1134,10 @@ void gl_exitRender (void)
    gl_vboDestroy( gl_crossVBO );
    gl_vboDestroy( gl_lineVBO );
    gl_vboDestroy( gl_triangleVBO );
+   gl_vboDestroy( gl_batchVBO );
    gl_renderVBO = NULL;
+   gl_batchVBO  = NULL;
+   free( gl_batchData );
+   gl_batchData = NULL;
+   gl_batchN    = 0;
 }
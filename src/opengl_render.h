@@ -26,6 +26,15 @@ void gl_gameToScreenCoords( double *nx, double *ny, double bx, double by );
 void gl_screenToGameCoords( double *nx, double *ny, int bx, int by );
 
 
+/*
+ * Batching.
+ */
+void gl_batchBegin (void);
+void gl_batchEnd (void);
+void gl_batchFlush (void);
+void gl_batchStats( int *draws, int *sprites );
+
+
 /*
  * Rendering.
  */
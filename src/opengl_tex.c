@@ -18,27 +18,76 @@
 #include "naev.h"
 /** @endcond */
 
+#include "array.h"
 #include "conf.h"
 #include "gui.h"
 #include "log.h"
 #include "md5.h"
 #include "nfile.h"
+#include "nhash.h"
 #include "nstring.h"
 #include "opengl.h"
+#include "opengl_atlas.h"
+#include "threadpool.h"
+
+
+#define OPENGL_TEX_UPLOAD_BUDGET 0.002 /**< Seconds per frame to spend uploading decoded images. */
 
 
 /*
  * graphic list
  */
+#define OPENGL_TEX_CACHEFLAGS (OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS) /**< Flags that make cached textures differ. */
+#define OPENGL_TEX_CACHEKINDS (OPENGL_TEX_CACHEFLAGS + 1) /**< Number of name indices, one per combination of OPENGL_TEX_CACHEFLAGS. */
+
 /**
- * @brief Represents a node in the texture list.
+ * @brief Represents an entry in the texture cache.
+ *
+ * Entries that aren't used anymore stay loaded until the cache goes over
+ * conf.tex_cache, then the least recently released ones get freed.
  */
 typedef struct glTexList_ {
-   struct glTexList_ *next; /**< Next in linked list */
    glTexture *tex; /**< associated texture */
    int used; /**< counts how many times texture is being used */
+   size_t mem; /**< Estimated video memory of the texture. */
+   int prev; /**< Previously released unused entry, or -1. */
+   int next; /**< Next released unused entry, or -1. */
 } glTexList;
-static glTexList* texture_list = NULL; /**< Texture list. */
+static glTexList* texture_list = NULL; /**< Texture cache (array.h). */
+static NameHash texture_names[ OPENGL_TEX_CACHEKINDS ]; /**< Indices of the textures by name, by cache flags. */
+static size_t texture_mem  = 0; /**< Estimated video memory of the cached textures. */
+static int texture_unused  = 0; /**< Number of cached textures not in use. */
+static int texture_oldest  = -1; /**< Least recently released unused texture, or -1. */
+static int texture_newest  = -1; /**< Most recently released unused texture, or -1. */
+
+
+/*
+ * Background loading.
+ */
+/**
+ * @brief An image being decoded in the background.
+ */
+typedef struct glTexJob_ {
+   glTexture *tex; /**< Texture to upload to, NULL if it was freed meanwhile. */
+   char *path; /**< Path of the image. */
+   unsigned int flags; /**< Texture flags. */
+   SDL_Surface *surface; /**< Decoded image, NULL if decoding failed. */
+   int done; /**< Decoding is done. */
+} glTexJob;
+static glTexJob **gl_texJobs  = NULL; /**< Queued images (array.h), protected by gl_texMutex. */
+static SDL_mutex *gl_texMutex = NULL; /**< Protects the jobs and the stats. */
+static GLuint gl_texPlaceholder = 0; /**< Transparent texture bound while decoding. */
+
+/**
+ * @brief Byte counts of the background loading.
+ */
+typedef struct glTexStats_ {
+   size_t queued; /**< File bytes queued for decoding. */
+   size_t decoded; /**< Surface bytes decoded. */
+   size_t uploaded; /**< Surface bytes uploaded. */
+} glTexStats;
+static glTexStats gl_texCur; /**< Stats of the current frame, protected by gl_texMutex. */
+static glTexStats gl_texLast; /**< Stats of the previous frame. */
 
 
 /*
@@ -48,14 +97,24 @@ static glTexList* texture_list = NULL; /**< Texture list. */
 static int SDL_IsTrans( SDL_Surface* s, int x, int y );
 static uint8_t* SDL_MapTrans( SDL_Surface* s, int w, int h );
 static size_t gl_transSize( const int w, const int h );
+static void gl_transMask( glTexture *t );
 /* glTexture */
 static GLuint gl_texParameters( unsigned int flags );
 static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int freesur );
 static glTexture* gl_loadNewImage( const char* path, unsigned int flags );
 static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigned int flags );
+static glTexture* gl_loadNewImageAsync( const char* path, unsigned int flags );
+static int gl_probeSize( SDL_RWops *rw, int *w, int *h );
+static int gl_texDecode( void *data );
+static void gl_texProcess( double budget );
 /* List. */
-static glTexture* gl_texExists( const char* path );
+static int gl_texFind( const glTexture *tex );
+static glTexture* gl_texExists( const char* path, unsigned int flags );
+static void gl_texUnlink( int id );
+static void gl_texRelease( int id );
 static int gl_texAdd( glTexture *tex );
+static void gl_texRemove( int id );
+static void gl_texEvict (void);
 
 
 /**
@@ -159,6 +218,64 @@ static size_t gl_transSize( const int w, const int h )
 }
 
 
+/**
+ * @brief Builds the collision bitmasks from the transparency map.
+ *
+ * Each row of the sheet becomes transpitch 64 bit words with pixel x in bit
+ *  x%64 of word x/64, so a row of a sprite can be tested 64 pixels at a time.
+ *  The opaque span of each sprite row lets collisions skip rows early.
+ *
+ * Must be rebuilt whenever the number of sprites changes, see gl_newSprite.
+ *
+ *    @param t Texture with a transparency map.
+ */
+static void gl_transMask( glTexture *t )
+{
+   int x, y, i, w, h, sw, sx;
+   uint64_t *row;
+   int16_t *span;
+
+   w  = (int)t->w;
+   h  = (int)t->h;
+   sw = (int)t->sw;
+   sx = (int)t->sx;
+
+   free( t->transmask );
+   free( t->transspan );
+   t->transsx    = sx;
+   t->transpitch = (w+63) / 64;
+   t->transmask  = calloc( t->transpitch*h, sizeof(uint64_t) );
+   t->transspan  = malloc( 2*sx*h*sizeof(int16_t) );
+   if ((t->transmask == NULL) || (t->transspan == NULL)) {
+      WARN(_("Out of Memory"));
+      free( t->transmask );
+      free( t->transspan );
+      t->transmask = NULL;
+      t->transspan = NULL;
+      t->transsx   = 0;
+      return;
+   }
+
+   for (y=0; y<h; y++) {
+      row  = &t->transmask[ y*t->transpitch ];
+      span = &t->transspan[ 2*y*sx ];
+      for (i=0; i<sx; i++) {
+         span[2*i]   = -1;
+         span[2*i+1] = -1;
+      }
+      for (x=0; x<w; x++) {
+         if (!(t->trans[ (y*w+x)/8 ] & (1 << ((y*w+x)%8))))
+            continue;
+         row[ x/64 ] |= (uint64_t)1 << (x%64);
+         i = MIN( x / sw, sx-1 );
+         if (span[2*i] < 0)
+            span[2*i] = x;
+         span[2*i+1] = x;
+      }
+   }
+}
+
+
 /**
  * @brief Sets default texture parameters.
  */
@@ -322,7 +439,7 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
    md5_byte_t *md5val;
 
    if (name != NULL) {
-      texture = gl_texExists( name );
+      texture = gl_texExists( name, flags );
       if (texture != NULL) {
          if (freesur)
             SDL_FreeSurface( surface );
@@ -402,8 +519,17 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
       }
    }
 
-   texture = gl_loadImagePad( name, surface, flags, w, h, sx, sy, freesur );
+   texture = gl_loadImagePad( NULL, surface, flags, w, h, sx, sy, freesur );
+   texture->flags |= OPENGL_TEX_MAPTRANS;
    texture->trans = trans;
+   if (trans != NULL)
+      gl_transMask( texture );
+
+   /* Cache it as a texture with a transparency map. */
+   if (name != NULL) {
+      texture->name = strdup(name);
+      gl_texAdd( texture );
+   }
    return texture;
 }
 
@@ -428,7 +554,7 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
 
    /* Make sure doesn't already exist. */
    if (name != NULL) {
-      texture = gl_texExists( name );
+      texture = gl_texExists( name, flags );
       if (texture != NULL)
          return texture;
    }
@@ -445,7 +571,12 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
    texture->sx    = (double) sx;
    texture->sy    = (double) sy;
 
-   texture->texture = gl_loadSurface( surface, flags, freesur );
+   if ((flags & OPENGL_TEX_ATLAS) && (gl_atlasAdd( texture, surface, flags ) == 0)) {
+      if (freesur)
+         SDL_FreeSurface( surface );
+   }
+   else
+      texture->texture = gl_loadSurface( surface, flags, freesur );
 
    texture->sw    = texture->w / texture->sx;
    texture->sh    = texture->h / texture->sy;
@@ -477,14 +608,38 @@ glTexture* gl_loadImage( SDL_Surface* surface, unsigned int flags )
 }
 
 
+/**
+ * @brief Gets the cache index of a texture.
+ *
+ *    @param tex Texture to look for.
+ *    @return Index in texture_list or -1 if it isn't cached.
+ */
+static int gl_texFind( const glTexture *tex )
+{
+   int id;
+
+   if (tex->name == NULL)
+      return -1;
+   id = nhash_get( &texture_names[ tex->flags & OPENGL_TEX_CACHEFLAGS ], tex->name );
+   if ((id < 0) || (texture_list[id].tex != tex))
+      return -1;
+   return id;
+}
+
+
 /**
  * @brief Check to see if a texture matching a path already exists.
  *
+ * Only textures loaded with the same OPENGL_TEX_MAPTRANS and
+ * OPENGL_TEX_MIPMAPS flags match.
+ *
  *    @param path Path to the texture.
+ *    @param flags Flags the texture is wanted with.
  *    @return The texture, or NULL if none was found.
  */
-static glTexture* gl_texExists( const char* path )
+static glTexture* gl_texExists( const char* path, unsigned int flags )
 {
+   int id;
    glTexList *cur;
 
    /* Null does never exist. */
@@ -492,42 +647,191 @@ static glTexture* gl_texExists( const char* path )
       return NULL;
 
    /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (strcmp(path,cur->tex->name)==0) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
-   }
+   id = nhash_get( &texture_names[ flags & OPENGL_TEX_CACHEFLAGS ], path );
+   if (id < 0)
+      return NULL;
+   cur = &texture_list[id];
+   if (cur->used <= 0)
+      gl_texUnlink( id );
+   cur->used += 1;
+   return cur->tex;
+}
 
-   return NULL;
+
+/**
+ * @brief Takes an unused texture off the release list, it's in use again.
+ *
+ *    @param id Index of the texture.
+ */
+static void gl_texUnlink( int id )
+{
+   glTexList *cur = &texture_list[id];
+
+   if (cur->prev >= 0)
+      texture_list[ cur->prev ].next = cur->next;
+   else
+      texture_oldest = cur->next;
+   if (cur->next >= 0)
+      texture_list[ cur->next ].prev = cur->prev;
+   else
+      texture_newest = cur->prev;
+   cur->prev = -1;
+   cur->next = -1;
+   texture_unused--;
+}
+
+
+/**
+ * @brief Puts a texture that isn't used anymore at the end of the release
+ *        list, gl_texEvict frees from the front.
+ *
+ *    @param id Index of the texture.
+ */
+static void gl_texRelease( int id )
+{
+   glTexList *cur = &texture_list[id];
+
+   cur->prev = texture_newest;
+   cur->next = -1;
+   if (texture_newest >= 0)
+      texture_list[ texture_newest ].next = id;
+   else
+      texture_oldest = id;
+   texture_newest = id;
+   texture_unused++;
 }
 
 
 /**
- * @brief Adds a texture to the list under the name of path.
+ * @brief Adds a texture to the cache under the name of path.
  */
 static int gl_texAdd( glTexture *tex )
 {
-   glTexList *new, *last = texture_list;
+   glTexList *new;
+
+   if (texture_list == NULL)
+      texture_list = array_create( glTexList );
+
+   /* Create the new entry */
+   new = &array_grow( &texture_list );
+   new->used     = 1;
+   new->tex      = tex;
+   new->prev     = -1;
+   new->next     = -1;
+   new->mem      = (size_t)tex->w * (size_t)tex->h * 4;
+   if (tex->flags & OPENGL_TEX_MIPMAPS)
+      new->mem += new->mem / 3;
+   texture_mem  += new->mem;
+   nhash_add( &texture_names[ tex->flags & OPENGL_TEX_CACHEFLAGS ], tex->name,
+         array_size(texture_list)-1 );
+
+   /* Make room for it. */
+   gl_texEvict();
 
-   /* Create the new node */
-   new = malloc( sizeof(glTexList) );
-   new->next = NULL;
-   new->used = 1;
-   new->tex  = tex;
+   return 0;
+}
 
-   if (texture_list == NULL) /* special condition - creating new list */
-      texture_list = new;
-   else {
-      while (last->next != NULL)
-         last = last->next;
 
-      last->next = new;
+/**
+ * @brief Frees a texture from the cache.
+ *
+ *    @param id Index of the texture to free.
+ */
+static void gl_texRemove( int id )
+{
+   int i, last;
+   glTexture *texture;
+   glTexList *cur;
+   NameHash *names;
+
+   texture = texture_list[id].tex;
+   if (texture_list[id].used <= 0)
+      gl_texUnlink( id );
+   texture_mem -= texture_list[id].mem;
+
+   /* Move the last entry into the hole. */
+   nhash_remove( &texture_names[ texture->flags & OPENGL_TEX_CACHEFLAGS ], texture->name );
+   last = array_size(texture_list)-1;
+   if (id != last) {
+      texture_list[id] = texture_list[last];
+      cur   = &texture_list[id];
+      names = &texture_names[ cur->tex->flags & OPENGL_TEX_CACHEFLAGS ];
+      nhash_remove( names, cur->tex->name );
+      nhash_add( names, cur->tex->name, id );
+
+      /* Its neighbours on the release list have to follow it. */
+      if (cur->used <= 0) {
+         if (cur->prev >= 0)
+            texture_list[ cur->prev ].next = id;
+         else
+            texture_oldest = id;
+         if (cur->next >= 0)
+            texture_list[ cur->next ].prev = id;
+         else
+            texture_newest = id;
+      }
+   }
+   array_erase( &texture_list, &texture_list[last], array_end(texture_list) );
+
+   /* Drop it from the background loading. */
+   if (texture->pending) {
+      SDL_mutexP( gl_texMutex );
+      for (i=0; i<array_size(gl_texJobs); i++)
+         if (gl_texJobs[i]->tex == texture)
+            gl_texJobs[i]->tex = NULL;
+      SDL_mutexV( gl_texMutex );
    }
 
-   return 0;
+   /* free the texture */
+   if (texture->atlas)
+      gl_atlasRemove( texture );
+   else if (texture->texture != gl_texPlaceholder)
+      glDeleteTextures( 1, &texture->texture );
+   free(texture->trans);
+   free(texture->transmask);
+   free(texture->transspan);
+   free(texture->name);
+   free(texture);
+
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Frees the least recently released textures until the cache fits
+ *        conf.tex_cache.
+ *
+ * Textures in use are never freed.
+ */
+static void gl_texEvict (void)
+{
+   size_t budget;
+
+   budget = (size_t)MAX( conf.tex_cache, 0 ) << 20;
+   while ((texture_mem > budget) && (texture_oldest >= 0))
+      gl_texRemove( texture_oldest );
+}
+
+
+/**
+ * @brief Gets the estimated video memory used by the texture cache.
+ *
+ *    @param[out] ntex Number of cached textures.
+ *    @param[out] nunused Number of cached textures not in use.
+ *    @param[out] unused Bytes of the cached textures not in use.
+ *    @return Bytes of all the cached textures.
+ */
+size_t gl_texMemory( int *ntex, int *nunused, size_t *unused )
+{
+   int i;
+
+   *ntex    = array_size(texture_list);
+   *nunused = texture_unused;
+   *unused  = 0;
+   for (i=0; i<array_size(texture_list); i++)
+      if (texture_list[i].used <= 0)
+         *unused += texture_list[i].mem;
+   return texture_mem;
 }
 
 
@@ -545,12 +849,19 @@ glTexture* gl_newImage( const char* path, const unsigned int flags )
    glTexture *t;
 
    /* Check if it already exists. */
-   t = gl_texExists( path );
+   t = gl_texExists( path, flags );
    if (t != NULL)
       return t;
 
+   /* Decode in the background, transparency maps are needed right away. */
+   if ((flags & OPENGL_TEX_ASYNC) && !(flags & OPENGL_TEX_MAPTRANS)) {
+      t = gl_loadNewImageAsync( path, flags );
+      if (t != NULL)
+         return t;
+   }
+
    /* Load the image */
-   return gl_loadNewImage( path, flags );
+   return gl_loadNewImage( path, flags & ~OPENGL_TEX_ASYNC );
 }
 
 
@@ -571,7 +882,7 @@ glTexture* gl_newImageRWops( const char* path, SDL_RWops *rw, const unsigned int
    glTexture *t;
 
    /* Check if it already exists. */
-   t = gl_texExists( path );
+   t = gl_texExists( path, flags );
    if (t != NULL)
       return t;
 
@@ -649,6 +960,275 @@ static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigne
 }
 
 
+/**
+ * @brief Reads the image dimensions from a PNG or WebP header.
+ *
+ *    @param rw Image to probe, gets rewound.
+ *    @param[out] w Width of the image.
+ *    @param[out] h Height of the image.
+ *    @return 0 on success.
+ */
+static int gl_probeSize( SDL_RWops *rw, int *w, int *h )
+{
+   uint8_t b[30];
+   uint32_t v;
+   size_t n;
+
+   n = SDL_RWread( rw, b, 1, sizeof(b) );
+   SDL_RWseek( rw, 0, RW_SEEK_SET );
+   if (n < sizeof(b))
+      return -1;
+
+   /* PNG, dimensions are in the IHDR chunk. */
+   if ((memcmp( b, "\x89PNG\r\n\x1a\n", 8 ) == 0) && (memcmp( &b[12], "IHDR", 4 ) == 0)) {
+      *w = (b[16]<<24) | (b[17]<<16) | (b[18]<<8) | b[19];
+      *h = (b[20]<<24) | (b[21]<<16) | (b[22]<<8) | b[23];
+      return 0;
+   }
+
+   /* WebP, depends on the first chunk. */
+   if ((memcmp( b, "RIFF", 4 ) != 0) || (memcmp( &b[8], "WEBP", 4 ) != 0))
+      return -1;
+   if ((memcmp( &b[12], "VP8 ", 4 ) == 0) &&
+         (b[23] == 0x9d) && (b[24] == 0x01) && (b[25] == 0x2a)) {
+      *w = (b[26] | (b[27]<<8)) & 0x3fff;
+      *h = (b[28] | (b[29]<<8)) & 0x3fff;
+      return 0;
+   }
+   if ((memcmp( &b[12], "VP8L", 4 ) == 0) && (b[20] == 0x2f)) {
+      v  = b[21] | (b[22]<<8) | (b[23]<<16) | ((uint32_t)b[24]<<24);
+      *w = (v & 0x3fff) + 1;
+      *h = ((v >> 14) & 0x3fff) + 1;
+      return 0;
+   }
+   if (memcmp( &b[12], "VP8X", 4 ) == 0) {
+      *w = (b[24] | (b[25]<<8) | (b[26]<<16)) + 1;
+      *h = (b[27] | (b[28]<<8) | (b[29]<<16)) + 1;
+      return 0;
+   }
+   return -1;
+}
+
+
+/**
+ * @brief Creates a texture with a placeholder and decodes the image in the
+ *        background.
+ *
+ * The dimensions are read from the image header so the texture can be used
+ * right away, gl_texUpdate uploads the image when it's ready.
+ *
+ *    @param path Image to load.
+ *    @param flags Flags to control image parameters.
+ *    @return The texture or NULL if it can't be loaded in the background.
+ */
+static glTexture* gl_loadNewImageAsync( const char* path, unsigned int flags )
+{
+   glTexture *texture;
+   glTexJob *job;
+   SDL_RWops *rw;
+   Sint64 size;
+   int w, h;
+
+   if ((path == NULL) || (gl_texMutex == NULL))
+      return NULL;
+
+   /* Only the header is read here. */
+   rw = PHYSFSRWOPS_openRead( path );
+   if (rw == NULL)
+      return NULL;
+   size = SDL_RWsize( rw );
+   if ((gl_probeSize( rw, &w, &h ) != 0) || (w <= 0) || (h <= 0)) {
+      SDL_RWclose( rw );
+      return NULL;
+   }
+   SDL_RWclose( rw );
+
+   /* Set up the texture with the placeholder. */
+   texture = calloc( 1, sizeof(glTexture) );
+   texture->name    = strdup( path );
+   texture->w       = (double) w;
+   texture->h       = (double) h;
+   texture->sx      = 1.;
+   texture->sy      = 1.;
+   texture->sw      = texture->w;
+   texture->sh      = texture->h;
+   texture->srw     = 1.;
+   texture->srh     = 1.;
+   texture->flags   = (flags & ~OPENGL_TEX_ASYNC) | OPENGL_TEX_VFLIP;
+   texture->texture = gl_texPlaceholder;
+   texture->pending = 1;
+   gl_texAdd( texture );
+
+   /* Queue the decoding. */
+   job = calloc( 1, sizeof(glTexJob) );
+   job->tex   = texture;
+   job->path  = strdup( path );
+   job->flags = texture->flags;
+   SDL_mutexP( gl_texMutex );
+   array_push_back( &gl_texJobs, job );
+   gl_texCur.queued += MAX( size, 0 );
+   SDL_mutexV( gl_texMutex );
+   threadpool_newJob( gl_texDecode, job );
+
+   return texture;
+}
+
+
+/**
+ * @brief Decodes a queued image on a worker thread.
+ */
+static int gl_texDecode( void *data )
+{
+   glTexJob *job;
+   SDL_RWops *rw;
+   SDL_Surface *surface;
+
+   job     = (glTexJob*) data;
+   rw      = PHYSFSRWOPS_openRead( job->path );
+   surface = (rw != NULL) ? IMG_Load_RW( rw, 1 ) : NULL;
+
+   SDL_mutexP( gl_texMutex );
+   job->surface = surface;
+   job->done    = 1;
+   if (surface != NULL)
+      gl_texCur.decoded += (size_t)surface->pitch * surface->h;
+   SDL_mutexV( gl_texMutex );
+
+   return 0;
+}
+
+
+/**
+ * @brief Uploads decoded images.
+ *
+ *    @param budget Seconds to spend uploading, at least one image is processed.
+ */
+static void gl_texProcess( double budget )
+{
+   int i, n;
+   Uint64 start;
+   glTexJob *job;
+   glTexture *tex;
+   size_t bytes;
+
+   if (gl_texMutex == NULL)
+      return;
+
+   start = SDL_GetPerformanceCounter();
+   n     = 0;
+   while (1) {
+      if ((n > 0) && ((double)(SDL_GetPerformanceCounter() - start) /
+               SDL_GetPerformanceFrequency() > budget))
+         break;
+
+      /* Take the first decoded image. */
+      job = NULL;
+      SDL_mutexP( gl_texMutex );
+      for (i=0; i<array_size(gl_texJobs); i++) {
+         if (gl_texJobs[i]->done) {
+            job = gl_texJobs[i];
+            array_erase( &gl_texJobs, &gl_texJobs[i], &gl_texJobs[i+1] );
+            break;
+         }
+      }
+      SDL_mutexV( gl_texMutex );
+      if (job == NULL)
+         break;
+
+      /* Upload it. */
+      tex = job->tex;
+      if ((tex != NULL) && (job->surface != NULL)) {
+         bytes = (size_t)job->surface->pitch * job->surface->h;
+         if ((job->surface->w != (int)tex->w) || (job->surface->h != (int)tex->h)) {
+            WARN(_("Texture '%s' is %dx%d but its header says %.0fx%.0f"),
+                  job->path, job->surface->w, job->surface->h, tex->w, tex->h);
+            tex->w   = job->surface->w;
+            tex->h   = job->surface->h;
+            tex->sw  = tex->w / tex->sx;
+            tex->sh  = tex->h / tex->sy;
+         }
+         if ((job->flags & OPENGL_TEX_ATLAS) &&
+               (gl_atlasAdd( tex, job->surface, job->flags ) == 0))
+            SDL_FreeSurface( job->surface );
+         else
+            tex->texture = gl_loadSurface( job->surface, job->flags, 1 );
+         tex->pending = 0;
+         SDL_mutexP( gl_texMutex );
+         gl_texCur.uploaded += bytes;
+         SDL_mutexV( gl_texMutex );
+      }
+      else {
+         if (tex != NULL) {
+            WARN(_("Unable to load image '%s'."), job->path );
+            tex->pending = 0;
+         }
+         if (job->surface != NULL)
+            SDL_FreeSurface( job->surface );
+      }
+      free( job->path );
+      free( job );
+      n++;
+   }
+}
+
+
+/**
+ * @brief Uploads the images decoded in the background, once per frame.
+ *
+ * Uploads are limited to OPENGL_TEX_UPLOAD_BUDGET so jumping into a system
+ * with many new graphics doesn't stall a frame.
+ */
+void gl_texUpdate (void)
+{
+   gl_texProcess( OPENGL_TEX_UPLOAD_BUDGET );
+
+   /* Rotate the stats. */
+   if (gl_texMutex == NULL)
+      return;
+   SDL_mutexP( gl_texMutex );
+   gl_texLast = gl_texCur;
+   memset( &gl_texCur, 0, sizeof(glTexStats) );
+   SDL_mutexV( gl_texMutex );
+}
+
+
+/**
+ * @brief Waits for all the queued images and uploads them.
+ */
+void gl_texFlush (void)
+{
+   int n;
+
+   if (gl_texMutex == NULL)
+      return;
+
+   while (1) {
+      gl_texProcess( HUGE_VAL );
+      SDL_mutexP( gl_texMutex );
+      n = array_size( gl_texJobs );
+      SDL_mutexV( gl_texMutex );
+      if (n == 0)
+         break;
+      SDL_Delay( 1 );
+   }
+}
+
+
+/**
+ * @brief Gets the background loading stats of the last frame.
+ *
+ *    @param[out] queued File bytes queued for decoding.
+ *    @param[out] decoded Surface bytes decoded.
+ *    @param[out] uploaded Surface bytes uploaded.
+ */
+void gl_texStats( size_t *queued, size_t *decoded, size_t *uploaded )
+{
+   *queued   = gl_texLast.queued;
+   *decoded  = gl_texLast.decoded;
+   *uploaded = gl_texLast.uploaded;
+}
+
+
 /**
  * @brief Loads the texture immediately, but also sets it as a sprite.
  *
@@ -674,6 +1254,10 @@ glTexture* gl_newSprite( const char* path, const int sx, const int sy,
    texture->sh    = texture->h / texture->sy;
    texture->srw   = texture->sw / texture->w;
    texture->srh   = texture->sh / texture->h;
+
+   /* Collision spans are per sprite. */
+   if ((texture->trans != NULL) && (texture->transsx != sx))
+      gl_transMask( texture );
    return texture;
 }
 
@@ -704,6 +1288,10 @@ glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
    texture->sh    = texture->h / texture->sy;
    texture->srw   = texture->sw / texture->w;
    texture->srh   = texture->sh / texture->h;
+
+   /* Collision spans are per sprite. */
+   if ((texture->trans != NULL) && (texture->transsx != sx))
+      gl_transMask( texture );
    return texture;
 }
 
@@ -715,37 +1303,24 @@ glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
  */
 void gl_freeTexture( glTexture* texture )
 {
-   glTexList *cur, *last;
+   int id;
+   glTexList *cur;
 
    if (texture == NULL)
       return;
 
-   /* see if we can find it in stack */
-   last = NULL;
-   for (cur=texture_list; cur!=NULL; cur=cur->next) {
-      if (cur->tex == texture) { /* found it */
-         cur->used--;
-         if (cur->used <= 0) { /* not used anymore */
-            /* free the texture */
-            glDeleteTextures( 1, &texture->texture );
-            free(texture->trans);
-            free(texture->name);
-            free(texture);
-
-            /* free the list node */
-            if (last == NULL) { /* case there's no texture before it */
-               if (cur->next != NULL)
-                  texture_list = cur->next;
-               else /* case it's the last texture */
-                  texture_list = NULL;
-            }
-            else
-               last->next = cur->next;
-            free(cur);
-         }
-         return; /* we already found it so we can exit */
+   /* see if we can find it in the cache */
+   id = gl_texFind( texture );
+   if (id >= 0) {
+      cur = &texture_list[id];
+      cur->used--;
+      if (cur->used == 0) { /* not used anymore, keep it around */
+         gl_texRelease( id );
+         gl_texEvict();
       }
-      last = cur;
+      else if (cur->used < 0)
+         WARN(_("Texture '%s' freed more times than it was loaded!"), texture->name);
+      return;
    }
 
    /* Not found */
@@ -753,8 +1328,13 @@ void gl_freeTexture( glTexture* texture )
       WARN(_("Attempting to free texture '%s' not found in stack!"), texture->name);
 
    /* Free anyways */
-   glDeleteTextures( 1, &texture->texture );
+   if (texture->atlas)
+      gl_atlasRemove( texture );
+   else
+      glDeleteTextures( 1, &texture->texture );
    free(texture->trans);
+   free(texture->transmask);
+   free(texture->transspan);
    free(texture->name);
    free(texture);
 
@@ -770,20 +1350,19 @@ void gl_freeTexture( glTexture* texture )
  */
 glTexture* gl_dupTexture( glTexture *texture )
 {
-   glTexList *cur;
+   int id;
 
    /* No segfaults kthxbye. */
    if (texture == NULL)
       return NULL;
 
    /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (texture == cur->tex) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
+   id = gl_texFind( texture );
+   if (id >= 0) {
+      if (texture_list[id].used <= 0)
+         gl_texUnlink( id );
+      texture_list[id].used += 1;
+      return texture;
    }
 
    /* Invalid texture. */
@@ -882,6 +1461,15 @@ glTexture** gl_copyTexArray( glTexture **tex, int texn, int *n )
  */
 int gl_initTextures (void)
 {
+   uint32_t pixel = 0;
+
+   /* Transparent placeholder for images still being decoded. */
+   gl_texPlaceholder = gl_texParameters( 0 );
+   glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixel );
+   gl_checkErr();
+
+   gl_texMutex = SDL_CreateMutex();
+   gl_texJobs  = array_create( glTexJob* );
    return 0;
 }
 
@@ -891,14 +1479,38 @@ int gl_initTextures (void)
  */
 void gl_exitTextures (void)
 {
+   int i;
    glTexList *tex;
 
+   /* Workers may still be decoding. */
+   gl_texFlush();
+
+   /* Free the cached textures not in use. */
+   for (i=array_size(texture_list)-1; i>=0; i--)
+      if (texture_list[i].used <= 0)
+         gl_texRemove( i );
+
+   array_free( gl_texJobs );
+   gl_texJobs = NULL;
+   SDL_DestroyMutex( gl_texMutex );
+   gl_texMutex = NULL;
+   glDeleteTextures( 1, &gl_texPlaceholder );
+   gl_texPlaceholder = 0;
+   gl_exitAtlas();
+
    /* Make sure there's no texture leak */
-   if (texture_list != NULL) {
+   if (array_size(texture_list) > 0) {
       DEBUG(_("Texture leak detected!"));
-      for (tex=texture_list; tex!=NULL; tex=tex->next)
+      for (i=0; i<array_size(texture_list); i++) {
+         tex = &texture_list[i];
          DEBUG( n_( "   '%s' opened %d time", "   '%s' opened %d times", tex->used ), tex->tex->name, tex->used );
+      }
+      return;
    }
+   array_free( texture_list );
+   texture_list = NULL;
+   for (i=0; i<OPENGL_TEX_CACHEKINDS; i++)
+      nhash_free( &texture_names[i] );
 }
 
 
@@ -38,6 +38,8 @@
 #define OPENGL_TEX_MAPTRANS   (1<<0) /**< Create a transparency map. */
 #define OPENGL_TEX_MIPMAPS    (1<<1) /**< Creates mipmaps. */
 #define OPENGL_TEX_VFLIP      (1<<2) /**< Assume loaded from an image (where positive y means down). */
+#define OPENGL_TEX_ASYNC      (1<<3) /**< Decode the image in the background, see gl_texUpdate. */
+#define OPENGL_TEX_ATLAS      (1<<4) /**< Pack the image into a shared atlas page if possible, not with OPENGL_TEX_MIPMAPS. */
 
 /**
  * @brief Abstraction for rendering sprite sheets.
@@ -62,9 +64,21 @@ typedef struct glTexture_ {
    /* data */
    GLuint texture; /**< the opengl texture itself */
    uint8_t* trans; /**< maps the transparency */
+   uint64_t* transmask; /**< Transparency map as rows of 64 pixel words, see CollideSprite. */
+   int16_t* transspan; /**< First and last opaque column of each sprite row, -1 if empty. */
+   int transpitch; /**< Words per row of transmask. */
+   int transsx; /**< Sprites on the x axis transspan was built for. */
+
+   /* atlas */
+   int atlas; /**< Atlas page + 1 the image is packed in, 0 if it has its own texture. */
+   double ax; /**< X offset in the atlas page [0:1]. */
+   double ay; /**< Y offset in the atlas page [0:1]. */
+   double aw; /**< Width in the atlas page [0:1]. */
+   double ah; /**< Height in the atlas page [0:1]. */
 
    /* properties */
    uint8_t flags; /**< flags used for texture properties */
+   uint8_t pending; /**< Image is still being decoded, a placeholder is bound. */
 } glTexture;
 
 
@@ -74,6 +88,18 @@ typedef struct glTexture_ {
 int gl_initTextures (void);
 void gl_exitTextures (void);
 
+/*
+ * Background loading.
+ */
+void gl_texUpdate (void);
+void gl_texFlush (void);
+void gl_texStats( size_t *queued, size_t *decoded, size_t *uploaded );
+
+/*
+ * Cache.
+ */
+size_t gl_texMemory( int *ntex, int *nunused, size_t *unused );
+
 /*
  * Creating.
  */
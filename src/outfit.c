@@ -30,6 +30,7 @@
 #include "mapData.h"
 #include "ndata.h"
 #include "nfile.h"
+#include "nhash.h"
 #include "nstring.h"
 #include "nstring.h"
 #include "nxml.h"
@@ -52,6 +53,8 @@
  * the stack
  */
 static Outfit* outfit_stack = NULL; /**< Stack of outfits. */
+static NameHash outfit_names; /**< Name index of the outfit stack. */
+static XmlParseBatch *outfit_parsing = NULL; /**< Outfit files being parsed ahead of outfit_load. */
 
 
 /*
@@ -64,7 +67,7 @@ static void outfit_launcherDesc( Outfit* o );
 /* parsing */
 static int outfit_loadDir( char *dir );
 static int outfit_parseDamage( Damage *dmg, xmlNodePtr node );
-static int outfit_parse( Outfit* temp, const char* file );
+static int outfit_parse( Outfit* temp, xmlDocPtr doc );
 static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent );
 static void outfit_parseSBeam( Outfit* temp, const xmlNodePtr parent );
 static void outfit_parseSLauncher( Outfit* temp, const xmlNodePtr parent );
@@ -90,9 +93,9 @@ Outfit* outfit_get( const char* name )
 {
    int i;
 
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcmp(name,outfit_stack[i].name)==0)
-         return &outfit_stack[i];
+   i = nhash_get( &outfit_names, name );
+   if (i >= 0)
+      return &outfit_stack[i];
 
    WARN(_("Outfit '%s' not found in stack."), name);
    return NULL;
@@ -108,9 +111,9 @@ Outfit* outfit_get( const char* name )
 Outfit* outfit_getW( const char* name )
 {
    int i;
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcmp(name,outfit_stack[i].name)==0)
-         return &outfit_stack[i];
+   i = nhash_get( &outfit_names, name );
+   if (i >= 0)
+      return &outfit_stack[i];
    return NULL;
 }
 
@@ -750,6 +753,27 @@ int outfit_soundHit( const Outfit* o )
    else if (outfit_isAmmo(o)) return o->u.amm.sound_hit;
    return -1.;
 }
+/**
+ * @brief Starts decoding the sounds an outfit plays so they're ready in combat.
+ *    @param o Outfit to preload sounds of.
+ */
+void outfit_soundPreload( const Outfit* o )
+{
+   if (outfit_isBolt(o) || outfit_isAmmo(o)) {
+      sound_preload( outfit_sound(o) );
+      sound_preload( outfit_soundHit(o) );
+   }
+   else if (outfit_isBeam(o)) {
+      sound_preload( o->u.bem.sound_warmup );
+      sound_preload( o->u.bem.sound );
+      sound_preload( o->u.bem.sound_off );
+   }
+   else if (outfit_isAfterburner(o)) {
+      sound_preload( o->u.afb.sound_on );
+      sound_preload( o->u.afb.sound );
+      sound_preload( o->u.afb.sound_off );
+   }
+}
 /**
  * @brief Gets the outfit's duration.
  *    @param o Outfit to get the duration of.
@@ -2094,10 +2118,10 @@ if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
  * @brief Parses and returns Outfit from parent node.
 
  *    @param temp Outfit to load into.
- *    @param file Path to the XML file (relative to base directory).
+ *    @param doc Parsed XML file of the outfit, gets freed.
  *    @return 0 on success.
  */
-static int outfit_parse( Outfit* temp, const char* file )
+static int outfit_parse( Outfit* temp, xmlDocPtr doc )
 {
    xmlNodePtr cur, ccur, node, parent;
    char *prop, *desc_extra;
@@ -2105,7 +2129,6 @@ static int outfit_parse( Outfit* temp, const char* file )
    int group, m, l;
    ShipStatList *ll;
 
-   xmlDocPtr doc = xml_parsePhysFS( file );
    if (doc == NULL)
       return -1;
 
@@ -2150,7 +2173,7 @@ static int outfit_parse( Outfit* temp, const char* file )
             }
             else if (xml_isNode(cur,"gfx_store")) {
                temp->gfx_store = xml_parseTexture( cur,
-                     OUTFIT_GFX_PATH"store/%s", 1, 1, OPENGL_TEX_MIPMAPS );
+                     OUTFIT_GFX_PATH"store/%s", 1, 1, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ASYNC );
                continue;
             }
             else if (xml_isNode(cur,"gfx_overlays")) {
@@ -2166,7 +2189,7 @@ static int outfit_parse( Outfit* temp, const char* file )
                         temp->gfx_overlays = realloc( temp->gfx_overlays, m * sizeof( glTexture * ) );
                      }
                      temp->gfx_overlays[ temp->gfx_noverlays-1 ] = xml_parseTexture( ccur,
-                           OVERLAY_GFX_PATH"%s", 1, 1, OPENGL_TEX_MIPMAPS );
+                           OVERLAY_GFX_PATH"%s", 1, 1, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ASYNC );
                   }
                } while (xml_nextNode(ccur));
                continue;
@@ -2316,6 +2339,8 @@ if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**<
 /**
  * @brief Loads all the files in a directory.
  *
+ * Uses the files outfit_prefetch started parsing if there are any.
+ *
  *    @param dir Directory to load files from.
  *    @return 0 on success.
  */
@@ -2323,10 +2348,15 @@ static int outfit_loadDir( char *dir )
 {
    int i, n, ret;
    char **outfit_files;
+   xmlDocPtr *outfit_docs;
 
-   outfit_files = ndata_listRecursive( dir );
+   /* Read and parse the files in parallel, if not already started. */
+   if (outfit_parsing == NULL)
+      outfit_parsing = xml_parsePhysFSStart( ndata_listRecursive( dir ) );
+   outfit_docs    = xml_parsePhysFSFinish( outfit_parsing, &outfit_files );
+   outfit_parsing = NULL;
    for ( i = 0; i < array_size( outfit_files ); i++ ) {
-      ret = outfit_parse( &array_grow(&outfit_stack), outfit_files[i] );
+      ret = outfit_parse( &array_grow(&outfit_stack), outfit_docs[i] );
       if (ret < 0) {
          n = array_size(outfit_stack);
          array_erase( &outfit_stack, &outfit_stack[n-1], &outfit_stack[n] );
@@ -2334,6 +2364,7 @@ static int outfit_loadDir( char *dir )
       free( outfit_files[i] );
    }
    array_free( outfit_files );
+   array_free( outfit_docs );
 
    /* Reduce size. */
    array_shrink( &outfit_stack );
@@ -2341,6 +2372,22 @@ static int outfit_loadDir( char *dir )
    return 0;
 }
 
+/**
+ * @brief Starts reading and parsing the outfit files in the background.
+ *
+ * Called before the stages outfit_load depends on, so the files are parsed
+ * while they load.
+ *
+ *    @return 0 on success.
+ */
+int outfit_prefetch (void)
+{
+   if (outfit_parsing == NULL)
+      outfit_parsing = xml_parsePhysFSStart( ndata_listRecursive( OUTFIT_DATA_PATH ) );
+   return 0;
+}
+
+
 /**
  * @brief Loads all the outfits.
  *
@@ -2357,6 +2404,11 @@ int outfit_load (void)
    array_shrink(&outfit_stack);
    noutfits = array_size(outfit_stack);
 
+   /* Index the names. */
+   nhash_init( &outfit_names );
+   for (i=0; i<noutfits; i++)
+      nhash_add( &outfit_names, outfit_stack[i].name, i );
+
    /* Second pass, sets up ammunition relationships. */
    for (i=0; i<noutfits; i++) {
       o = &outfit_stack[i];
@@ -2611,5 +2663,6 @@ void outfit_free (void)
    }
 
    array_free(outfit_stack);
+   nhash_free(&outfit_names);
 }
 
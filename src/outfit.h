@@ -441,12 +441,14 @@ double outfit_speed( const Outfit* o );
 double outfit_spin( const Outfit* o );
 int outfit_sound( const Outfit* o );
 int outfit_soundHit( const Outfit* o );
+void outfit_soundPreload( const Outfit* o );
 /* Active outfits. */
 double outfit_duration( const Outfit* o );
 double outfit_cooldown( const Outfit* o );
 /*
  * loading/freeing outfit stack
  */
+int outfit_prefetch (void);
 int outfit_load (void);
 int outfit_mapParse(void);
 void outfit_free (void);
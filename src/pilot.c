@@ -47,10 +47,12 @@
 #include "player_autonav.h"
 #include "rng.h"
 #include "spfx.h"
+#include "threadpool.h"
 #include "weapon.h"
 
 
 #define PILOT_SIZE_MIN 128 /**< Minimum chunks to increment pilot_stack by */
+#define PILOT_PHYSICS_CHUNK 32 /**< Number of pilots integrated per threadpool job. */
 
 /* ID Generators. */
 static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniqueness */
@@ -61,6 +63,18 @@ static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniq
 Pilot** pilot_stack = NULL; /**< Not static, used in player.c, weapon.c, pause.c, space.c and ai.c */
 
 
+/**
+ * @brief Range of pilot_physics to integrate in a threadpool job.
+ */
+typedef struct PilotPhysicsChunk_ {
+   int start; /**< First pilot to integrate. */
+   int end; /**< One past the last pilot to integrate. */
+   double dt; /**< Current delta tick. */
+} PilotPhysicsChunk;
+static Pilot **pilot_physics = NULL; /**< Pilots to integrate this frame (array.h). */
+static PilotPhysicsChunk *pilot_physicsChunks = NULL; /**< Integration jobs (array.h). */
+
+
 /* misc */
 static const double pilot_commTimeout  = 15.; /**< Time for text above pilot to time out. */
 static const double pilot_commFade     = 5.; /**< Time for text above pilot to fade out. */
@@ -72,6 +86,7 @@ static const double pilot_commFade     = 5.; /**< Time for text above pilot to f
  */
 /* Update. */
 static void pilot_hyperspace( Pilot* pilot, double dt );
+static int pilot_updateSolids( void *data );
 static void pilot_refuel( Pilot *p, double dt );
 /* Clean up. */
 static void pilot_dead( Pilot* p, unsigned int killer );
@@ -2055,10 +2070,8 @@ void pilot_update( Pilot* pilot, const double dt )
       pilot_setThrust( pilot, 0. );
       pilot_setTurn( pilot, 0. );
 
-      /* update the solid */
-      pilot->solid->update( pilot->solid, dt );
-      gl_getSpriteFromDir( &pilot->tsx, &pilot->tsy,
-            pilot->ship->gfx_space, pilot->solid->dir );
+      /* update the solid, done in pilots_update. */
+      pilot_setFlag( pilot, PILOT_UPDATE_SOLID );
 
       /* Engine glow decay. */
       if (pilot->engine_glow > 0.) {
@@ -2185,14 +2198,35 @@ void pilot_update( Pilot* pilot, const double dt )
          pilot->engine_glow = 0.;
    }
 
-   /* Update the solid, must be run after limit_speed. */
-   pilot->solid->update( pilot->solid, dt );
-   gl_getSpriteFromDir( &pilot->tsx, &pilot->tsy,
-         pilot->ship->gfx_space, pilot->solid->dir );
+   /* Update the solid, must be run after limit_speed. The integration is
+    * done in parallel for all pilots by pilots_update, which then checks if
+    * there is commodities to gather. */
+   pilot_setFlag( pilot, PILOT_UPDATE_SOLID );
+   pilot_setFlag( pilot, PILOT_UPDATE_GATHER );
+}
 
-   /* See if there is commodities to gather */
-   gatherable_gather( pilot->id );
 
+/**
+ * @brief Integrates the solids of a range of pilots.
+ *
+ * Only touches the pilots in the range so it can be run in parallel.
+ *
+ *    @param data PilotPhysicsChunk to process.
+ *    @return 0 always.
+ */
+static int pilot_updateSolids( void *data )
+{
+   int i;
+   Pilot *p;
+   PilotPhysicsChunk *chunk = (PilotPhysicsChunk*) data;
+
+   for (i=chunk->start; i<chunk->end; i++) {
+      p = pilot_physics[i];
+      p->solid->update( p->solid, chunk->dt );
+      gl_getSpriteFromDir( &p->tsx, &p->tsy,
+            p->ship->gfx_space, p->solid->dir );
+   }
+   return 0;
 }
 
 /**
@@ -3023,6 +3057,8 @@ void pilot_destroy(Pilot* p)
 void pilots_init (void)
 {
    pilot_stack = array_create_size( Pilot*, PILOT_SIZE_MIN );
+   pilot_physics = array_create_size( Pilot*, PILOT_SIZE_MIN );
+   pilot_physicsChunks = array_create( PilotPhysicsChunk );
 }
 
 
@@ -3040,6 +3076,10 @@ void pilots_free (void)
       pilot_free(pilot_stack[i]);
    array_free(pilot_stack);
    pilot_stack = NULL;
+   array_free(pilot_physics);
+   pilot_physics = NULL;
+   array_free(pilot_physicsChunks);
+   pilot_physicsChunks = NULL;
    player.p = NULL;
 }
 
@@ -3110,8 +3150,9 @@ void pilots_cleanAll (void)
  */
 void pilots_update( double dt )
 {
-   int i;
+   int i, n, nchunks;
    Pilot *p;
+   ThreadQueue *queue;
 
    /* Now update all the pilots. */
    for (i=0; i<array_size(pilot_stack); i++) {
@@ -3153,7 +3194,8 @@ void pilots_update( double dt )
          p->think(p, dt);
    }
 
-   /* Now update all the pilots. */
+   /* Now update all the pilots, anything touching shared state is done here. */
+   array_resize( &pilot_physics, 0 );
    for (i=0; i<array_size(pilot_stack); i++) {
       p = pilot_stack[i];
 
@@ -3168,6 +3210,38 @@ void pilots_update( double dt )
       /* Just update the pilot. */
       if (p->update) /* update */
          p->update( p, dt );
+
+      if (pilot_isFlag(p, PILOT_UPDATE_SOLID))
+         array_push_back( &pilot_physics, p );
+   }
+
+   /* Integrate the solids, each chunk only touches its own pilots so the
+    * results don't depend on how the chunks get scheduled. */
+   n = array_size(pilot_physics);
+   nchunks = (n + PILOT_PHYSICS_CHUNK - 1) / PILOT_PHYSICS_CHUNK;
+   array_resize( &pilot_physicsChunks, nchunks );
+   for (i=0; i<nchunks; i++) {
+      pilot_physicsChunks[i].start = i * PILOT_PHYSICS_CHUNK;
+      pilot_physicsChunks[i].end   = MIN( n, (i+1) * PILOT_PHYSICS_CHUNK );
+      pilot_physicsChunks[i].dt    = dt;
+   }
+   if (nchunks > 1) {
+      queue = vpool_create();
+      for (i=0; i<nchunks; i++)
+         vpool_enqueue( queue, pilot_updateSolids, &pilot_physicsChunks[i] );
+      vpool_wait( queue );
+   }
+   else if (nchunks == 1)
+      pilot_updateSolids( &pilot_physicsChunks[0] );
+
+   /* Gathering touches the gatherable stack, so it's done serially. */
+   for (i=0; i<n; i++) {
+      p = pilot_physics[i];
+      pilot_rmFlag( p, PILOT_UPDATE_SOLID );
+      if (pilot_isFlag( p, PILOT_UPDATE_GATHER )) {
+         pilot_rmFlag( p, PILOT_UPDATE_GATHER );
+         gatherable_gather( p->id );
+      }
    }
 }
 
@@ -3180,6 +3254,7 @@ void pilots_update( double dt )
 void pilots_render( double dt )
 {
    int i;
+   gl_batchBegin();
    for (i=0; i<array_size(pilot_stack); i++) {
 
       /* Invisible, not doing anything. */
@@ -3189,6 +3264,7 @@ void pilots_render( double dt )
       if (pilot_stack[i]->render != NULL) /* render */
          pilot_stack[i]->render(pilot_stack[i], dt);
    }
+   gl_batchEnd();
 }
 
 
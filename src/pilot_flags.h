@@ -62,6 +62,8 @@ enum {
    PILOT_BRAKING,      /**< Pilot is braking. */
    PILOT_HASSPEEDLIMIT, /**< Speed limiting is activated for Pilot.*/
    PILOT_PERSIST, /**< Persist pilot on jump. */
+   PILOT_UPDATE_SOLID, /**< Pilot's solid must be integrated this frame. */
+   PILOT_UPDATE_GATHER, /**< Pilot must gather commodities after integrating. */
    PILOT_FLAGS_MAX     /**< Maximum number of flags. */
 };
 typedef char PilotFlags[ PILOT_FLAGS_MAX ];
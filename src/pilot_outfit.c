@@ -322,6 +322,9 @@ int pilot_addOutfitRaw( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s )
    o = s->outfit;
    s->active = outfit_isActive(o);
 
+   /* Get the sounds ready before they're needed. */
+   outfit_soundPreload( o );
+
    /* Update heat. */
    pilot_heatCalcSlot( s );
 
@@ -713,6 +716,7 @@ int pilot_addAmmo( Pilot* pilot, PilotOutfitSlot *s, Outfit* ammo, int quantity
 
    /* Set the ammo type. */
    s->u.ammo.outfit    = ammo;
+   outfit_soundPreload( ammo );
 
    /* Add the ammo. */
    max                 = pilot_maxAmmoO(pilot,s->outfit) - s->u.ammo.deployed;
@@ -788,6 +788,17 @@ static void player_initSound (void)
    snd_hypPowDown       = sound_get("hyperspace_powerdown");
    snd_hypPowUpJump     = sound_get("hyperspace_powerupjump");
    snd_hypJump          = sound_get("hyperspace_jump");
+
+   /* Decode them in the background, they're needed soon. */
+   sound_preload( snd_target );
+   sound_preload( snd_jump );
+   sound_preload( snd_nav );
+   sound_preload( snd_hail );
+   sound_preload( snd_hypPowUp );
+   sound_preload( snd_hypEng );
+   sound_preload( snd_hypPowDown );
+   sound_preload( snd_hypPowUpJump );
+   sound_preload( snd_hypJump );
 }
 
 
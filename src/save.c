@@ -6,11 +6,19 @@
  * @file save.c
  *
  * @brief Handles saving/loading games.
+ *
+ * The game state is snapshotted into an XML document on the main thread, then
+ *  compressed, backed up and written out in the threadpool so landing and
+ *  taking off don't hitch on disk I/O. Finished saves are reported back on
+ *  the main thread by save_update().
  */
 
 /** @cond */
 #include <errno.h>
+#include <stdio.h>
 #include "physfs.h"
+#include "SDL.h"
+#include "SDL_atomic.h"
 
 #include "naev.h"
 /** @endcond */
@@ -34,11 +42,28 @@
 #include "player.h"
 #include "shiplog.h"
 #include "start.h"
+#include "threadpool.h"
 #include "unidiff.h"
 
 int save_loaded   = 0; /**< Just loaded the saved game. */
 
 
+/**
+ * @brief Saved game being written in the threadpool.
+ */
+typedef struct SaveJob_s {
+   xmlDocPtr doc; /**< Snapshot of the game, owned by the job. */
+   char *name; /**< Player name, the save is "saves/name.ns". */
+   int backup; /**< Whether to back up the previous save first. */
+   save_done_t done; /**< Called on the main thread when finished. */
+   void *data; /**< User data for done. */
+   nsave_t meta; /**< Metadata for the load menu index. */
+   int ret; /**< 0 on success. */
+   SDL_atomic_t finished; /**< Set when the job is finished. */
+} SaveJob;
+static SaveJob *save_job = NULL; /**< Save being written, if any. */
+
+
 /*
  * prototypes
  */
@@ -65,6 +90,9 @@ extern int economy_sysSave( xmlTextWriterPtr writer ); /**< Saves the economy st
 extern int diff_save( xmlTextWriterPtr writer ); /**< Saves the universe diffs. */
 /* static */
 static int save_data( xmlTextWriterPtr writer );
+static int save_write( void *data );
+static void save_finish( int wait );
+static void save_meta( nsave_t *ns );
 
 
 /**
@@ -91,6 +119,138 @@ static int save_data( xmlTextWriterPtr writer )
 }
 
 
+/**
+ * @brief Gets the metadata of the game being saved, as load_load would read it.
+ *
+ *    @param[out] ns Metadata to fill.
+ */
+static void save_meta( nsave_t *ns )
+{
+   char path[PATH_MAX];
+   int cycles, periods, seconds;
+   double rem;
+
+   memset( ns, 0, sizeof(nsave_t) );
+   nsnprintf( path, sizeof(path), "saves/%s.ns", player.name );
+   ns->path      = strdup( path );
+   ns->name      = strdup( player.name );
+   ns->version   = strdup( VERSION );
+   ns->data      = strdup( start_name() );
+   ns->planet    = strdup( land_planet->name );
+   ns->credits   = player.p->credits;
+   ntime_getR( &cycles, &periods, &seconds, &rem );
+   ns->date      = ntime_create( cycles, periods, seconds );
+   ns->shipname  = strdup( player.p->name );
+   ns->shipmodel = strdup( player.p->ship->name );
+}
+
+
+/**
+ * @brief Writes a saved game snapshot, in the threadpool.
+ *
+ * The new save is written next to the old one and renamed over it, so a
+ *  crash never leaves a half written save behind.
+ */
+static int save_write( void *data )
+{
+   SaveJob *job = (SaveJob*) data;
+   char file[PATH_MAX], tmp[PATH_MAX];
+#if DEBUGGING
+   Uint64 t0 = SDL_GetPerformanceCounter();
+#endif /* DEBUGGING */
+
+   job->ret = -1;
+
+   /* Back up old saved game. */
+   nsnprintf(file, PATH_MAX, "saves/%s.ns", job->name);
+   if (job->backup && (ndata_backupIfExists(file) < 0)) {
+      WARN(_("Aborting save..."));
+      goto done;
+   }
+
+   /* Compress and write the snapshot. */
+   nsnprintf(file, PATH_MAX, "%s/saves/%s.ns", PHYSFS_getWriteDir(), job->name); /* TODO: write via physfs */
+   nsnprintf(tmp, PATH_MAX, "%s.tmp", file);
+   if (xmlSaveFileEnc(tmp, job->doc, "UTF-8") < 0) {
+      WARN(_("Failed to write saved game '%s'!"), tmp);
+      remove(tmp);
+      goto done;
+   }
+
+   /* Replace the old save. */
+#if HAS_WIN32
+   remove(file); /* Windows won't rename over an existing file. */
+#endif /* HAS_WIN32 */
+   if (rename(tmp, file) != 0) {
+      WARN(_("Failed to write saved game!  You'll most likely have to restore it by copying your backup saved game over your current saved game."));
+      WARN(_("Unable to rename '%s' to '%s': %s"), tmp, file, strerror(errno));
+      goto done;
+   }
+   job->ret = 0;
+
+#if DEBUGGING
+   DEBUG(_("Wrote saved game in %.3f ms"),
+         1000. * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency());
+#endif /* DEBUGGING */
+
+   /* Let the load menu know without parsing the save. */
+   load_indexUpdate( &job->meta, job->backup );
+
+done:
+   SDL_AtomicSet( &job->finished, 1 );
+   return job->ret;
+}
+
+
+/**
+ * @brief Reports a finished save on the main thread.
+ *
+ *    @param wait Whether to wait for the save to finish.
+ */
+static void save_finish( int wait )
+{
+   SaveJob *job = save_job;
+
+   if (job == NULL)
+      return;
+   if (!SDL_AtomicGet( &job->finished )) {
+      if (!wait)
+         return;
+      while (!SDL_AtomicGet( &job->finished ))
+         SDL_Delay( 1 );
+   }
+   save_job = NULL;
+
+   if (job->done != NULL)
+      job->done( job->ret, job->data );
+
+   load_freeSave( &job->meta );
+   xmlFreeDoc( job->doc );
+   free( job->name );
+   free( job );
+}
+
+
+/**
+ * @brief Reports finished saves, should be called every frame.
+ */
+void save_update (void)
+{
+   save_finish( 0 );
+}
+
+
+/**
+ * @brief Waits for the save being written to finish.
+ *
+ * Must be called before reading the saves or exiting.
+ */
+void save_flush (void)
+{
+   save_finish( 1 );
+}
+
+
 /**
  * @brief Saves the current game.
  *
@@ -98,14 +258,37 @@ static int save_data( xmlTextWriterPtr writer )
  */
 int save_all (void)
 {
-   char file[PATH_MAX];
+   return save_allAsync( NULL, NULL );
+}
+
+
+/**
+ * @brief Saves the current game, writing it in the background.
+ *
+ * The game state is captured before returning, so it's safe to keep changing
+ *  it right away.
+ *
+ *    @param done Function to call on the main thread once the save is written
+ *           or failed, with 0 on success, may be NULL.
+ *    @param data User data for done.
+ *    @return 0 if the game state was captured, done is only called then.
+ */
+int save_allAsync( save_done_t done, void *data )
+{
    xmlDocPtr doc;
    xmlTextWriterPtr writer;
+   SaveJob *job;
+#if DEBUGGING
+   Uint64 t0 = SDL_GetPerformanceCounter();
+#endif /* DEBUGGING */
 
    /* Do not save if saving is off. */
    if (player_isFlag(PLAYER_NOSAVE))
       return 0;
 
+   /* Only one save can be written at a time. */
+   save_flush();
+
    /* Create the writer. */
    writer = xmlNewTextWriterDoc(&doc, conf.save_compress);
    if (writer == NULL) {
@@ -135,32 +318,31 @@ int save_all (void)
    /* Finish element. */
    xmlw_endElem(writer); /* "naev_save" */
    xmlw_done(writer);
+   xmlFreeTextWriter(writer);
 
-   /* Write to file. */
+   /* Make sure the directory is there. */
    if (PHYSFS_mkdir("saves") == 0) {
       WARN(_("Failed to create save directory '%ssaves'."), PHYSFS_getWriteDir());
-      goto err_writer;
+      goto err;
    }
-   nsnprintf(file, PATH_MAX, "saves/%s.ns", player.name);
 
-   /* Back up old saved game. */
-   if (!save_loaded) {
-      if (ndata_backupIfExists(file) < 0) {
-         WARN(_("Aborting save..."));
-         goto err_writer;
-      }
-   }
+   /* Hand the snapshot over to be written. */
+   job         = calloc( 1, sizeof(SaveJob) );
+   job->doc    = doc;
+   job->name   = strdup( player.name );
+   job->backup = !save_loaded;
+   job->done   = done;
+   job->data   = data;
+   save_meta( &job->meta );
    save_loaded = 0;
+   save_job    = job;
+   if (threadpool_newJob( save_write, job ) < 0)
+      save_write( job );
 
-   /* Critical section, if crashes here player's game gets corrupted.
-    * Luckily we have a copy just in case... */
-   xmlFreeTextWriter(writer);
-   nsnprintf(file, PATH_MAX, "%s/saves/%s.ns", PHYSFS_getWriteDir(), player.name); /* TODO: write via physfs */
-   if (xmlSaveFileEnc(file, doc, "UTF-8") < 0) {
-      WARN(_("Failed to write saved game!  You'll most likely have to restore it by copying your backup saved game over your current saved game."));
-      goto err;
-   }
-   xmlFreeDoc(doc);
+#if DEBUGGING
+   DEBUG(_("Saved game snapshot in %.3f ms"),
+         1000. * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency());
+#endif /* DEBUGGING */
 
    return 0;
 
@@ -177,6 +359,7 @@ err:
 void save_reload (void)
 {
    char path[PATH_MAX];
+   save_flush();
    nsnprintf(path, PATH_MAX, "saves/%s.ns", player.name);
    load_gameFile( path );
 }
@@ -7,7 +7,18 @@
 #  define SAVE_H
 
 
+/**
+ * @brief Called when a saved game finished writing.
+ *
+ *    @param ret 0 on success.
+ *    @param data User data.
+ */
+typedef void (*save_done_t)( int ret, void *data );
+
 int save_all (void);
+int save_allAsync( save_done_t done, void *data );
+void save_update (void);
+void save_flush (void);
 void save_reload (void);
 
 
@@ -42,10 +42,17 @@ SHADERS = [
    ),
    Shader(
       name = "texture_interpolate",
-      vs_path = "texture.vert",
+      vs_path = "texture_interpolate.vert",
       fs_path = "texture_interpolate.frag",
       attributes = ["vertex"],
-      uniforms = ["projection", "color", "tex_mat", "sampler1", "sampler2", "inter"]
+      uniforms = ["projection", "color", "tex_mat", "tex_mat2", "sampler1", "sampler2", "inter"]
+   ),
+   Shader(
+      name = "texture_batch",
+      vs_path = "texture_batch.vert",
+      fs_path = "texture_batch.frag",
+      attributes = ["vertex", "vertex_tex", "vertex_tex2", "vertex_color", "vertex_inter"],
+      uniforms = ["projection", "sampler1", "sampler2"]
    ),
    Shader(
       name = "nebula",
@@ -25,6 +25,7 @@
 #include "log.h"
 #include "ndata.h"
 #include "nfile.h"
+#include "nhash.h"
 #include "nstring.h"
 #include "nxml.h"
 #include "shipstats.h"
@@ -50,6 +51,8 @@
 
 
 static Ship* ship_stack = NULL; /**< Stack of ships available in the game. */
+static NameHash ship_names; /**< Name index of the ship stack. */
+static XmlParseBatch *ship_parsing = NULL; /**< Ship files being parsed ahead of ships_load. */
 
 
 /*
@@ -68,13 +71,11 @@ static int ship_parse( Ship *temp, xmlNodePtr parent );
  */
 Ship* ship_get( const char* name )
 {
-   Ship *temp;
    int i;
 
-   temp = ship_stack;
-   for (i=0; i < array_size(ship_stack); i++)
-      if (strcmp(temp[i].name, name)==0)
-         return &temp[i];
+   i = nhash_get( &ship_names, name );
+   if (i >= 0)
+      return &ship_stack[i];
 
    WARN(_("Ship %s does not exist"), name);
    return NULL;
@@ -89,13 +90,11 @@ Ship* ship_get( const char* name )
  */
 Ship* ship_getW( const char* name )
 {
-   Ship *temp;
    int i;
 
-   temp = ship_stack;
-   for (i=0; i < array_size(ship_stack); i++)
-      if (strcmp(temp[i].name, name)==0)
-         return &temp[i];
+   i = nhash_get( &ship_names, name );
+   if (i >= 0)
+      return &ship_stack[i];
 
    return NULL;
 }
@@ -517,7 +516,7 @@ static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
  */
 static int ship_loadEngineImage( Ship *temp, char *str, int sx, int sy )
 {
-   temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
+   temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ASYNC );
    return (temp->gfx_engine != NULL);
 }
 
@@ -882,7 +881,7 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
                   temp->gfx_overlays = realloc( temp->gfx_overlays, m * sizeof( glTexture * ) );
                }
                temp->gfx_overlays[ temp->gfx_noverlays-1 ] = xml_parseTexture( cur,
-                     OVERLAY_GFX_PATH"%s", 1, 1, OPENGL_TEX_MIPMAPS );
+                     OVERLAY_GFX_PATH"%s", 1, 1, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ASYNC );
             }
          } while (xml_nextNode(cur));
          continue;
@@ -1061,37 +1060,64 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
 
 
 /**
- * @brief Loads all the ships in the data files.
+ * @brief Starts reading and parsing the ship files in the background.
+ *
+ * Called before the stages ships_load depends on, so the files are parsed
+ * while they load.
  *
  *    @return 0 on success.
  */
-int ships_load (void)
+int ships_prefetch (void)
 {
-   size_t nfiles;
-   char **ship_files, *file;
+   char **ship_files, **files, *file;
    int i, sl;
-   xmlNodePtr node;
-   xmlDocPtr doc;
 
-   /* Validity. */
-   ss_check();
+   if (ship_parsing != NULL)
+      return 0;
 
    ship_files = PHYSFS_enumerateFiles( SHIP_DATA_PATH );
-   for (nfiles=0; ship_files[nfiles]!=NULL; nfiles++) {}
-
-   /* Initialize stack if needed. */
-   if (ship_stack == NULL) {
-      ship_stack = array_create_size(Ship, nfiles);
-   }
-
+   files = array_create( char* );
    for (i=0; ship_files[i]!=NULL; i++) {
       /* Get the file name .*/
       sl   = strlen(SHIP_DATA_PATH)+strlen(ship_files[i])+1;
       file = malloc( sl );
       nsnprintf( file, sl, "%s%s", SHIP_DATA_PATH, ship_files[i] );
+      array_push_back( &files, file );
+   }
+   PHYSFS_freeList( ship_files );
+
+   ship_parsing = xml_parsePhysFSStart( files );
+   return 0;
+}
 
-      /* Load the XML. */
-      doc  = xml_parsePhysFS( file );
+
+/**
+ * @brief Loads all the ships in the data files.
+ *
+ *    @return 0 on success.
+ */
+int ships_load (void)
+{
+   char **files, *file;
+   int i;
+   xmlNodePtr node;
+   xmlDocPtr doc, *docs;
+
+   /* Validity. */
+   ss_check();
+
+   /* Read and parse the files in parallel, if not already started. */
+   ships_prefetch();
+   docs = xml_parsePhysFSFinish( ship_parsing, &files );
+   ship_parsing = NULL;
+
+   /* Initialize stack if needed. */
+   if (ship_stack == NULL)
+      ship_stack = array_create_size(Ship, MAX(array_size(files),1));
+
+   for (i=0; i<array_size(files); i++) {
+      file = files[i];
+      doc  = docs[i];
 
       if (doc == NULL) {
          free(file);
@@ -1116,12 +1142,17 @@ int ships_load (void)
       xmlFreeDoc(doc);
    }
 
+   array_free( files );
+   array_free( docs );
+
    /* Shrink stack. */
    array_shrink(&ship_stack);
-   DEBUG( n_( "Loaded %d Ship", "Loaded %d Ships", array_size(ship_stack) ), array_size(ship_stack) );
 
-   /* Clean up. */
-   PHYSFS_freeList( ship_files );
+   /* Index the names. */
+   nhash_init( &ship_names );
+   for (i=0; i<array_size(ship_stack); i++)
+      nhash_add( &ship_names, ship_stack[i].name, i );
+   DEBUG( n_( "Loaded %d Ship", "Loaded %d Ships", array_size(ship_stack) ), array_size(ship_stack) );
 
    return 0;
 }
@@ -1181,4 +1212,5 @@ void ships_free (void)
 
    array_free(ship_stack);
    ship_stack = NULL;
+   nhash_free(&ship_names);
 }
@@ -157,6 +157,7 @@ typedef struct Ship_ {
 /*
  * load/quit
  */
+int ships_prefetch (void);
 int ships_load (void);
 void ships_free (void);
 
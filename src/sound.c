@@ -13,6 +13,7 @@
 #include <sys/stat.h>
 #include "physfs.h"
 #include "SDL.h"
+#include "SDL_atomic.h"
 #include "SDL_mutex.h"
 #include "SDL_thread.h"
 
@@ -33,14 +34,20 @@
 #include "physics.h"
 #include "player.h"
 #include "sound_openal.h"
+#include "threadpool.h"
 
 
 #define SOUND_SUFFIX_WAV   ".wav" /**< Suffix of sounds. */
 #define SOUND_SUFFIX_OGG   ".ogg" /**< Suffix of sounds. */
 
 
-#define voiceLock()        SDL_LockMutex(voice_mutex)
-#define voiceUnlock()      SDL_UnlockMutex(voice_mutex)
+#define VOICE_SLOT_BITS    16 /**< Bits of a voice handle used for the slot. */
+#define VOICE_SLOT_MASK    ((1<<VOICE_SLOT_BITS)-1) /**< Mask to get the slot of a voice handle. */
+#define VOICE_GEN_MASK     0x7FFF /**< Mask for the generation of a voice handle. */
+#define VOICE_QUEUE_SIZE   1024 /**< Size of the voice command queue, must be a power of two. */
+
+#define listLock()         SDL_LockMutex(sound_listMutex)
+#define listUnlock()       SDL_UnlockMutex(sound_listMutex)
 
 
 /*
@@ -54,15 +61,55 @@ static int sound_initialized  = 0; /**< Whether or not sound is initialized. */
  * Sound list.
  */
 static alSound *sound_list    = NULL; /**< List of available sounds. */
+static SDL_mutex *sound_listMutex = NULL; /**< Lock for the sound list, decoding is done in the background. */
+static size_t sound_mem       = 0; /**< Bytes of decoded sound data, protected by sound_listMutex. */
+static int sound_jobs         = 0; /**< Decoding jobs in flight, protected by sound_listMutex. */
+
+
+/**
+ * @brief Sound to decode in the background.
+ */
+typedef struct soundJob_s {
+   int id; /**< Sound to decode. */
+   char *filename; /**< File to read. */
+   char *name; /**< Name of the sound. */
+} soundJob;
 
 
 /*
  * Voices.
  */
-static int voice_genid        = 0; /**< Voice identifier generator. */
-alVoice *voice_active         = NULL; /**< Active voices. */
-static alVoice *voice_pool    = NULL; /**< Pool of free voices. */
-static SDL_mutex *voice_mutex = NULL; /**< Lock for voices. */
+static alVoice **voice_slots  = NULL; /**< All voices, indexed by the slot of their handle (array.h). */
+static int *voice_pool        = NULL; /**< Slots of the free voices (array.h). */
+static int *voice_live        = NULL; /**< Slots of the active voices (array.h). */
+
+
+/**
+ * @brief Types of commands sent to the voices.
+ */
+typedef enum voiceCmdType_e {
+   VOICE_CMD_POS, /**< Update position and velocity. */
+   VOICE_CMD_STOP /**< Stop the voice. */
+} voiceCmdType_t;
+
+
+/**
+ * @brief Command for a voice, applied in sound_update().
+ */
+typedef struct voiceCmd_s {
+   voiceCmdType_t type; /**< Type of the command. */
+   int id; /**< Handle of the voice. */
+   double pos[2]; /**< New position. */
+   double vel[2]; /**< New velocity. */
+} voiceCmd;
+
+
+/*
+ * Single producer single consumer queue from the game to the voice update.
+ */
+static voiceCmd voice_queue[ VOICE_QUEUE_SIZE ]; /**< Queued voice commands. */
+static SDL_atomic_t voice_qhead; /**< Next command to read, only written by the consumer. */
+static SDL_atomic_t voice_qtail; /**< Next command to write, only written by the producer. */
 
 
 /*
@@ -79,7 +126,15 @@ static double snd_compression_gain = 0.; /**< Current compression gain. */
 /* General. */
 static int sound_makeList (void);
 static void sound_free( alSound *snd );
+static int sound_decode( void *data );
+static void sound_queue( int sound, int async );
+static alSound* sound_ready( int sound, int wait );
+static void sound_evict (void);
+static int sound_inUse( const alSound *snd );
 /* Voices. */
+static void voice_free( alVoice *v );
+static int voice_push( voiceCmdType_t type, int id, double px, double py, double vx, double vy );
+static void voice_process (void);
 
 
 /**
@@ -110,10 +165,9 @@ int sound_init (void)
       return ret;
    }
 
-   /* Create voice lock. */
-   voice_mutex = SDL_CreateMutex();
-   if (voice_mutex == NULL)
-      WARN(_("Unable to create voice mutex."));
+   sound_listMutex = SDL_CreateMutex();
+   if (sound_listMutex == NULL)
+      WARN(_("Unable to create sound list mutex."));
 
    /* Load available sounds. */
    ret = sound_makeList();
@@ -155,7 +209,6 @@ int sound_init (void)
 void sound_exit (void)
 {
    int i;
-   alVoice *v;
 
    /* Nothing to disable. */
    if (sound_disabled || !sound_initialized)
@@ -164,30 +217,36 @@ void sound_exit (void)
    /* Exit music subsystem. */
    music_exit();
 
-   if (voice_mutex != NULL) {
-      voiceLock();
-      /* free the voices. */
-      while (voice_active != NULL) {
-         v = voice_active;
-         voice_active = v->next;
-         free(v);
-      }
-      while (voice_pool != NULL) {
-         v = voice_pool;
-         voice_pool = v->next;
-         free(v);
-      }
-      voiceUnlock();
-
-      /* Destroy voice lock. */
-      SDL_DestroyMutex(voice_mutex);
-      voice_mutex = NULL;
+   /* free the voices. */
+   for (i=0; i<array_size(voice_slots); i++)
+      free( voice_slots[i] );
+   array_free( voice_slots );
+   array_free( voice_pool );
+   array_free( voice_live );
+   voice_slots = NULL;
+   voice_pool  = NULL;
+   voice_live  = NULL;
+   SDL_AtomicSet( &voice_qhead, 0 );
+   SDL_AtomicSet( &voice_qtail, 0 );
+
+   /* Wait for the sounds being decoded. */
+   while (1) {
+      listLock();
+      i = sound_jobs;
+      listUnlock();
+      if (i == 0)
+         break;
+      SDL_Delay( 1 );
    }
 
    /* free the sounds */
    for (i=0; i<array_size(sound_list); i++)
       sound_free( &sound_list[i] );
    array_free( sound_list );
+   sound_list = NULL;
+   sound_mem  = 0;
+   SDL_DestroyMutex( sound_listMutex );
+   sound_listMutex = NULL;
 
    /* Exit sound subsystem. */
    sound_al_exit();
@@ -222,15 +281,47 @@ int sound_get( const char* name )
 /**
  * @brief Gets the length of the sound buffer.
  *
+ * Decodes the sound if it isn't loaded yet.
+ *
  *    @param sound ID of the buffer to get the length of..
  *    @return The length of the buffer.
  */
 double sound_getLength( int sound )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0.;
 
-   return sound_list[sound].length;
+   if ((sound < 0) || (sound >= array_size(sound_list)))
+      return 0.;
+
+   s = sound_ready( sound, 1 );
+   return (s == NULL) ? 0. : s->length;
+}
+
+
+/**
+ * @brief Starts decoding a sound in the background so it's ready when played.
+ *
+ * Preloaded sounds are played with sound_playPos(), which drops the sound if
+ *  it isn't decoded, so they never get evicted.
+ *
+ *    @param sound Sound to preload.
+ */
+void sound_preload( int sound )
+{
+   if (sound_disabled)
+      return;
+
+   if ((sound < 0) || (sound >= array_size(sound_list)))
+      return;
+
+   listLock();
+   sound_list[ sound ].keep = 1;
+   listUnlock();
+
+   sound_ready( sound, 0 );
 }
 
 
@@ -251,11 +342,15 @@ int sound_play( int sound )
    if ((sound < 0) || (sound >= array_size(sound_list)))
       return -1;
 
+   /* Get the sound, interface sounds shouldn't get dropped so wait for it. */
+   s = sound_ready( sound, 1 );
+   if (s == NULL)
+      return -1;
+
    /* Gets a new voice. */
    v = voice_new();
-
-   /* Get the sound. */
-   s = &sound_list[sound];
+   if (v == NULL)
+      return -1;
 
    /* Try to play the sound. */
    if (sound_al_play( v, s ))
@@ -263,7 +358,6 @@ int sound_play( int sound )
 
    /* Set state and add to list. */
    v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
    voice_add(v);
 
    return v->id;
@@ -310,11 +404,16 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
          return 0;
    }
 
+   /* Get the sound, if it's not decoded yet it gets queued and this
+    * instance is skipped. */
+   s = sound_ready( sound, 0 );
+   if (s == NULL)
+      return 0;
+
    /* Gets a new voice. */
    v = voice_new();
-
-   /* Get the sound. */
-   s = &sound_list[sound];
+   if (v == NULL)
+      return -1;
 
    /* Try to play the sound. */
    if (sound_al_playPos( v, s, px, py, vx, vy ))
@@ -322,7 +421,6 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
 
    /* Actually add the voice to the list. */
    v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
    voice_add(v);
 
    return v->id;
@@ -332,6 +430,8 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
 /**
  * @brief Updates the position of a voice.
  *
+ * The update gets queued and is applied in sound_update().
+ *
  *    @param voice Identifier of the voice to update.
  *    @param px New x position to update to.
  *    @param py New y position to update to.
@@ -340,20 +440,13 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
  */
 int sound_updatePos( int voice, double px, double py, double vx, double vy )
 {
-   alVoice *v;
-
    if (sound_disabled)
       return 0;
 
-   v = voice_get(voice);
-   if (v != NULL) {
-
-      /* Update the voice. */
-      if (sound_al_updatePos( v, px, py, vx, vy))
-         return -1;
-   }
+   if (voice <= 0)
+      return 0;
 
-   return 0;
+   return voice_push( VOICE_CMD_POS, voice, px, py, vx, vy );
 }
 
 
@@ -364,7 +457,8 @@ int sound_updatePos( int voice, double px, double py, double vx, double vy )
  */
 int sound_update( double dt )
 {
-   alVoice *v, *tv;
+   int i;
+   alVoice *v;
 
    /* Update music if needed. */
    music_update(dt);
@@ -375,48 +469,25 @@ int sound_update( double dt )
    /* System update. */
    sound_al_update();
 
-   if (voice_active == NULL)
-      return 0;
-
-   voiceLock();
+   /* Apply what the game asked for since last update. */
+   voice_process();
 
-   /* The actual control loop. */
-   for (v=voice_active; v!=NULL; v=v->next) {
+   /* The actual control loop, backwards so freeing can swap in the last voice. */
+   soundLock();
+   for (i=array_size(voice_live)-1; i>=0; i--) {
+      v = voice_slots[ voice_live[i] ];
 
       /* Run first to clear in same iteration. */
       sound_al_updateVoice( v );
 
       /* Destroy and toss into pool. */
-      if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY)) {
-
-         /* Remove from active list. */
-         tv = v->prev;
-         if (tv == NULL) {
-            voice_active = v->next;
-            if (voice_active != NULL)
-               voice_active->prev = NULL;
-         }
-         else {
-            tv->next = v->next;
-            if (tv->next != NULL)
-               tv->next->prev = tv;
-         }
-
-         /* Add to free pool. */
-         v->next = voice_pool;
-         v->prev = NULL;
-         voice_pool = v;
-         if (v->next != NULL)
-            v->next->prev = v;
-
-         /* Avoid loop blockage. */
-         v = (tv != NULL) ? tv->next : voice_active;
-         if (v == NULL)
-            break;
-      }
+      if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY))
+         voice_free( v );
    }
+   soundUnlock();
 
-   voiceUnlock();
+   /* Free decoded sounds that weren't used in a while. */
+   sound_evict();
 
    return 0;
 }
@@ -457,42 +528,36 @@ void sound_resume (void)
  */
 void sound_stopAll (void)
 {
+   int i;
    alVoice *v;
 
    if (sound_disabled)
       return;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
-      return;
-
-   voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next) {
+   for (i=0; i<array_size(voice_live); i++) {
+      v = voice_slots[ voice_live[i] ];
       sound_al_stop( v );
       v->state = VOICE_STOPPED;
    }
-   voiceUnlock();
 }
 
 
 /**
  * @brief Stops a voice from playing.
  *
+ * The stop gets queued and is applied in sound_update().
+ *
  *    @param voice Identifier of the voice to stop.
  */
 void sound_stop( int voice )
 {
-   alVoice *v;
-
    if (sound_disabled)
       return;
 
-   v = voice_get(voice);
-   if (v != NULL) {
-      sound_al_stop( v );
-      v->state = VOICE_STOPPED;
-   }
+   if (voice <= 0)
+      return;
 
+   voice_push( VOICE_CMD_STOP, voice, 0., 0., 0., 0. );
 }
 
 
@@ -566,7 +631,7 @@ static int sound_makeList (void)
    size_t i;
    char path[PATH_MAX];
    int len, suflen, flen;
-   SDL_RWops *rw;
+   alSound *snd;
 
    if (sound_disabled)
       return 0;
@@ -591,19 +656,21 @@ static int sound_makeList (void)
             (strncmp( &files[i][flen - suflen], SOUND_SUFFIX_OGG, suflen)!=0))
          continue;
 
-      /* Load the sound. */
       nsnprintf( path, PATH_MAX, SOUND_PATH"%s", files[i] );
-      rw = PHYSFSRWOPS_openRead( path );
 
       /* remove the suffix */
       len = flen - suflen;
       files[i][len] = '\0';
 
-      source_newRW( rw, files[i], 0 );
-      SDL_RWclose( rw );
+      /* Only register the sound, it gets decoded when first needed. */
+      snd = &array_grow( &sound_list );
+      memset( snd, 0, sizeof(alSound) );
+      snd->filename = strdup( path );
+      snd->name     = strdup( files[i] );
+      snd->state    = SOUND_UNLOADED;
    }
 
-   DEBUG( n_("Loaded %d Sound", "Loaded %d Sounds", array_size(sound_list)), array_size(sound_list) );
+   DEBUG( n_("Registered %d Sound", "Registered %d Sounds", array_size(sound_list)), array_size(sound_list) );
 
    /* Clean up. */
    PHYSFS_freeList( files );
@@ -667,7 +734,188 @@ static void sound_free( alSound *snd )
    free(snd->filename);
 
    /* Free internals. */
-   sound_al_free(snd);
+   if (snd->state == SOUND_LOADED)
+      sound_al_free(snd);
+}
+
+
+/**
+ * @brief Decodes a sound, run from the threadpool.
+ *
+ *    @param data Job to run, gets freed.
+ *    @return 0 on success.
+ */
+static int sound_decode( void *data )
+{
+   soundJob *job;
+   SDL_RWops *rw;
+   alSound snd, *s;
+   int ret;
+
+   job = (soundJob*) data;
+   memset( &snd, 0, sizeof(alSound) );
+   rw = PHYSFSRWOPS_openRead( job->filename );
+   if (rw == NULL) {
+      WARN(_("Unable to open sound file '%s'."), job->filename);
+      ret = -1;
+   }
+   else {
+      ret = sound_al_load( &snd, rw, job->name );
+      SDL_RWclose( rw );
+   }
+
+   /* The list may have been reallocated, so look it up again. */
+   listLock();
+   s = &sound_list[ job->id ];
+   if (ret == 0) {
+      s->buf    = snd.buf;
+      s->length = snd.length;
+      s->mem    = snd.mem;
+      s->state  = SOUND_LOADED;
+      sound_mem += snd.mem;
+   }
+   else
+      s->state  = SOUND_FAILED;
+   sound_jobs--;
+   listUnlock();
+
+   free( job->filename );
+   free( job->name );
+   free( job );
+   return ret;
+}
+
+
+/**
+ * @brief Queues a sound for decoding.
+ *
+ *    @param sound Sound to decode, must be unloaded.
+ *    @param async Whether to decode in the threadpool or right away.
+ */
+static void sound_queue( int sound, int async )
+{
+   soundJob *job;
+   alSound *s;
+
+   job = malloc( sizeof(soundJob) );
+   job->id = sound;
+
+   listLock();
+   s = &sound_list[ sound ];
+   s->state = SOUND_LOADING;
+   job->filename = strdup( s->filename );
+   job->name     = strdup( s->name );
+   sound_jobs++;
+   listUnlock();
+
+   if (async)
+      threadpool_newJob( sound_decode, job );
+   else
+      sound_decode( job );
+}
+
+
+/**
+ * @brief Gets a sound ready to play, decoding it if needed.
+ *
+ *    @param sound Sound to get.
+ *    @param wait Whether to wait for the decoding instead of doing it in the background.
+ *    @return The sound if it can be played, NULL otherwise.
+ */
+static alSound* sound_ready( int sound, int wait )
+{
+   alSound *s;
+   sound_state_t state;
+
+   while (1) {
+      listLock();
+      s = &sound_list[ sound ];
+      state = s->state;
+      listUnlock();
+
+      switch (state) {
+         case SOUND_LOADED:
+            s->used = SDL_GetTicks();
+            return s;
+
+         case SOUND_FAILED:
+            return NULL;
+
+         case SOUND_UNLOADED:
+            sound_queue( sound, !wait );
+            if (!wait)
+               return NULL;
+            break;
+
+         case SOUND_LOADING:
+            if (!wait)
+               return NULL;
+            SDL_Delay( 1 );
+            break;
+      }
+   }
+}
+
+
+/**
+ * @brief Checks to see if a voice or group is using a sound.
+ */
+static int sound_inUse( const alSound *snd )
+{
+   int i;
+
+   if (snd->keep)
+      return 1;
+
+   for (i=0; i<array_size(voice_live); i++)
+      if (voice_slots[ voice_live[i] ]->buffer == snd->buf)
+         return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Frees the least recently played sounds while over conf.snd_cache.
+ *
+ * Only sounds that were read from a file get evicted, since they can be
+ * decoded again. A cache size of 0 never evicts.
+ */
+static void sound_evict (void)
+{
+   int i, j;
+   size_t budget;
+   unsigned int age, oldest;
+   alSound *s;
+
+   if (conf.snd_cache <= 0)
+      return;
+   budget = (size_t)conf.snd_cache << 20;
+
+   listLock();
+   while (sound_mem > budget) {
+      /* Find the least recently played sound not in use. */
+      j = -1;
+      oldest = 0;
+      for (i=0; i<array_size(sound_list); i++) {
+         s = &sound_list[i];
+         if ((s->state != SOUND_LOADED) || (s->filename == NULL))
+            continue;
+         age = SDL_GetTicks() - s->used;
+         if (((j < 0) || (age > oldest)) && !sound_inUse( s )) {
+            j = i;
+            oldest = age;
+         }
+      }
+      if (j < 0)
+         break;
+
+      s = &sound_list[j];
+      sound_al_free( s );
+      s->buf   = 0;
+      s->state = SOUND_UNLOADED;
+      sound_mem -= s->mem;
+   }
+   listUnlock();
 }
 
 
@@ -696,13 +944,21 @@ int sound_createGroup( int size )
  */
 int sound_playGroup( int group, int sound, int once )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0;
 
    if ((sound < 0) || (sound >= array_size(sound_list)))
       return -1;
 
-   return sound_al_playGroup( group, &sound_list[sound], once );
+   /* Groups keep the buffer attached to their sources. */
+   s = sound_ready( sound, 1 );
+   if (s == NULL)
+      return -1;
+   s->keep = 1;
+
+   return sound_al_playGroup( group, s, once );
 }
 
 
@@ -794,82 +1050,81 @@ int sound_env( SoundEnv_t env, double param )
 }
 
 
-/**
- * @brief Locks the voices.
- */
-void voice_lock (void)
-{
-   voiceLock();
-}
-
-
-/**
- * @brief Unlocks the voices.
- */
-void voice_unlock (void)
-{
-   voiceUnlock();
-}
-
-
 /**
  * @brief Gets a new voice ready to be used.
  *
+ * The voice stays free until it's passed to voice_add().
+ *
  *    @return New voice ready to use.
  */
 alVoice* voice_new (void)
 {
    alVoice *v;
 
+   if (voice_slots == NULL) {
+      voice_slots = array_create( alVoice* );
+      voice_pool  = array_create( int );
+      voice_live  = array_create( int );
+   }
+
    /* No free voices, allocate a new one. */
-   if (voice_pool == NULL) {
+   if (array_size(voice_pool) == 0) {
+      if (array_size(voice_slots) >= VOICE_SLOT_MASK) {
+         WARN(_("Too many voices!"));
+         return NULL;
+      }
       v = calloc( 1, sizeof(alVoice) );
-      voice_pool = v;
+      v->slot = array_size(voice_slots);
+      v->live = -1;
+      array_push_back( &voice_slots, v );
+      array_push_back( &voice_pool, v->slot );
       return v;
    }
 
-   /* First free voice. */
-   v = voice_pool; /* We do not touch the next nor prev, it's still in the pool. */
-   return v;
+   /* Last free voice, it stays free until added. */
+   return voice_slots[ voice_pool[ array_size(voice_pool)-1 ] ];
 }
 
 
 /**
- * @brief Adds a voice to the active voice stack.
+ * @brief Adds a voice to the active voices and gives it a handle.
  *
- *    @param v Voice to add to the active voice stack.
+ *    @param v Voice gotten with voice_new() to add.
  *    @return 0 on success.
  */
 int voice_add( alVoice* v )
 {
-   alVoice *tv;
-
-   /* Remove from pool. */
-   if (v->prev != NULL) {
-      tv = v->prev;
-      tv->next = v->next;
-      if (tv->next != NULL)
-         tv->next->prev = tv;
-   }
-   else { /* Set pool to be the next. */
-      voice_pool = v->next;
-      if (voice_pool != NULL)
-         voice_pool->prev = NULL;
-   }
+   /* Remove from the free slots. */
+   array_resize( &voice_pool, array_size(voice_pool)-1 );
 
-   /* Insert to the front of active voices. */
-   voiceLock();
-   tv = voice_active;
-   v->next = tv;
-   v->prev = NULL;
-   voice_active = v;
-   if (tv != NULL)
-      tv->prev = v;
-   voiceUnlock();
+   v->id   = (v->gen << VOICE_SLOT_BITS) | (v->slot+1);
+   v->live = array_size(voice_live);
+   array_push_back( &voice_live, v->slot );
    return 0;
 }
 
 
+/**
+ * @brief Removes a voice from the active voices, invalidating its handle.
+ *
+ *    @param v Voice to free.
+ */
+static void voice_free( alVoice *v )
+{
+   int last;
+
+   /* Swap the last active voice into its place. */
+   last = voice_live[ array_size(voice_live)-1 ];
+   voice_live[ v->live ] = last;
+   voice_slots[ last ]->live = v->live;
+   array_resize( &voice_live, array_size(voice_live)-1 );
+
+   v->live = -1;
+   v->gen  = (v->gen+1) & VOICE_GEN_MASK;
+   array_push_back( &voice_pool, v->slot );
+}
+
+
 /**
  * @brief Gets a voice by identifier.
  *
@@ -878,22 +1133,81 @@ int voice_add( alVoice* v )
  */
 alVoice* voice_get( int id )
 {
+   int slot;
    alVoice *v;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
+   slot = (id & VOICE_SLOT_MASK) - 1;
+   if ((slot < 0) || (slot >= array_size(voice_slots)))
       return NULL;
 
-   voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next)
-      if (v->id == id)
-         break;
-   voiceUnlock();
-
+   /* Stale handles have an old generation. */
+   v = voice_slots[ slot ];
+   if ((v->live < 0) || (v->id != id))
+      return NULL;
    return v;
 }
 
 
+/**
+ * @brief Queues a command for a voice.
+ *
+ *    @return 0 on success, -1 if the queue is full.
+ */
+static int voice_push( voiceCmdType_t type, int id, double px, double py, double vx, double vy )
+{
+   int head, tail;
+   voiceCmd *cmd;
+
+   tail = SDL_AtomicGet( &voice_qtail );
+   head = SDL_AtomicGet( &voice_qhead );
+   if (tail - head >= VOICE_QUEUE_SIZE)
+      return -1;
+
+   cmd = &voice_queue[ tail & (VOICE_QUEUE_SIZE-1) ];
+   cmd->type   = type;
+   cmd->id     = id;
+   cmd->pos[0] = px;
+   cmd->pos[1] = py;
+   cmd->vel[0] = vx;
+   cmd->vel[1] = vy;
+
+   /* Publish the command. */
+   SDL_AtomicSet( &voice_qtail, tail+1 );
+   return 0;
+}
+
+
+/**
+ * @brief Applies the queued voice commands.
+ */
+static void voice_process (void)
+{
+   int head, tail;
+   voiceCmd *cmd;
+   alVoice *v;
+
+   head = SDL_AtomicGet( &voice_qhead );
+   tail = SDL_AtomicGet( &voice_qtail );
+   for ( ; head != tail; head++) {
+      cmd = &voice_queue[ head & (VOICE_QUEUE_SIZE-1) ];
+      v = voice_get( cmd->id );
+      if (v == NULL)
+         continue;
+
+      switch (cmd->type) {
+         case VOICE_CMD_POS:
+            sound_al_updatePos( v, cmd->pos[0], cmd->pos[1], cmd->vel[0], cmd->vel[1] );
+            break;
+         case VOICE_CMD_STOP:
+            sound_al_stop( v );
+            v->state = VOICE_STOPPED;
+            break;
+      }
+   }
+   SDL_AtomicSet( &voice_qhead, head );
+}
+
+
 /**
  * @brief Loads a new sound source from a RWops.
  */
@@ -911,9 +1225,15 @@ int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
    if (ret)
       return -1;
 
+   /* The list may be in use by the decoding jobs. */
+   listLock();
    sndl = &array_grow( &sound_list );
    memcpy( sndl, &snd, sizeof(alSound) );
-   sndl->name = strdup( name );
+   sndl->name  = strdup( name );
+   sndl->state = SOUND_LOADED;
+   sndl->used  = SDL_GetTicks();
+   sound_mem  += snd.mem;
+   listUnlock();
 
    return sndl-sound_list;
 }
@@ -742,6 +742,7 @@ int sound_al_load( alSound *snd, SDL_RWops *rw, const char *name )
    }
    else
       snd->length = (double)size / (double)(freq * (bits/8) * channels);
+   snd->mem = size;
 
    /* Check for errors. */
    al_checkErr();
@@ -877,7 +878,9 @@ static int al_playVoice( alVoice *v, alSound *s,
    v->vel[2] = 0.;
 
    /* Set up properties. */
-   alSourcef(  v->source, AL_GAIN, svolume*svolume_speed );
+   v->gain  = svolume*svolume_speed;
+   v->dirty = 0;
+   alSourcef(  v->source, AL_GAIN, v->gain );
    alSourcefv( v->source, AL_POSITION, v->pos );
    alSourcefv( v->source, AL_VELOCITY, v->vel );
 
@@ -937,6 +940,7 @@ int sound_al_updatePos( alVoice *v,
    v->pos[1] = py;
    v->vel[0] = vx;
    v->vel[1] = vy;
+   v->dirty  = 1;
 
    return 0;
 }
@@ -945,11 +949,15 @@ int sound_al_updatePos( alVoice *v,
 /**
  * @brief Updates the voice.
  *
+ * Only sends the properties that changed. The caller must hold the sound
+ * lock, so all the voices get updated under a single lock.
+ *
  *    @param v Voice to update.
  */
 void sound_al_updateVoice( alVoice *v )
 {
    ALint state;
+   ALfloat gain;
 
    /* Invalid source, mark to delete. */
    if (v->source == 0) {
@@ -957,8 +965,6 @@ void sound_al_updateVoice( alVoice *v )
       return;
    }
 
-   soundLock();
-
    /* Get status. */
    alGetSourcei( v->source, AL_SOURCE_STATE, &state );
    if (state == AL_STOPPED) {
@@ -969,8 +975,6 @@ void sound_al_updateVoice( alVoice *v )
       /* Check for errors. */
       al_checkErr();
 
-      soundUnlock();
-
       /* Put source back on the list. */
       source_stack[source_nstack] = v->source;
       source_nstack++;
@@ -982,14 +986,19 @@ void sound_al_updateVoice( alVoice *v )
    }
 
    /* Set up properties. */
-   alSourcef(  v->source, AL_GAIN, svolume*svolume_speed );
-   alSourcefv( v->source, AL_POSITION, v->pos );
-   alSourcefv( v->source, AL_VELOCITY, v->vel );
+   gain = svolume*svolume_speed;
+   if (gain != v->gain) {
+      alSourcef( v->source, AL_GAIN, gain );
+      v->gain = gain;
+   }
+   if (v->dirty) {
+      alSource3f( v->source, AL_POSITION, v->pos[0], v->pos[1], 0. );
+      alSource3f( v->source, AL_VELOCITY, v->vel[0], v->vel[1], 0. );
+      v->dirty = 0;
+   }
 
    /* Check for errors. */
    al_checkErr();
-
-   soundUnlock();
 }
 
 
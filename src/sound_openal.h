@@ -17,6 +17,19 @@
 #include "sound.h"
 
 
+/**
+ * @typedef sound_state_t
+ * @brief Whether the data of a sound is available.
+ * @sa alSound
+ */
+typedef enum sound_state_ {
+   SOUND_UNLOADED, /**< Only registered, not decoded. */
+   SOUND_LOADING, /**< Queued for decoding. */
+   SOUND_LOADED, /**< Buffer is ready to play. */
+   SOUND_FAILED /**< Decoding failed, don't try again. */
+} sound_state_t;
+
+
 /**
  * @struct alSound
  *
@@ -27,6 +40,10 @@ typedef struct alSound_ {
    char *name; /**< Buffer's name. */
    double length; /**< Length of the buffer. */
    ALuint buf; /**< Buffer data. */
+   sound_state_t state; /**< Whether the buffer is loaded. */
+   size_t mem; /**< Size of the buffer data in bytes. */
+   unsigned int used; /**< Ticks the sound was last played at. */
+   int keep; /**< Can't be evicted (used by groups and preloaded sounds). */
 } alSound;
 
 
@@ -51,32 +68,26 @@ typedef enum voice_state_ {
  * A voice would be any object that is creating sound.
  */
 typedef struct alVoice_ {
-   struct alVoice_ *prev; /**< Linked list previous member. */
-   struct alVoice_ *next; /**< Linked list next member. */
-
-   int id; /**< Identifier of the voice. */
+   int id; /**< Handle of the voice, generation and slot. */
+   int slot; /**< Slot of the voice. */
+   int gen; /**< Generation of the slot, invalidates stale handles. */
+   int live; /**< Index in the active voices or -1 if free. */
 
    voice_state_t state; /**< Current state of the sound. */
    unsigned int flags; /**< Voice flags. */
 
    ALfloat pos[3]; /**< Position of the voice. */
    ALfloat vel[3]; /**< Velocity of the voice. */
+   int dirty; /**< Position changed since it was last sent to OpenAL. */
+   ALfloat gain; /**< Gain last sent to OpenAL. */
    ALuint source; /**< Source current in use. */
    ALuint buffer; /**< Buffer attached to the voice. */
 } alVoice;
 
 
-/*
- * Sound list.
- */
-extern alVoice *voice_active; /**< Active voices. */
-
-
 /*
  * Voice management.
  */
-void voice_lock (void);
-void voice_unlock (void);
 alVoice* voice_new (void);
 int voice_add( alVoice* v );
 alVoice* voice_get( int id );
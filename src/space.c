@@ -19,6 +19,7 @@
 
 #include "space.h"
 
+#include "array.h"
 #include "background.h"
 #include "conf.h"
 #include "damagetype.h"
@@ -35,6 +36,7 @@
 #include "ndata.h"
 #include "nebula.h"
 #include "nfile.h"
+#include "nhash.h"
 #include "nlua.h"
 #include "nlua_pilot.h"
 #include "nlua_planet.h"
@@ -74,12 +76,15 @@
 
 #define ASTEROID_EXPLODE_INTERVAL 5. /**< Interval of asteroids randomly exploding */
 #define ASTEROID_EXPLODE_CHANCE   0.1 /**< Chance of asteroid exploding each interval */
+#define ASTEROID_GRID_CELL        256. /**< Minimum size of an asteroid grid cell. */
+#define ASTEROID_GRID_DIM         64 /**< Maximum number of asteroid grid cells per axis. */
 
 /*
  * planet <-> system name stack
  */
 static char** planetname_stack = NULL; /**< Planet name stack corresponding to system. */
 static char** systemname_stack = NULL; /**< System name stack corresponding to planet. */
+static NameHash planetname_index; /**< Name index of the planet <-> system name stack. */
 
 
 /*
@@ -92,6 +97,15 @@ StarSystem *systems_stack = NULL; /**< Star system stack. */
  */
 static Planet *planet_stack = NULL; /**< Planet stack. */
 
+/*
+ * Name indices, names are only set after system_new() and planet_new() so
+ * new elements get indexed lazily on lookup.
+ */
+static NameHash system_names; /**< Name index of the system stack. */
+static int system_nindexed = 0; /**< Number of systems in the name index. */
+static NameHash planet_names; /**< Name index of the planet stack. */
+static int planet_nindexed = 0; /**< Number of planets in the name index. */
+
 /*
  * Asteroid types stack.
  */
@@ -102,6 +116,8 @@ static int asteroid_ntypes = 0; /**< Asteroid types stack size. */
  * Misc.
  */
 static int systems_loading = 1; /**< Systems are loading. */
+static XmlParseBatch *planet_parsing = NULL; /**< Asset files being parsed ahead of space_load. */
+static XmlParseBatch *system_parsing = NULL; /**< Star system files being parsed ahead of space_load. */
 StarSystem *cur_system = NULL; /**< Current star system. */
 glTexture *jumppoint_gfx = NULL; /**< Jump point graphics. */
 static glTexture *jumpbuoy_gfx = NULL; /**< Jump buoy graphics. */
@@ -116,6 +132,7 @@ static size_t nasterogfx = 0; /**< Nb of asteroid gfx. */
  */
 int space_spawn = 1; /**< Spawn enabled by default. */
 extern Pilot** pilot_stack;
+extern Commodity* commodity_stack;
 
 
 /*
@@ -134,8 +151,17 @@ static int planet_parse( Planet *planet, const xmlNodePtr parent, Commodity **st
 static int space_parseAssets( xmlNodePtr parent, StarSystem* sys );
 /* system load */
 static void system_init( StarSystem *sys );
+static void space_indexNames (void);
+static void planetname_reindex (void);
 static void asteroid_init( Asteroid *ast, AsteroidAnchor *field );
+static void asteroid_gridCreate( AsteroidAnchor *field );
+static void asteroid_gridFree( AsteroidAnchor *field );
+static void asteroid_gridCell( const AsteroidGrid *grid, double x, double y, int *cx, int *cy );
+static void asteroid_gridUpdate( AsteroidAnchor *field, Asteroid *a );
+static int asteroid_queryBox( const AsteroidAnchor *field, double x1, double y1,
+      double x2, double y2, int **ids );
 static void debris_init( Debris *deb );
+static char** space_listFiles( const char *path );
 static int systems_load (void);
 static int asteroidTypes_load (void);
 static StarSystem* system_parse( StarSystem *system, const xmlNodePtr parent );
@@ -268,6 +294,21 @@ int planet_averagePlanetPrice( const Planet *p, const Commodity *c, credits_t *m
   return economy_getAveragePlanetPrice( c, p, mean, std );
 }
 
+
+/**
+ * @brief Gets where a commodity is in a planet's commodity list.
+ *
+ *    @param p Planet to look in.
+ *    @param c Commodity to look for.
+ *    @return Index into p->commodities and p->commodityPrice, -1 if not sold.
+ */
+int planet_commodityIndex( const Planet *p, const Commodity *c )
+{
+   if (p->commodityIndex == NULL)
+      return -1;
+   return p->commodityIndex[ c - commodity_stack ];
+}
+
 /**
  * @brief Changes the planets faction.
  *
@@ -720,17 +761,9 @@ int space_sysReachable( StarSystem *sys )
  */
 int space_sysReallyReachable( char* sysname )
 {
-   int njumps;
-   StarSystem** path;
-
    if (strcmp(sysname,cur_system->name)==0)
       return 1;
-   path = map_getJumpPath( &njumps, cur_system->name, sysname, 1, 1, NULL );
-   if (path != NULL) {
-      free(path);
-      return 1;
-   }
-   return 0;
+   return (map_getJumpDist( cur_system, system_get(sysname), 1, 1 ) > 0);
 }
 
 /**
@@ -768,11 +801,8 @@ StarSystem* system_getAll (void)
  */
 int system_exists( const char* sysname )
 {
-   int i;
-   for (i=0; i<array_size(systems_stack); i++)
-      if (strcmp(sysname, systems_stack[i].name)==0)
-         return 1;
-   return 0;
+   space_indexNames();
+   return (nhash_get( &system_names, sysname ) >= 0);
 }
 
 
@@ -838,9 +868,10 @@ StarSystem* system_get( const char* sysname )
    if ( sysname == NULL )
       return NULL;
 
-   for (i=0; i<array_size(systems_stack); i++)
-      if (strcmp(sysname, systems_stack[i].name)==0)
-         return &systems_stack[i];
+   space_indexNames();
+   i = nhash_get( &system_names, sysname );
+   if (i >= 0)
+      return &systems_stack[i];
 
    WARN(_("System '%s' not found in stack"), sysname);
    return NULL;
@@ -879,13 +910,7 @@ int system_index( StarSystem *sys )
  */
 int planet_hasSystem( const char* planetname )
 {
-   int i;
-
-   for (i=0; i<array_size(planetname_stack); i++)
-      if (strcmp(planetname_stack[i],planetname)==0)
-         return 1;
-
-   return 0;
+   return (nhash_get( &planetname_index, planetname ) >= 0);
 }
 
 
@@ -899,9 +924,9 @@ char* planet_getSystem( const char* planetname )
 {
    int i;
 
-   for (i=0; i<array_size(planetname_stack); i++)
-      if (strcmp(planetname_stack[i],planetname)==0)
-         return systemname_stack[i];
+   i = nhash_get( &planetname_index, planetname );
+   if (i >= 0)
+      return systemname_stack[i];
 
    DEBUG(_("Planet '%s' not found in planetname stack"), planetname);
    return NULL;
@@ -923,9 +948,10 @@ Planet* planet_get( const char* planetname )
       return NULL;
    }
 
-   for (i=0; i<array_size(planet_stack); i++)
-      if (strcmp(planet_stack[i].name,planetname)==0)
-         return &planet_stack[i];
+   space_indexNames();
+   i = nhash_get( &planet_names, planetname );
+   if (i >= 0)
+      return &planet_stack[i];
 
    WARN(_("Planet '%s' not found in the universe"), planetname);
    return NULL;
@@ -989,11 +1015,8 @@ void planet_setKnown( Planet *p )
  */
 int planet_exists( const char* planetname )
 {
-   int i;
-   for (i=0; i<array_size(planet_stack); i++)
-      if (strcmp(planet_stack[i].name,planetname)==0)
-         return 1;
-   return 0;
+   space_indexNames();
+   return (nhash_get( &planet_names, planetname ) >= 0);
 }
 
 
@@ -1356,6 +1379,7 @@ void space_update( const double dt )
       for (i=0; i<cur_system->njumps; i++) {
          if (( !jp_isKnown( &cur_system->jumps[i] )) && ( pilot_inRangeJump( player.p, i ))) {
             jp_setFlag( &cur_system->jumps[i], JP_KNOWN );
+            map_invalidateJumpDist();
             player_message( _("You discovered a Jump Point.") );
             hparam[0].type  = HOOK_PARAM_STRING;
             hparam[0].u.str = "jump";
@@ -1388,6 +1412,7 @@ void space_update( const double dt )
 
          a->pos.x += a->vel.x * dt;
          a->pos.y += a->vel.y * dt;
+         asteroid_gridUpdate( ast, a );
 
          if (a->appearing == ASTEROID_VISIBLE) {
             /* Random explosions */
@@ -1491,11 +1516,9 @@ void space_init( const char* sysname )
    if ((sysname==NULL) && (cur_system==NULL))
       ERR(_("Cannot reinit system if there is no system previously loaded"));
    else if (sysname!=NULL) {
-      for (i=0; i < array_size(systems_stack); i++)
-         if (strcmp(sysname, systems_stack[i].name)==0)
-            break;
-
-      if (i>=array_size(systems_stack))
+      space_indexNames();
+      i = nhash_get( &system_names, sysname );
+      if (i < 0)
          ERR(_("System %s not found in stack"), sysname);
       cur_system = &systems_stack[i];
 
@@ -1538,6 +1561,7 @@ void space_init( const char* sysname )
 
       /* Add the asteroids to the anchor */
       ast->asteroids = realloc( ast->asteroids, (ast->nb) * sizeof(Asteroid) );
+      asteroid_gridCreate( ast );
       for (j=0; j<ast->nb; j++) {
          a = &ast->asteroids[j];
          a->id = j;
@@ -1582,6 +1606,7 @@ void space_init( const char* sysname )
 
    /* we now know this system */
    sys_setFlag(cur_system,SYSTEM_KNOWN);
+   map_invalidateJumpDist();
 
    /* Simulate system. */
    space_simulating = 1;
@@ -1647,11 +1672,13 @@ void asteroid_init( Asteroid *ast, AsteroidAnchor *field )
       if ( (ast->appearing == ASTEROID_INIT) &&
             (space_isInField(&ast->pos) < 0) ) {
          ast->appearing = ASTEROID_INVISIBLE;
+         asteroid_gridUpdate( field, ast );
          return;
       }
 
       attempts++;
    } while ( (space_isInField(&ast->pos) < 0) && (attempts < 1000) );
+   asteroid_gridUpdate( field, ast );
 
    /* And a random velocity */
    theta = RNGF()*2.*M_PI;
@@ -1664,6 +1691,243 @@ void asteroid_init( Asteroid *ast, AsteroidAnchor *field )
 }
 
 
+/**
+ * @brief Sets up the spatial index of an asteroid field.
+ *
+ * Must be called once the asteroids are allocated and before they are
+ * initialized.
+ *
+ *    @param field Asteroid field to index.
+ */
+static void asteroid_gridCreate( AsteroidAnchor *field )
+{
+   int i, j;
+   AsteroidGrid *grid;
+   AsteroidType *at;
+   glTexture *gfx;
+
+   asteroid_gridFree( field );
+   grid = &field->grid;
+
+   /* Cover the field, asteroids drifting out end up in the border cells. */
+   grid->csize = MAX( ASTEROID_GRID_CELL, 2.*field->radius / ASTEROID_GRID_DIM );
+   grid->nx    = MIN( ASTEROID_GRID_DIM, (int)ceil( 2.*field->radius / grid->csize ) );
+   grid->nx    = MAX( grid->nx, 1 );
+   grid->ny    = grid->nx;
+   grid->x     = field->pos.x - grid->nx * grid->csize / 2.;
+   grid->y     = field->pos.y - grid->ny * grid->csize / 2.;
+
+   /* Largest asteroid graphic in the field. */
+   grid->margin = 0.;
+   for (i=0; i<field->ntype; i++) {
+      at = &asteroid_types[ field->type[i] ];
+      for (j=0; j<at->ngfx; j++) {
+         gfx = at->gfxs[j];
+         grid->margin = MAX( grid->margin, sqrt( pow2(gfx->sw) + pow2(gfx->sh) ) / 2. );
+      }
+   }
+
+   grid->head = malloc( grid->nx * grid->ny * sizeof(int) );
+   for (i=0; i<grid->nx*grid->ny; i++)
+      grid->head[i] = -1;
+   grid->next = malloc( field->nb * sizeof(int) );
+   grid->prev = malloc( field->nb * sizeof(int) );
+   grid->cell = malloc( field->nb * sizeof(int) );
+   for (i=0; i<field->nb; i++)
+      grid->cell[i] = -1;
+}
+
+
+/**
+ * @brief Frees the spatial index of an asteroid field.
+ *
+ *    @param field Asteroid field to free index of.
+ */
+static void asteroid_gridFree( AsteroidAnchor *field )
+{
+   AsteroidGrid *grid = &field->grid;
+   free( grid->head );
+   free( grid->next );
+   free( grid->prev );
+   free( grid->cell );
+   memset( grid, 0, sizeof(AsteroidGrid) );
+}
+
+
+/**
+ * @brief Gets the cell of an asteroid grid containing a point.
+ *
+ * Points outside of the grid are clamped to the border cells.
+ */
+static void asteroid_gridCell( const AsteroidGrid *grid, double x, double y, int *cx, int *cy )
+{
+   *cx = CLAMP( 0, grid->nx-1, (int)floor( (x - grid->x) / grid->csize ) );
+   *cy = CLAMP( 0, grid->ny-1, (int)floor( (y - grid->y) / grid->csize ) );
+}
+
+
+/**
+ * @brief Moves an asteroid to the grid cell matching its position.
+ *
+ *    @param field Asteroid field the asteroid belongs to.
+ *    @param a Asteroid that may have changed cell.
+ */
+static void asteroid_gridUpdate( AsteroidAnchor *field, Asteroid *a )
+{
+   int cx, cy, c, id;
+   AsteroidGrid *grid = &field->grid;
+
+   if (grid->head == NULL)
+      return;
+
+   id = a->id;
+   asteroid_gridCell( grid, a->pos.x, a->pos.y, &cx, &cy );
+   c = cy * grid->nx + cx;
+   if (grid->cell[id] == c)
+      return;
+
+   /* Unlink from the old cell. */
+   if (grid->cell[id] >= 0) {
+      if (grid->prev[id] >= 0)
+         grid->next[ grid->prev[id] ] = grid->next[id];
+      else
+         grid->head[ grid->cell[id] ] = grid->next[id];
+      if (grid->next[id] >= 0)
+         grid->prev[ grid->next[id] ] = grid->prev[id];
+   }
+
+   /* Link into the new cell. */
+   grid->cell[id] = c;
+   grid->prev[id] = -1;
+   grid->next[id] = grid->head[c];
+   if (grid->head[c] >= 0)
+      grid->prev[ grid->head[c] ] = id;
+   grid->head[c] = id;
+}
+
+
+/**
+ * @brief Compares two asteroid IDs (for use with qsort).
+ */
+static int asteroid_cmpID( const void *p1, const void *p2 )
+{
+   return *(const int*)p1 - *(const int*)p2;
+}
+
+
+/**
+ * @brief Gets the asteroids stored in the cells covering a box.
+ *
+ *    @param field Asteroid field to query.
+ *    @param x1 Left of the box.
+ *    @param y1 Bottom of the box.
+ *    @param x2 Right of the box.
+ *    @param y2 Top of the box.
+ *    @param[out] ids Array (array.h) of asteroid IDs, it is emptied first.
+ *    @return Number of asteroids found.
+ */
+static int asteroid_queryBox( const AsteroidAnchor *field, double x1, double y1,
+      double x2, double y2, int **ids )
+{
+   int cx1, cy1, cx2, cy2, cx, cy, id;
+   const AsteroidGrid *grid = &field->grid;
+
+   array_resize( ids, 0 );
+   if (grid->head == NULL)
+      return 0;
+
+   asteroid_gridCell( grid, x1 - grid->margin, y1 - grid->margin, &cx1, &cy1 );
+   asteroid_gridCell( grid, x2 + grid->margin, y2 + grid->margin, &cx2, &cy2 );
+   for (cy=cy1; cy<=cy2; cy++)
+      for (cx=cx1; cx<=cx2; cx++)
+         for (id=grid->head[ cy*grid->nx + cx ]; id>=0; id=grid->next[id])
+            array_push_back( ids, id );
+
+   return array_size(*ids);
+}
+
+
+/**
+ * @brief Gets the asteroids of a field that may be within a radius of a point.
+ *
+ * The asteroid graphics are taken into account, so this returns every
+ * asteroid that may touch the circle. Invisible asteroids are returned too.
+ *
+ *    @param field Asteroid field to query.
+ *    @param pos Centre of the circle.
+ *    @param r Radius of the circle.
+ *    @param[out] ids Array (array.h) of asteroid IDs sorted in ascending order.
+ *    @return Number of asteroids found.
+ */
+int asteroid_queryRadius( const AsteroidAnchor *field, const Vector2d *pos,
+      double r, int **ids )
+{
+   int i, n;
+   double d;
+   const Asteroid *a;
+
+   asteroid_queryBox( field, pos->x-r, pos->y-r, pos->x+r, pos->y+r, ids );
+
+   /* Remove the ones that are out of range. */
+   d = pow2( r + field->grid.margin );
+   n = 0;
+   for (i=0; i<array_size(*ids); i++) {
+      a = &field->asteroids[ (*ids)[i] ];
+      if (vect_dist2( &a->pos, pos ) <= d)
+         (*ids)[n++] = (*ids)[i];
+   }
+   array_resize( ids, n );
+
+   qsort( *ids, n, sizeof(int), asteroid_cmpID );
+   return n;
+}
+
+
+/**
+ * @brief Gets the asteroids of a field that may be near a segment.
+ *
+ * The asteroid graphics are taken into account, so this returns every
+ * asteroid that may touch the segment swept by a circle of radius r.
+ * Invisible asteroids are returned too.
+ *
+ *    @param field Asteroid field to query.
+ *    @param p1 Start of the segment.
+ *    @param p2 End of the segment.
+ *    @param r Radius around the segment.
+ *    @param[out] ids Array (array.h) of asteroid IDs sorted in ascending order.
+ *    @return Number of asteroids found.
+ */
+int asteroid_querySegment( const AsteroidAnchor *field, const Vector2d *p1,
+      const Vector2d *p2, double r, int **ids )
+{
+   int i, n;
+   double d, dx, dy, l2, t;
+   const Asteroid *a;
+
+   asteroid_queryBox( field, MIN(p1->x,p2->x)-r, MIN(p1->y,p2->y)-r,
+         MAX(p1->x,p2->x)+r, MAX(p1->y,p2->y)+r, ids );
+
+   /* Remove the ones that are too far from the segment. */
+   d  = pow2( r + field->grid.margin );
+   dx = p2->x - p1->x;
+   dy = p2->y - p1->y;
+   l2 = pow2(dx) + pow2(dy);
+   n  = 0;
+   for (i=0; i<array_size(*ids); i++) {
+      a = &field->asteroids[ (*ids)[i] ];
+      t = 0.;
+      if (l2 > 0.)
+         t = CLAMP( 0., 1., ((a->pos.x-p1->x)*dx + (a->pos.y-p1->y)*dy) / l2 );
+      if (pow2(p1->x + t*dx - a->pos.x) + pow2(p1->y + t*dy - a->pos.y) <= d)
+         (*ids)[n++] = (*ids)[i];
+   }
+   array_resize( ids, n );
+
+   qsort( *ids, n, sizeof(int), asteroid_cmpID );
+   return n;
+}
+
+
 /**
  * @brief Initializes a debris.
  *    @param deb Debris to initialize.
@@ -1713,6 +1977,33 @@ Planet *planet_new (void)
 }
 
 
+/**
+ * @brief Lists the files in a data directory with their full path.
+ *
+ * Keeps the order of PHYSFS_enumerateFiles so ids don't change.
+ *
+ *    @param path Directory to list, including the trailing slash.
+ *    @return The file paths (array.h), free them and the array when done.
+ */
+static char** space_listFiles( const char *path )
+{
+   char **list, **files, *file;
+   size_t i, len;
+
+   list  = PHYSFS_enumerateFiles( path );
+   files = array_create( char* );
+   for (i=0; list[i]!=NULL; i++) {
+      len  = strlen(path)+strlen(list[i])+2;
+      file = malloc( len );
+      nsnprintf( file, len, "%s%s", path, list[i] );
+      array_push_back( &files, file );
+   }
+   PHYSFS_freeList( list );
+
+   return files;
+}
+
+
 /**
  * @brief Loads all the planets in the game.
  *
@@ -1723,9 +2014,9 @@ static int planets_load ( void )
    size_t bufsize;
    char *buf, **planet_files, *file;
    xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlDocPtr doc, *planet_docs;
    Planet *p;
-   size_t i, len;
+   int i;
    Commodity **stdList;
    unsigned int stdNb;
 
@@ -1748,13 +2039,13 @@ static int planets_load ( void )
    /* Extract the list of standard commodities. */
    stdList = standard_commodities( &stdNb );
 
-   /* Load XML stuff. */
-   planet_files = PHYSFS_enumerateFiles( PLANET_DATA_PATH );
-   for (i=0; planet_files[i]!=NULL; i++) {
-      len  = (strlen(PLANET_DATA_PATH)+strlen(planet_files[i])+2);
-      file = malloc( len );
-      nsnprintf( file, len,"%s%s",PLANET_DATA_PATH,planet_files[i]);
-      doc = xml_parsePhysFS( file );
+   /* Load XML stuff, reading and parsing in parallel. */
+   space_prefetch();
+   planet_docs    = xml_parsePhysFSFinish( planet_parsing, &planet_files );
+   planet_parsing = NULL;
+   for (i=0; i<array_size(planet_files); i++) {
+      file = planet_files[i];
+      doc  = planet_docs[i];
       if (doc == NULL) {
          free(file);
          continue;
@@ -1779,7 +2070,8 @@ static int planets_load ( void )
    }
 
    /* Clean up. */
-   PHYSFS_freeList( planet_files );
+   array_free( planet_files );
+   array_free( planet_docs );
    free(stdList);
 
    return 0;
@@ -1934,7 +2226,7 @@ void planet_gfxLoad( Planet *planet )
       return;
 
    if (planet->gfx_space == NULL) {
-      planet->gfx_space = gl_newImage( planet->gfx_spaceName, OPENGL_TEX_MIPMAPS );
+      planet->gfx_space = gl_newImage( planet->gfx_spaceName, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ASYNC );
       planet->radius = (planet->gfx_space->w + planet->gfx_space->h)/4.;
    }
 }
@@ -2221,6 +2513,13 @@ static int planet_parse( Planet *planet, const xmlNodePtr parent, Commodity **st
             planet->ncommodities * sizeof(Commodity*));
       planet->commodityPrice = realloc(planet->commodityPrice,
             planet->ncommodities * sizeof(CommodityPrice));
+
+      /* Index them by commodity so lookups don't have to search. */
+      planet->commodityIndex = malloc( array_size(commodity_stack) * sizeof(int) );
+      for (i=0; i<array_size(commodity_stack); i++)
+         planet->commodityIndex[i] = -1;
+      for (i=0; i<planet->ncommodities; i++)
+         planet->commodityIndex[ planet->commodities[i] - commodity_stack ] = i;
    }
    /* Free temporary comms list. */
    free(comms);
@@ -2270,6 +2569,7 @@ int system_addPlanet( StarSystem *sys, const char *planetname )
    sn = &array_grow( &systemname_stack );
    *pn = planet->name;
    *sn = sys->name;
+   nhash_add( &planetname_index, planet->name, array_size(planetname_stack)-1 );
 
    economy_addQueuedUpdate();
    /* This is required to clear the player statistics for this planet */
@@ -2332,6 +2632,7 @@ int system_rmPlanet( StarSystem *sys, const char *planetname )
       if (strcmp(planetname, planetname_stack[i])==0) {
          array_erase( &planetname_stack, &planetname_stack[i], &planetname_stack[i+1] );
          array_erase( &systemname_stack, &systemname_stack[i], &systemname_stack[i+1] );
+         planetname_reindex();
          found = 1;
          break;
       }
@@ -2420,6 +2721,10 @@ int system_rmJump( StarSystem *sys, const char *jumpname )
    /* Remove jump from system. */
    sys->njumps--;
 
+   /* The jump graph and all cached jump distances no longer match, unidiffs
+    * remove jumps here without going through systems_reconstructJumps(). */
+   map_invalidateJumpGraph();
+
    /* Refresh presence */
    system_setFaction(sys);
 
@@ -2480,6 +2785,9 @@ void system_reconstructJumps (StarSystem *sys)
    JumpPoint *jp;
    double a;
 
+   /* The pathfinding graph has to be rebuilt. */
+   map_invalidateJumpGraph();
+
    for (j=0; j<sys->njumps; j++) {
       jp             = &sys->jumps[j];
       jp->from       = sys;
@@ -2520,6 +2828,9 @@ void systems_reconstructJumps (void)
       sys = &systems_stack[i];
       system_reconstructJumps(sys);
    }
+
+   /* The economy has to refactorize its admittance matrix. */
+   economy_topologyChanged();
 }
 
 
@@ -2539,6 +2850,51 @@ void systems_reconstructPlanets (void)
 }
 
 
+/**
+ * @brief Rebuilds the system and planet name indices, needed after renaming.
+ */
+void systems_reconstructNames (void)
+{
+   nhash_clear( &system_names );
+   nhash_clear( &planet_names );
+   system_nindexed = 0;
+   planet_nindexed = 0;
+   planetname_reindex();
+}
+
+
+/**
+ * @brief Adds the systems and planets created since the last lookup to the
+ *        name indices.
+ */
+static void space_indexNames (void)
+{
+   while ((system_nindexed < array_size(systems_stack)) &&
+         (systems_stack[system_nindexed].name != NULL)) {
+      nhash_add( &system_names, systems_stack[system_nindexed].name, system_nindexed );
+      system_nindexed++;
+   }
+   while ((planet_nindexed < array_size(planet_stack)) &&
+         (planet_stack[planet_nindexed].name != NULL)) {
+      nhash_add( &planet_names, planet_stack[planet_nindexed].name, planet_nindexed );
+      planet_nindexed++;
+   }
+}
+
+
+/**
+ * @brief Rebuilds the name index of the planet <-> system name stack.
+ */
+static void planetname_reindex (void)
+{
+   int i;
+
+   nhash_clear( &planetname_index );
+   for (i=0; i<array_size(planetname_stack); i++)
+      nhash_add( &planetname_index, planetname_stack[i], i );
+}
+
+
 /**
  * @brief Creates a system from an XML node.
  *
@@ -2886,13 +3242,9 @@ static void system_parseJumps( const xmlNodePtr parent )
    xmlNodePtr cur, node;
 
    xmlr_attr_strd( parent, "name", name );
-   sys = NULL;
-   for (i=0; i<array_size(systems_stack); i++) {
-      if (strcmp( systems_stack[i].name, name)==0) {
-         sys = &systems_stack[i];
-         break;
-      }
-   }
+   space_indexNames();
+   i   = nhash_get( &system_names, name );
+   sys = (i >= 0) ? &systems_stack[i] : NULL;
    if (sys == NULL) {
       WARN(_("System '%s' was not found in the stack for some reason"),name);
       return;
@@ -3085,6 +3437,25 @@ static void system_parseAsteroids( const xmlNodePtr parent, StarSystem *sys )
 }
 
 
+/**
+ * @brief Starts reading and parsing the asset and star system files in the
+ *        background.
+ *
+ * Called before the stages space_load depends on, so the files are parsed
+ * while they load.
+ *
+ *    @return 0 on success.
+ */
+int space_prefetch (void)
+{
+   if (planet_parsing == NULL)
+      planet_parsing = xml_parsePhysFSStart( space_listFiles( PLANET_DATA_PATH ) );
+   if (system_parsing == NULL)
+      system_parsing = xml_parsePhysFSStart( space_listFiles( SYSTEM_DATA_PATH ) );
+   return 0;
+}
+
+
 /**
  * @brief Loads the entire universe into ram - pretty big feat eh?
  *
@@ -3132,7 +3503,7 @@ int space_load (void)
    for (i=0; asteroid_files[i]!=NULL; i++) {
       len  = (strlen(PLANET_GFX_SPACE_PATH)+strlen(asteroid_files[i])+11);
       nsnprintf( file, len,"%s%s",PLANET_GFX_SPACE_PATH"asteroid/",asteroid_files[i] );
-      asteroid_gfx[i] = gl_newImage( file, OPENGL_TEX_MIPMAPS );
+      asteroid_gfx[i] = gl_newImage( file, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ASYNC );
    }
 
    /* Done loading. */
@@ -3291,77 +3662,61 @@ static int asteroidTypes_load (void)
  */
 static int systems_load (void)
 {
-   char **system_files, *file;
+   char **system_files;
    xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlDocPtr *system_docs;
    StarSystem *sys;
-   size_t i, len;
+   int i;
 
    /* Allocate if needed. */
    if (systems_stack == NULL)
       systems_stack = array_create( StarSystem );
 
-   system_files = PHYSFS_enumerateFiles( SYSTEM_DATA_PATH );
+   /* Read and parse in parallel, the documents are used by both passes. */
+   space_prefetch();
+   system_docs    = xml_parsePhysFSFinish( system_parsing, &system_files );
+   system_parsing = NULL;
 
    /*
     * First pass - loads all the star systems_stack.
     */
-   for (i=0; system_files[i]!=NULL; i++) {
-      len  = strlen(SYSTEM_DATA_PATH)+strlen(system_files[i])+2;
-      file = malloc( len );
-      nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      doc = xml_parsePhysFS( file );
-      if (doc == NULL)
+   for (i=0; i<array_size(system_files); i++) {
+      if (system_docs[i] == NULL)
          continue;
 
-      node = doc->xmlChildrenNode; /* first planet node */
+      node = system_docs[i]->xmlChildrenNode; /* first planet node */
       if (node == NULL) {
-         WARN(_("Malformed %s file: does not contain elements"),file);
-         xmlFreeDoc(doc);
+         WARN(_("Malformed %s file: does not contain elements"),system_files[i]);
+         xmlFreeDoc(system_docs[i]);
+         system_docs[i] = NULL;
          continue;
       }
 
       sys = system_new();
       system_parse( sys, node );
       system_parseAsteroids(node, sys); /* load the asteroids anchors */
-
-      /* Clean up. */
-      xmlFreeDoc(doc);
-      free( file );
    }
 
    /*
     * Second pass - loads all the jump routes.
     */
-   for (i=0; system_files[i]!=NULL; i++) {
-      len  = strlen(SYSTEM_DATA_PATH)+strlen(system_files[i])+2;
-      file = malloc( len );
-      nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      doc = xml_parsePhysFS( file );
-      free( file );
-      file = NULL;
-      if (doc == NULL)
-         continue;
+   for (i=0; i<array_size(system_files); i++) {
+      if (system_docs[i] != NULL) {
+         node = system_docs[i]->xmlChildrenNode; /* first planet node */
+         system_parseJumps(node); /* will automatically load the jumps into the system */
 
-      node = doc->xmlChildrenNode; /* first planet node */
-      if (node == NULL) {
-         xmlFreeDoc(doc);
-         continue;
+         /* Clean up. */
+         xmlFreeDoc(system_docs[i]);
       }
-
-      system_parseJumps(node); /* will automatically load the jumps into the system */
-
-      /* Clean up. */
-      xmlFreeDoc(doc);
+      free( system_files[i] );
    }
 
    DEBUG( n_( "Loaded %d Star System", "Loaded %d Star Systems", array_size(systems_stack) ), array_size(systems_stack) );
    DEBUG( n_( "       with %d Planet", "       with %d Planets", array_size(planet_stack) ), array_size(planet_stack) );
 
    /* Clean up. */
-   PHYSFS_freeList( system_files );
+   array_free( system_files );
+   array_free( system_docs );
 
    return 0;
 }
@@ -3404,6 +3759,7 @@ void space_renderOverlay( const double dt )
    pplayer = pilot_get( PLAYER_ID );
    if (pplayer != NULL) {
       psolid  = pplayer->solid;
+      gl_batchBegin();
       for (i=0; i < cur_system->nasteroids; i++) {
          ast = &cur_system->asteroids[i];
          x = psolid->pos.x - SCREEN_W/2;
@@ -3413,6 +3769,7 @@ void space_renderOverlay( const double dt )
               space_renderDebris( &ast->debris[j], x, y );
          }
       }
+      gl_batchEnd();
    }
 
    if ((cur_system->nebu_density > 0.) &&
@@ -3436,6 +3793,8 @@ void planets_render (void)
    if (cur_system==NULL)
       return;
 
+   gl_batchBegin();
+
    /* Render the jumps. */
    for (i=0; i < cur_system->njumps; i++)
       space_renderJumpPoint( &cur_system->jumps[i], i );
@@ -3469,6 +3828,7 @@ void planets_render (void)
    /* Render gatherable stuff. */
    gatherable_render();
 
+   gl_batchEnd();
 }
 
 
@@ -3595,6 +3955,11 @@ void space_exit (void)
    /* Free the names. */
    array_free(planetname_stack);
    array_free(systemname_stack);
+   nhash_free(&planetname_index);
+   nhash_free(&system_names);
+   nhash_free(&planet_names);
+   system_nindexed = 0;
+   planet_nindexed = 0;
 
    /* Free the planets. */
    for (i=0; i < array_size(planet_stack); i++) {
@@ -3629,6 +3994,7 @@ void space_exit (void)
       /* commodities */
       free(pnt->commodities);
       free(pnt->commodityPrice);
+      free(pnt->commodityIndex);
    }
    array_free(planet_stack);
 
@@ -3649,6 +4015,7 @@ void space_exit (void)
          free(ast->asteroids);
          free(ast->debris);
          free(ast->type);
+         asteroid_gridFree( ast );
       }
       free(sys->asteroids);
       free(sys->astexclude);
@@ -3697,6 +4064,7 @@ void space_clearKnown (void)
    }
    for (j=0; j<array_size(planet_stack); j++)
       planet_rmFlag(&planet_stack[j],PLANET_KNOWN);
+   map_invalidateJumpDist();
 }
 
 
@@ -3897,6 +4265,7 @@ int space_sysLoad( xmlNodePtr parent )
       }
    } while (xml_nextNode(node));
 
+   map_invalidateJumpDist();
    return 0;
 }
 
@@ -4160,14 +4529,14 @@ int space_isInField ( Vector2d *p )
    /* Always return -1 if in an exclusion zone */
    for (i=0; i < cur_system->nastexclude; i++) {
       e = &cur_system->astexclude[i];
-      if (vect_dist( p, &e->pos ) <= e->radius)
+      if (vect_dist2( p, &e->pos ) <= pow2(e->radius))
          return -1;
    }
 
    /* Check if in asteroid field */
    for (i=0; i < cur_system->nasteroids; i++) {
       a = &cur_system->asteroids[i];
-      if (vect_dist( p, &a->pos ) <= a->radius)
+      if (vect_dist2( p, &a->pos ) <= pow2(a->radius))
          return i;
    }
 
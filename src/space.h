@@ -121,6 +121,7 @@ typedef struct Planet_ {
    Commodity **commodities; /**< what commodities they sell */
    CommodityPrice *commodityPrice; /**< the base cost of a commodity on this planet */
    int ncommodities; /**< the amount they have */
+   int *commodityIndex; /**< Position in commodities of each commodity by stack index, -1 if not sold. */
    tech_group_t *tech; /**< Planet tech. */
 
    /* Graphics. */
@@ -251,6 +252,26 @@ extern glTexture **asteroid_gfx; /**< Asteroid graphics list. */
 
 
 
+/**
+ * @brief Coarse grid over the asteroids of a field, used for spatial queries.
+ *
+ * Each cell holds a doubly linked list of asteroid IDs. Asteroids outside of
+ * the grid are stored in the border cells.
+ */
+typedef struct AsteroidGrid_ {
+   double x; /**< Left of the grid. */
+   double y; /**< Bottom of the grid. */
+   double csize; /**< Size of a cell. */
+   int nx; /**< Number of cells on the x axis. */
+   int ny; /**< Number of cells on the y axis. */
+   int *head; /**< First asteroid of each cell, -1 if empty. */
+   int *next; /**< Next asteroid in the same cell, -1 if last. */
+   int *prev; /**< Previous asteroid in the same cell, -1 if first. */
+   int *cell; /**< Cell each asteroid is stored in. */
+   double margin; /**< Largest distance from the centre of an asteroid to its edge. */
+} AsteroidGrid;
+
+
 /**
  * @brief Represents an asteroid field anchor.
  */
@@ -266,6 +287,7 @@ typedef struct AsteroidAnchor_ {
    double area; /**< Field's area. */
    int *type; /**< Types of asteroids. */
    int ntype; /**< Number of types. */
+   AsteroidGrid grid; /**< Spatial index of the asteroids. */
 } AsteroidAnchor;
 
 
@@ -328,8 +350,8 @@ struct StarSystem_ {
    int markers_plot; /**< Number of plot level mission markers. */
 
    /* Economy. */
-   CommodityPrice *averagePrice;
-   int ncommodities;
+   CommodityPrice *averagePrice; /**< Average prices by commodity stack index, only during setup. */
+   int ncommodities; /**< Size of averagePrice. */
 
    /* Misc. */
    unsigned int flags; /**< flags for system properties */
@@ -344,6 +366,7 @@ extern int space_spawn; /**< 1 if spawning is enabled. */
  * loading/exiting
  */
 void space_init( const char* sysname );
+int space_prefetch (void);
 int space_load (void);
 void space_exit (void);
 
@@ -367,6 +390,7 @@ int planet_getService( char *name );
 credits_t planet_commodityPrice( const Planet *p, const Commodity *c );
 credits_t planet_commodityPriceAtTime( const Planet *p, const Commodity *c, ntime_t t );
 int planet_averagePlanetPrice( const Planet *p, const Commodity *c, credits_t *mean, double *std);
+int planet_commodityIndex( const Planet *p, const Commodity *c );
 void planet_averageSeenPricesAtTime( const Planet *p, const ntime_t tupdate );
 /* Misc modification. */
 int planet_setFaction( Planet *p, int faction );
@@ -390,6 +414,7 @@ const char *jump_getSymbol( JumpPoint *jp );
 void system_reconstructJumps (StarSystem *sys);
 void systems_reconstructJumps (void);
 void systems_reconstructPlanets (void);
+void systems_reconstructNames (void);
 StarSystem *system_new (void);
 int system_addPlanet( StarSystem *sys, const char *planetname );
 int system_rmPlanet( StarSystem *sys, const char *planetname );
@@ -468,6 +493,10 @@ int space_calcJumpInPos( StarSystem *in, StarSystem *out, Vector2d *pos, Vector2
  * Asteroids
  */
 void asteroid_hit( Asteroid *a, const Damage *dmg );
+int asteroid_queryRadius( const AsteroidAnchor *field, const Vector2d *pos,
+      double r, int **ids );
+int asteroid_querySegment( const AsteroidAnchor *field, const Vector2d *p1,
+      const Vector2d *p2, double r, int **ids );
 int space_isInField ( Vector2d *p );
 AsteroidType *space_getType ( int ID );
 
@@ -20,6 +20,7 @@
 #include "spfx.h"
 
 #include "array.h"
+#include "conf.h"
 #include "debris.h"
 #include "log.h"
 #include "ndata.h"
@@ -35,8 +36,7 @@
 #define SPFX_XML_ID     "spfxs" /**< XML Document tag. */
 #define SPFX_XML_TAG    "spfx" /**< SPFX XML node tag. */
 
-#define SPFX_CHUNK_MAX  16384 /**< Maximum chunk to alloc when needed */
-#define SPFX_CHUNK_MIN  256 /**< Minimum chunk to alloc when needed */
+#define SPFX_MAX_MIN    64 /**< Minimum amount of effects per layer. */
 
 #define SHAKE_MASS      (1./400.) /** Shake mass. */
 #define SHAKE_K         (1./50.) /**< Constant for virtual spring. */
@@ -78,30 +78,36 @@ typedef struct SPFX_Base_ {
    double anim; /**< Total duration in ms */
 
    glTexture *gfx; /**< will use each sprite as a frame */
+   double priority; /**< Bigger effects are more noticeable, so they're kept over smaller ones. */
 } SPFX_Base;
 
 static SPFX_Base *spfx_effects = NULL; /**< Total special effects. */
 
 
 /**
- * @struct SPFX
+ * @struct SPFX_Layer
  *
- * @brief An actual in-game active special effect.
+ * @brief Fixed size pool of in-game active special effects.
+ *
+ * Stored as separate arrays so the update loops run over contiguous data,
+ * the first n entries of each array are alive.
  */
-typedef struct SPFX_ {
-   Vector2d pos; /**< Current position. */
-   Vector2d vel; /**< Current velocity. */
-
-   int lastframe; /**< Needed when paused */
-   int effect; /**< The real effect */
-
-   double timer; /**< Time left */
-} SPFX;
+typedef struct SPFX_Layer_ {
+   int n; /**< Number of active effects. */
+   int max; /**< Capacity of the pool. */
+   double *px; /**< Current X positions. */
+   double *py; /**< Current Y positions. */
+   double *vx; /**< Current X velocities. */
+   double *vy; /**< Current Y velocities. */
+   double *timer; /**< Time left. */
+   int *effect; /**< The real effects. */
+   int *lastframe; /**< Needed when paused */
+} SPFX_Layer;
 
 
 /* front stack is for effects on player, back is for the rest */
-static SPFX *spfx_stack_front = NULL; /**< Frontal special effect layer. */
-static SPFX *spfx_stack_back = NULL; /**< Back special effect layer. */
+static SPFX_Layer spfx_stack_front; /**< Frontal special effect layer. */
+static SPFX_Layer spfx_stack_back; /**< Back special effect layer. */
 
 
 /*
@@ -110,7 +116,10 @@ static SPFX *spfx_stack_back = NULL; /**< Back special effect layer. */
 /* General. */
 static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent );
 static void spfx_base_free( SPFX_Base *effect );
-static void spfx_update_layer( SPFX *layer, const double dt );
+static void spfx_layerInit( SPFX_Layer *layer, int max );
+static void spfx_layerFree( SPFX_Layer *layer );
+static void spfx_layerRemove( SPFX_Layer *layer, int i );
+static void spfx_update_layer( SPFX_Layer *layer, const double dt );
 /* Haptic. */
 static int spfx_hapticInit (void);
 static void spfx_hapticRumble( double mod );
@@ -140,7 +149,7 @@ static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent )
       xmlr_float(node, "ttl", temp->ttl);
       if (xml_isNode(node,"gfx")) {
          temp->gfx = xml_parseTexture( node,
-               SPFX_GFX_PATH"%s", 6, 5, 0 );
+               SPFX_GFX_PATH"%s", 6, 5, OPENGL_TEX_ATLAS );
          continue;
       }
       WARN(_("SPFX '%s' has unknown node '%s'."), temp->name, node->name);
@@ -159,6 +168,9 @@ static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent )
    MELEMENT(temp->gfx==NULL,"gfx");
 #undef MELEMENT
 
+   if (temp->gfx != NULL)
+      temp->priority = temp->gfx->sw * temp->gfx->sh;
+
    return 0;
 }
 
@@ -248,8 +260,8 @@ int spfx_load (void)
    shake_noise = noise_new( 1, NOISE_DEFAULT_HURST, NOISE_DEFAULT_LACUNARITY );
 
    /* Stacks. */
-   spfx_stack_front = array_create( SPFX );
-   spfx_stack_back = array_create( SPFX );
+   spfx_layerInit( &spfx_stack_front, conf.spfx_max );
+   spfx_layerInit( &spfx_stack_back, conf.spfx_max );
 
    return 0;
 }
@@ -267,10 +279,8 @@ void spfx_free (void)
 
    /* get rid of all the particles and free the stacks */
    spfx_clear();
-   array_free(spfx_stack_front);
-   spfx_stack_front = NULL;
-   array_free(spfx_stack_back);
-   spfx_stack_back = NULL;
+   spfx_layerFree( &spfx_stack_front );
+   spfx_layerFree( &spfx_stack_back );
 
    /* now clear the effects */
    for (i=0; i<array_size(spfx_effects); i++)
@@ -283,9 +293,69 @@ void spfx_free (void)
 }
 
 
+/**
+ * @brief Allocates a special effect layer.
+ *
+ *    @param layer Layer to initialize.
+ *    @param max Maximum amount of effects it can hold.
+ */
+static void spfx_layerInit( SPFX_Layer *layer, int max )
+{
+   layer->n         = 0;
+   layer->max       = MAX( max, SPFX_MAX_MIN );
+   layer->px        = malloc( layer->max * sizeof(double) );
+   layer->py        = malloc( layer->max * sizeof(double) );
+   layer->vx        = malloc( layer->max * sizeof(double) );
+   layer->vy        = malloc( layer->max * sizeof(double) );
+   layer->timer     = malloc( layer->max * sizeof(double) );
+   layer->effect    = malloc( layer->max * sizeof(int) );
+   layer->lastframe = malloc( layer->max * sizeof(int) );
+}
+
+
+/**
+ * @brief Frees a special effect layer.
+ *
+ *    @param layer Layer to free.
+ */
+static void spfx_layerFree( SPFX_Layer *layer )
+{
+   free( layer->px );
+   free( layer->py );
+   free( layer->vx );
+   free( layer->vy );
+   free( layer->timer );
+   free( layer->effect );
+   free( layer->lastframe );
+   memset( layer, 0, sizeof(SPFX_Layer) );
+}
+
+
+/**
+ * @brief Removes an effect, keeping the others in the order they're drawn.
+ *
+ *    @param layer Layer to remove from.
+ *    @param i Index of the effect to remove.
+ */
+static void spfx_layerRemove( SPFX_Layer *layer, int i )
+{
+   int n = --layer->n - i;
+   memmove( &layer->px[i], &layer->px[i+1], n*sizeof(double) );
+   memmove( &layer->py[i], &layer->py[i+1], n*sizeof(double) );
+   memmove( &layer->vx[i], &layer->vx[i+1], n*sizeof(double) );
+   memmove( &layer->vy[i], &layer->vy[i+1], n*sizeof(double) );
+   memmove( &layer->timer[i], &layer->timer[i+1], n*sizeof(double) );
+   memmove( &layer->effect[i], &layer->effect[i+1], n*sizeof(int) );
+   memmove( &layer->lastframe[i], &layer->lastframe[i+1], n*sizeof(int) );
+}
+
+
 /**
  * @brief Creates a new special effect.
  *
+ * When the layer is full the least noticeable effect (smallest, then
+ * closest to dying) gets dropped, which may be the new effect itself.
+ *
  *    @param effect Base effect identifier to use.
  *    @param px X position of the effect.
  *    @param py Y position of the effect.
@@ -298,10 +368,11 @@ void spfx_add( int effect,
       const double vx, const double vy,
       const int layer )
 {
-   SPFX *cur_spfx;
-   double ttl, anim;
+   SPFX_Layer *l;
+   double ttl, anim, timer, prio, p, t;
+   int i, j;
 
-   if ((effect < 0) || (effect > array_size(spfx_effects))) {
+   if ((effect < 0) || (effect >= array_size(spfx_effects))) {
       WARN(_("Trying to add spfx with invalid effect!"));
       return;
    }
@@ -310,25 +381,49 @@ void spfx_add( int effect,
     * Select the Layer
     */
    if (layer == SPFX_LAYER_FRONT) /* front layer */
-      cur_spfx = &array_grow( &spfx_stack_front );
+      l = &spfx_stack_front;
    else if (layer == SPFX_LAYER_BACK) /* back layer */
-      cur_spfx = &array_grow( &spfx_stack_back );
+      l = &spfx_stack_back;
    else {
       WARN(_("Invalid SPFX layer."));
       return;
    }
 
-   /* The actual adding of the spfx */
-   cur_spfx->effect = effect;
-   vect_csetmin( &cur_spfx->pos, px, py );
-   vect_csetmin( &cur_spfx->vel, vx, vy );
    /* Timer magic if ttl != anim */
    ttl = spfx_effects[effect].ttl;
    anim = spfx_effects[effect].anim;
    if (ttl != anim)
-      cur_spfx->timer = ttl + RNGF()*anim;
+      timer = ttl + RNGF()*anim;
    else
-      cur_spfx->timer = ttl;
+      timer = ttl;
+
+   /* Over budget, drop the least important effect. */
+   if (l->n >= l->max) {
+      prio = spfx_effects[effect].priority;
+      t    = timer;
+      j    = -1;
+      for (i=0; i<l->n; i++) {
+         p = spfx_effects[ l->effect[i] ].priority;
+         if ((p < prio) || ((p == prio) && (l->timer[i] < t))) {
+            prio = p;
+            t    = l->timer[i];
+            j    = i;
+         }
+      }
+      if (j < 0)
+         return;
+      spfx_layerRemove( l, j );
+   }
+
+   /* The actual adding of the spfx */
+   i = l->n++;
+   l->effect[i]    = effect;
+   l->px[i]        = px;
+   l->py[i]        = py;
+   l->vx[i]        = vx;
+   l->vy[i]        = vy;
+   l->timer[i]     = timer;
+   l->lastframe[i] = 0;
 }
 
 
@@ -353,8 +448,8 @@ void spfx_clear (void)
  */
 void spfx_update( const double dt )
 {
-   spfx_update_layer( spfx_stack_front, dt );
-   spfx_update_layer( spfx_stack_back, dt );
+   spfx_update_layer( &spfx_stack_front, dt );
+   spfx_update_layer( &spfx_stack_back, dt );
 }
 
 
@@ -364,23 +459,41 @@ void spfx_update( const double dt )
  *    @param layer Layer the spfx is on.
  *    @param dt Current delta tick.
  */
-static void spfx_update_layer( SPFX *layer, const double dt )
+static void spfx_update_layer( SPFX_Layer *layer, const double dt )
 {
-   int i;
-
-   for (i=0; i<array_size(layer); i++) {
-      layer[i].timer -= dt; /* less time to live */
+   int i, j, n;
+   double *px, *py, *vx, *vy, *timer;
+
+   /* Straight loops over the arrays so the compiler can vectorize them. */
+   n     = layer->n;
+   px    = layer->px;
+   py    = layer->py;
+   vx    = layer->vx;
+   vy    = layer->vy;
+   timer = layer->timer;
+   for (i=0; i<n; i++) {
+      timer[i] -= dt; /* less time to live */
+      px[i]    += dt*vx[i];
+      py[i]    += dt*vy[i];
+   }
 
-      /* time to die! */
-      if (layer[i].timer < 0.) {
-         array_erase( &layer, &layer[i], &layer[i+1] );
-         i--;
+   /* time to die! Compact the survivors so the draw order is kept. */
+   j = 0;
+   for (i=0; i<n; i++) {
+      if (timer[i] < 0.)
          continue;
+      if (i != j) {
+         px[j]                = px[i];
+         py[j]                = py[i];
+         vx[j]                = vx[i];
+         vy[j]                = vy[i];
+         timer[j]             = timer[i];
+         layer->effect[j]     = layer->effect[i];
+         layer->lastframe[j]  = layer->lastframe[i];
       }
-
-      /* actually update it */
-      vect_cadd( &layer[i].pos, dt*VX(layer[i].vel), dt*VY(layer[i].vel) );
+      j++;
    }
+   layer->n = j;
 }
 
 
@@ -628,7 +741,7 @@ void spfx_cinematic (void)
  */
 void spfx_render( const int layer )
 {
-   SPFX *spfx_stack;
+   SPFX_Layer *spfx_stack;
    int i;
    SPFX_Base *effect;
    int sx, sy;
@@ -638,11 +751,11 @@ void spfx_render( const int layer )
    /* get the appropriate layer */
    switch (layer) {
       case SPFX_LAYER_FRONT:
-         spfx_stack = spfx_stack_front;
+         spfx_stack = &spfx_stack_front;
          break;
 
       case SPFX_LAYER_BACK:
-         spfx_stack = spfx_stack_back;
+         spfx_stack = &spfx_stack_back;
          break;
 
       default:
@@ -651,24 +764,26 @@ void spfx_render( const int layer )
    }
 
    /* Now render the layer */
-   for (i=array_size(spfx_stack)-1; i>=0; i--) {
-      effect = &spfx_effects[ spfx_stack[i].effect ];
+   gl_batchBegin();
+   for (i=spfx_stack->n-1; i>=0; i--) {
+      effect = &spfx_effects[ spfx_stack->effect[i] ];
 
       /* Simplifies */
       sx = (int)effect->gfx->sx;
       sy = (int)effect->gfx->sy;
 
       if (!paused) { /* don't calculate frame if paused */
-         time = 1. - fmod(spfx_stack[i].timer,effect->anim) / effect->anim;
-         spfx_stack[i].lastframe = sx * sy * MIN(time, 1.);
+         time = 1. - fmod(spfx_stack->timer[i],effect->anim) / effect->anim;
+         spfx_stack->lastframe[i] = sx * sy * MIN(time, 1.);
       }
 
       /* Renders */
       gl_blitSprite( effect->gfx,
-            VX(spfx_stack[i].pos), VY(spfx_stack[i].pos),
-            spfx_stack[i].lastframe % sx,
-            spfx_stack[i].lastframe / sx,
+            spfx_stack->px[i], spfx_stack->py[i],
+            spfx_stack->lastframe[i] % sx,
+            spfx_stack->lastframe[i] / sx,
             NULL );
    }
+   gl_batchEnd();
 }
 
@@ -13,6 +13,7 @@
 
 
 /** @cond */
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 
@@ -37,9 +38,18 @@
 
 
 #define weapon_isSmart(w)     (w->think != NULL) /**< Checks if the weapon w is smart. */
+#define weapon_store(l)       (((l)==WEAPON_LAYER_BG) ? &wbackLayer : &wfrontLayer) /**< Gets the store of layer l. */
+#define weapon_timer(w)       (weapon_store((w)->layer)->timer[(w)->idx]) /**< Remaining life of weapon w. */
+#define weapon_falloff(w)     (weapon_store((w)->layer)->falloff[(w)->idx]) /**< Falloff point of weapon w. */
+#define weapon_strength(w)    (weapon_store((w)->layer)->strength[(w)->idx]) /**< Falloff strength of weapon w. */
 
 #define WEAPON_CHUNK_MAX      16384 /**< Maximum size to increase array with */
 #define WEAPON_CHUNK_MIN      256 /**< Minimum size to increase array with */
+#define WEAPON_POOL_CHUNK     256 /**< Weapons allocated at once by the pool. */
+
+#define WEAPON_GRID_CELL      256. /**< Minimum size of a collision grid cell. */
+#define WEAPON_GRID_DIM       64 /**< Maximum number of collision grid cells per axis. */
+#define WEAPON_GRID_MARGIN    2. /**< Extra margin to cover integer rounding in the collision code. */
 
 /* Weapon status */
 #define WEAPON_STATUS_OK         0 /**< Weapon is fine */
@@ -59,7 +69,10 @@ extern Pilot** pilot_stack;
  * @brief In-game representation of a weapon.
  */
 typedef struct Weapon_ {
-   Solid *solid; /**< Actually has its own solid :) */
+   Solid *solid; /**< Points into the solids of the layer store, moves with Weapon::idx. */
+   int idx; /**< Index in the layer store. */
+   WeaponLayer layer; /**< Layer the weapon is in. */
+   struct Weapon_ *next_free; /**< Next weapon in the pool free list. */
    unsigned int ID; /**< Only used for beam weapons. */
 
    int faction; /**< faction of pilot that shot it */
@@ -73,12 +86,9 @@ typedef struct Weapon_ {
    int voice; /**< Weapon's voice. */
    double exp_timer; /**< Explosion timer for beams. */
    double life; /**< Total life. */
-   double timer; /**< mainly used to see when the weapon was fired */
    double anim; /**< Used for beam weapon graphics and others. */
    int sprite; /**< Used for spinning outfits. */
    PilotOutfitSlot *mount; /**< Used for beam weapons. */
-   double falloff; /**< Point at which damage falls off. */
-   double strength; /**< Calculated with falloff. */
    int sx; /**< Current X sprite to use. */
    int sy; /**< Current Y sprite to use. */
 
@@ -90,10 +100,32 @@ typedef struct Weapon_ {
 } Weapon;
 
 
+/**
+ * @brief Packed storage of a weapon layer.
+ *
+ * The hot per-frame data lives in parallel arrays indexed by Weapon::idx so
+ * the timer pass and the physics run over contiguous memory. Weapons
+ * destroyed while the layer updates are left as NULL and compacted in one
+ * pass at the end, so the order is kept.
+ */
+typedef struct WeaponStore_ {
+   Weapon **w; /**< Weapons in update and render order, NULL if destroyed during the update (array.h). */
+   Solid *solid; /**< Position, velocity and the rest of the physics (array.h). */
+   double *timer; /**< Remaining life, mainly used to see when the weapon was fired (array.h). */
+   double *falloff; /**< Point at which damage falls off (array.h). */
+   double *strength; /**< Calculated with falloff (array.h). */
+   int updating; /**< Whether weapons_updateLayer is going through the store. */
+   int dead; /**< Weapons destroyed during the update, not compacted yet. */
+} WeaponStore;
+
 /* behind player layer */
-static Weapon** wbackLayer = NULL; /**< behind pilots */
+static WeaponStore wbackLayer; /**< behind pilots */
 /* behind player layer */
-static Weapon** wfrontLayer = NULL; /**< in front of pilots, behind player */
+static WeaponStore wfrontLayer; /**< in front of pilots, behind player */
+
+/* Weapon pool. */
+static Weapon **weapon_pool = NULL; /**< Chunks of WEAPON_POOL_CHUNK weapons (array.h). */
+static Weapon *weapon_poolFree = NULL; /**< Head of the free weapon list. */
 
 /* Graphics. */
 static gl_vbo  *weapon_vbo     = NULL; /**< Weapon VBO. */
@@ -105,6 +137,49 @@ static size_t weapon_vboSize   = 0; /**< Size of the VBO. */
 static unsigned int beam_idgen = 0; /**< Beam identifier generator. */
 
 
+/**
+ * @brief Bounding box of a pilot stored in the collision grid.
+ */
+typedef struct WeaponGridEntry_ {
+   unsigned int id; /**< ID of the pilot. */
+   double x1; /**< Left bound. */
+   double y1; /**< Bottom bound. */
+   double x2; /**< Right bound. */
+   double y2; /**< Top bound. */
+} WeaponGridEntry;
+
+/**
+ * @brief Uniform grid over the pilots used as collision broadphase.
+ *
+ * Rebuilt once per frame before the weapons are updated. Each cell lists the
+ * entries overlapping it in pilot stack order, so that queries return
+ * candidates in the same order the pilot stack would be walked in.
+ */
+typedef struct WeaponGrid_ {
+   WeaponGridEntry *entries; /**< Pilot bounding boxes (array.h). */
+   int *stamp; /**< Last query that visited each entry (array.h). */
+   int *cells; /**< Offset of each cell in items, has nx*ny+1 elements (array.h). */
+   int *items; /**< Entry indices sorted by cell (array.h). */
+   int *fill; /**< Temporary fill pointers of the cells (array.h). */
+   int *query; /**< Entry indices found by the last query (array.h). */
+   Pilot **cand; /**< Candidate pilots found by the last query (array.h). */
+   unsigned int *nopoly; /**< IDs of the pilots without collision polygons, in pilot stack order (array.h). */
+   double x; /**< Left of the grid. */
+   double y; /**< Bottom of the grid. */
+   double csize; /**< Size of a cell. */
+   int nx; /**< Number of cells on the x axis. */
+   int ny; /**< Number of cells on the y axis. */
+   int gen; /**< Current query generation. */
+   unsigned int maxid; /**< Highest pilot ID in the grid. */
+} WeaponGrid;
+static WeaponGrid weapon_grid; /**< Pilot collision grid. */
+static int *weapon_astQuery = NULL; /**< Asteroids found by the last asteroid query (array.h). */
+#if DEBUGGING
+static int weapon_gridTested = 0; /**< Weapon-pilot pairs tested this frame. */
+static int weapon_gridPruned = 0; /**< Weapon-pilot pairs pruned this frame. */
+#endif /* DEBUGGING */
+
+
 /*
  * Prototypes
  */
@@ -118,11 +193,26 @@ static void weapon_createAmmo( Weapon *w, const Outfit* outfit, double T,
       const double dir, const Vector2d* pos, const Vector2d* vel, const Pilot* parent, double time );
 static Weapon* weapon_create( const Outfit* outfit, double T,
       const double dir, const Vector2d* pos, const Vector2d* vel,
-      const Pilot *parent, const unsigned int target, double time );
+      const Pilot *parent, const unsigned int target, double time,
+      WeaponLayer layer );
+/* Storage. */
+static Weapon* weapon_alloc (void);
+static void weapon_storeInit( WeaponStore *st );
+static void weapon_storeAdd( Weapon *w, WeaponLayer layer );
+static void weapon_storeRemove( WeaponStore *st, int i );
+static void weapon_storeCompact( WeaponStore *st );
+static void weapon_storeFree( WeaponStore *st );
+static void weapon_vboGrow (void);
 /* Updating. */
 static void weapon_render( Weapon* w, const double dt );
 static void weapons_updateLayer( const double dt, const WeaponLayer layer );
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer );
+/* Broadphase. */
+static void weapon_gridBuild (void);
+static void weapon_gridCell( double x, double y, int *cx, int *cy );
+static int weapon_gridQuery( double x1, double y1, double x2, double y2 );
+static unsigned int weapon_gridNoPoly( unsigned int parent );
+static void weapon_gridFree (void);
 /* Destruction. */
 static void weapon_destroy( Weapon* w, WeaponLayer layer );
 static void weapon_free( Weapon* w );
@@ -150,8 +240,185 @@ static void weapon_setTurn( Weapon *w, double turn );
 
 void weapon_init (void)
 {
-   wfrontLayer = array_create(Weapon*);
-   wbackLayer  = array_create(Weapon*);
+   weapon_storeInit( &wfrontLayer );
+   weapon_storeInit( &wbackLayer );
+}
+
+
+/**
+ * @brief Sets up an empty layer store.
+ *
+ *    @param st Store to set up.
+ */
+static void weapon_storeInit( WeaponStore *st )
+{
+   st->w        = array_create( Weapon* );
+   st->solid    = array_create( Solid );
+   st->timer    = array_create( double );
+   st->falloff  = array_create( double );
+   st->strength = array_create( double );
+}
+
+
+/**
+ * @brief Frees a layer store, does NOT free the weapons.
+ *
+ *    @param st Store to free.
+ */
+static void weapon_storeFree( WeaponStore *st )
+{
+   array_free( st->w );
+   array_free( st->solid );
+   array_free( st->timer );
+   array_free( st->falloff );
+   array_free( st->strength );
+   memset( st, 0, sizeof(WeaponStore) );
+}
+
+
+/**
+ * @brief Appends a weapon to the store of a layer.
+ *
+ *    @param w Weapon to append.
+ *    @param layer Layer to append the weapon to.
+ */
+static void weapon_storeAdd( Weapon *w, WeaponLayer layer )
+{
+   int i;
+   WeaponStore *st;
+   Solid *old;
+
+   st       = weapon_store( layer );
+   w->layer = layer;
+   w->idx   = array_size( st->w );
+   array_push_back( &st->w, w );
+   array_push_back( &st->timer, 0. );
+   array_push_back( &st->falloff, 0. );
+   array_push_back( &st->strength, 1. );
+
+   /* Growing may move the solids, the weapons have to follow. */
+   old = st->solid;
+   memset( &array_grow( &st->solid ), 0, sizeof(Solid) );
+   if (st->solid != old) {
+      for (i=0; i<array_size(st->w); i++)
+         if (st->w[i] != NULL)
+            st->w[i]->solid = &st->solid[i];
+   }
+   else
+      w->solid = &st->solid[ w->idx ];
+}
+
+
+/**
+ * @brief Removes a weapon from the store of its layer.
+ *
+ * While the layer updates the slot is only cleared, weapons_updateLayer
+ * compacts the store afterwards. Otherwise the weapons after it shift down so
+ * the render order is kept.
+ *
+ *    @param st Store to remove from.
+ *    @param i Index of the weapon to remove.
+ */
+static void weapon_storeRemove( WeaponStore *st, int i )
+{
+   st->w[i] = NULL;
+   st->dead++;
+   if (!st->updating)
+      weapon_storeCompact( st );
+}
+
+
+/**
+ * @brief Drops the cleared slots of a store, keeping the order of the rest.
+ *
+ *    @param st Store to compact.
+ */
+static void weapon_storeCompact( WeaponStore *st )
+{
+   int i, j, n;
+   Weapon *w;
+
+   if (st->dead <= 0)
+      return;
+
+   n = array_size(st->w);
+   j = 0;
+   for (i=0; i<n; i++) {
+      w = st->w[i];
+      if (w == NULL)
+         continue;
+      if (i != j) {
+         st->w[j]          = w;
+         st->solid[j]      = st->solid[i];
+         st->timer[j]      = st->timer[i];
+         st->falloff[j]    = st->falloff[i];
+         st->strength[j]   = st->strength[i];
+         w->idx            = j;
+         w->solid          = &st->solid[j];
+      }
+      j++;
+   }
+   array_resize( &st->w, j );
+   array_resize( &st->solid, j );
+   array_resize( &st->timer, j );
+   array_resize( &st->falloff, j );
+   array_resize( &st->strength, j );
+   st->dead = 0;
+}
+
+
+/**
+ * @brief Gets a cleared weapon from the pool.
+ *
+ * Weapons are allocated in chunks and recycled through a free list so firing
+ * does not hit the allocator.
+ *
+ *    @return A zeroed weapon.
+ */
+static Weapon* weapon_alloc (void)
+{
+   int i;
+   Weapon *chunk, *w;
+
+   /* Grow the pool. */
+   if (weapon_poolFree == NULL) {
+      if (weapon_pool == NULL)
+         weapon_pool = array_create( Weapon* );
+      chunk = calloc( WEAPON_POOL_CHUNK, sizeof(Weapon) );
+      if (chunk == NULL)
+         ERR(_("Out of Memory"));
+      array_push_back( &weapon_pool, chunk );
+      for (i=0; i<WEAPON_POOL_CHUNK; i++) {
+         chunk[i].next_free = weapon_poolFree;
+         weapon_poolFree    = &chunk[i];
+      }
+   }
+
+   /* Pop from the free list. */
+   w               = weapon_poolFree;
+   weapon_poolFree = w->next_free;
+   memset( w, 0, sizeof(Weapon) );
+   return w;
+}
+
+
+/**
+ * @brief Grows the vertex buffer to match the layers if needed.
+ */
+static void weapon_vboGrow (void)
+{
+   GLsizei size;
+   size_t bufsize;
+
+   bufsize = array_reserved(wfrontLayer.w) + array_reserved(wbackLayer.w);
+   if (bufsize != weapon_vboSize) {
+      weapon_vboSize = bufsize;
+      size = sizeof(GLfloat) * (2+4) * weapon_vboSize;
+      weapon_vboData = realloc( weapon_vboData, size );
+      if (weapon_vbo == NULL)
+         weapon_vbo = gl_vboCreateStream( size, NULL );
+      gl_vboData( weapon_vbo, size, weapon_vboData );
+   }
 }
 
 
@@ -184,8 +451,8 @@ void weapon_minimap( const double res, const double w,
       rc = 0;
 
    /* Draw the points for weapons on all layers. */
-   for (i=0; i<array_size(wbackLayer); i++) {
-      wp = wbackLayer[i];
+   for (i=0; i<array_size(wbackLayer.w); i++) {
+      wp = wbackLayer.w[i];
 
       /* Make sure is in range. */
       if (!pilot_inRange( player.p, wp->solid->pos.x, wp->solid->pos.y ))
@@ -230,8 +497,8 @@ void weapon_minimap( const double res, const double w,
       /* "Add" pixel. */
       p++;
    }
-   for (i=0; i<array_size(wfrontLayer); i++) {
-      wp = wfrontLayer[i];
+   for (i=0; i<array_size(wfrontLayer.w); i++) {
+      wp = wfrontLayer.w[i];
 
       /* Make sure is in range. */
       if (!pilot_inRange( player.p, wp->solid->pos.x, wp->solid->pos.y ))
@@ -400,7 +667,7 @@ static void think_beam( Weapon* w, const double dt )
    /* Get pilot, if pilot is dead beam is destroyed. */
    p = pilot_get(w->parent);
    if (p == NULL) {
-      w->timer = -1.; /* Hack to make it get destroyed next update. */
+      weapon_timer(w) = -1.; /* Hack to make it get destroyed next update. */
       return;
    }
 
@@ -408,7 +675,7 @@ static void think_beam( Weapon* w, const double dt )
    p->energy -= dt*w->outfit->u.bem.energy;
    if (p->energy < 0.) {
       p->energy = 0.;
-      w->timer = -1;
+      weapon_timer(w) = -1;
       return;
    }
 
@@ -453,6 +720,258 @@ static void think_beam( Weapon* w, const double dt )
 }
 
 
+/**
+ * @brief Rebuilds the pilot collision grid.
+ *
+ * Pilots don't move while weapons are being updated, so this only has to be
+ * done once per frame.
+ */
+static void weapon_gridBuild (void)
+{
+   int i, j, k, n, cx1, cy1, cx2, cy2, cx, cy;
+   double hw, hh, x1, y1, x2, y2;
+   Pilot *p;
+   CollPoly *plg;
+   WeaponGridEntry *e;
+   WeaponGrid *g = &weapon_grid;
+
+   if (g->entries == NULL) {
+      g->entries  = array_create( WeaponGridEntry );
+      g->stamp    = array_create( int );
+      g->cells    = array_create( int );
+      g->items    = array_create( int );
+      g->fill     = array_create( int );
+      g->query    = array_create( int );
+      g->cand     = array_create( Pilot* );
+      g->nopoly   = array_create( unsigned int );
+      weapon_astQuery = array_create( int );
+   }
+
+   /* Bounding boxes of the pilots, ordered like the pilot stack. */
+   n = array_size(pilot_stack);
+   array_resize( &g->entries, n );
+   array_resize( &g->stamp, n );
+   array_resize( &g->nopoly, 0 );
+   g->maxid = 0;
+   x1 = y1 = HUGE_VAL;
+   x2 = y2 = -HUGE_VAL;
+   for (i=0; i<n; i++) {
+      p  = pilot_stack[i];
+      e  = &g->entries[i];
+      hw = p->ship->gfx_space->sw / 2.;
+      hh = p->ship->gfx_space->sh / 2.;
+      if (p->ship->npolygon != 0) {
+         k   = p->ship->gfx_space->sx * p->tsy + p->tsx;
+         plg = &p->ship->polygon[k];
+         hw  = MAX( hw, MAX( -plg->xmin, plg->xmax ) );
+         hh  = MAX( hh, MAX( -plg->ymin, plg->ymax ) );
+      }
+      else
+         array_push_back( &g->nopoly, p->id );
+      hw   += WEAPON_GRID_MARGIN;
+      hh   += WEAPON_GRID_MARGIN;
+      e->id = p->id;
+      e->x1 = p->solid->pos.x - hw;
+      e->y1 = p->solid->pos.y - hh;
+      e->x2 = p->solid->pos.x + hw;
+      e->y2 = p->solid->pos.y + hh;
+      g->stamp[i] = 0;
+      g->maxid = MAX( g->maxid, p->id );
+      x1 = MIN( x1, e->x1 );
+      y1 = MIN( y1, e->y1 );
+      x2 = MAX( x2, e->x2 );
+      y2 = MAX( y2, e->y2 );
+   }
+   g->gen = 0;
+
+   /* Set up the grid dimensions. */
+   if (n == 0) {
+      g->x = g->y = 0.;
+      x2 = y2 = 0.;
+   }
+   else {
+      g->x = x1;
+      g->y = y1;
+   }
+   g->csize = MAX( WEAPON_GRID_CELL, MAX( x2-g->x, y2-g->y ) / WEAPON_GRID_DIM );
+   g->nx    = MIN( WEAPON_GRID_DIM, (int)((x2-g->x) / g->csize) + 1 );
+   g->ny    = MIN( WEAPON_GRID_DIM, (int)((y2-g->y) / g->csize) + 1 );
+
+   /* Count the entries per cell. */
+   array_resize( &g->cells, g->nx*g->ny+1 );
+   array_resize( &g->fill, g->nx*g->ny );
+   for (i=0; i<array_size(g->cells); i++)
+      g->cells[i] = 0;
+   for (i=0; i<n; i++) {
+      e = &g->entries[i];
+      weapon_gridCell( e->x1, e->y1, &cx1, &cy1 );
+      weapon_gridCell( e->x2, e->y2, &cx2, &cy2 );
+      for (cy=cy1; cy<=cy2; cy++)
+         for (cx=cx1; cx<=cx2; cx++)
+            g->cells[ cy*g->nx + cx + 1 ]++;
+   }
+   for (i=0; i<g->nx*g->ny; i++) {
+      g->cells[i+1] += g->cells[i];
+      g->fill[i]     = g->cells[i];
+   }
+
+   /* Fill the cells, entries end up in stack order within each cell. */
+   array_resize( &g->items, g->cells[ g->nx*g->ny ] );
+   for (i=0; i<n; i++) {
+      e = &g->entries[i];
+      weapon_gridCell( e->x1, e->y1, &cx1, &cy1 );
+      weapon_gridCell( e->x2, e->y2, &cx2, &cy2 );
+      for (cy=cy1; cy<=cy2; cy++) {
+         for (cx=cx1; cx<=cx2; cx++) {
+            j = cy*g->nx + cx;
+            g->items[ g->fill[j]++ ] = i;
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Gets the collision grid cell containing a point, clamped to the grid.
+ */
+static void weapon_gridCell( double x, double y, int *cx, int *cy )
+{
+   WeaponGrid *g = &weapon_grid;
+   *cx = CLAMP( 0, g->nx-1, (int)floor( (x - g->x) / g->csize ) );
+   *cy = CLAMP( 0, g->ny-1, (int)floor( (y - g->y) / g->csize ) );
+}
+
+
+/**
+ * @brief Compares two integers (for use with qsort).
+ */
+static int weapon_gridCmp( const void *a, const void *b )
+{
+   return *(const int*)a - *(const int*)b;
+}
+
+
+/**
+ * @brief Gets the pilots that may collide with an axis aligned box.
+ *
+ * Candidates are stored in weapon_grid.cand in pilot stack order. Pilots
+ * created after the grid was built are always included.
+ *
+ *    @return Number of candidates.
+ */
+static int weapon_gridQuery( double x1, double y1, double x2, double y2 )
+{
+   int i, j, cx1, cy1, cx2, cy2, cx, cy;
+   Pilot *p;
+   WeaponGridEntry *e;
+   WeaponGrid *g = &weapon_grid;
+
+   array_resize( &g->query, 0 );
+   array_resize( &g->cand, 0 );
+
+   if (array_size(g->entries) > 0) {
+      g->gen++;
+      weapon_gridCell( x1, y1, &cx1, &cy1 );
+      weapon_gridCell( x2, y2, &cx2, &cy2 );
+      for (cy=cy1; cy<=cy2; cy++) {
+         for (cx=cx1; cx<=cx2; cx++) {
+            j = cy*g->nx + cx;
+            for (i=g->cells[j]; i<g->cells[j+1]; i++) {
+               if (g->stamp[ g->items[i] ] == g->gen)
+                  continue;
+               g->stamp[ g->items[i] ] = g->gen;
+               e = &g->entries[ g->items[i] ];
+               if ((e->x2 < x1) || (x2 < e->x1) ||
+                     (e->y2 < y1) || (y2 < e->y1))
+                  continue;
+               array_push_back( &g->query, g->items[i] );
+            }
+         }
+      }
+      qsort( g->query, array_size(g->query), sizeof(int), weapon_gridCmp );
+   }
+
+   /* Convert to pilots, the stack may have changed since the grid was built. */
+   for (i=0; i<array_size(g->query); i++) {
+      p = pilot_get( g->entries[ g->query[i] ].id );
+      if (p != NULL)
+         array_push_back( &g->cand, p );
+   }
+
+   /* New pilots aren't in the grid, so they have to be checked always. */
+   for (i=array_size(pilot_stack)-1; i>=0; i--)
+      if (pilot_stack[i]->id <= g->maxid)
+         break;
+   for (i=i+1; i<array_size(pilot_stack); i++)
+      array_push_back( &g->cand, pilot_stack[i] );
+
+#if DEBUGGING
+   weapon_gridTested += array_size(g->cand);
+   weapon_gridPruned += array_size(pilot_stack) - array_size(g->cand);
+#endif /* DEBUGGING */
+
+   return array_size(g->cand);
+}
+
+
+/**
+ * @brief Gets the first pilot that makes weapons stop using polygons.
+ *
+ * Walking the pilot stack, a weapon falls back to sprite collisions once it
+ * gets to a pilot without a collision polygon, including the pilots the
+ * broadphase leaves out.
+ *
+ *    @param parent ID of the pilot that shot the weapon, it's skipped.
+ *    @return ID of the first pilot without a polygon or UINT_MAX.
+ */
+static unsigned int weapon_gridNoPoly( unsigned int parent )
+{
+   int i;
+   WeaponGrid *g = &weapon_grid;
+
+   for (i=0; i<array_size(g->nopoly); i++)
+      if (g->nopoly[i] != parent)
+         return g->nopoly[i];
+   return UINT_MAX;
+}
+
+
+/**
+ * @brief Frees the pilot collision grid.
+ */
+static void weapon_gridFree (void)
+{
+   WeaponGrid *g = &weapon_grid;
+   array_free( g->entries );
+   array_free( g->stamp );
+   array_free( g->cells );
+   array_free( g->items );
+   array_free( g->fill );
+   array_free( g->query );
+   array_free( g->cand );
+   array_free( g->nopoly );
+   memset( g, 0, sizeof(WeaponGrid) );
+
+   array_free( weapon_astQuery );
+   weapon_astQuery = NULL;
+}
+
+
+#if DEBUGGING
+/**
+ * @brief Gets the broadphase statistics of the last frame.
+ *
+ *    @param[out] tested Number of weapon-pilot pairs that were tested.
+ *    @param[out] pruned Number of weapon-pilot pairs that were skipped.
+ */
+void weapon_gridStats( int *tested, int *pruned )
+{
+   *tested = weapon_gridTested;
+   *pruned = weapon_gridPruned;
+}
+#endif /* DEBUGGING */
+
+
 /**
  * @brief Updates all the weapon layers.
  *
@@ -460,6 +979,13 @@ static void think_beam( Weapon* w, const double dt )
  */
 void weapons_update( const double dt )
 {
+   /* Pilots don't move while weapons update, so build the broadphase now. */
+   weapon_gridBuild();
+#if DEBUGGING
+   weapon_gridTested = 0;
+   weapon_gridPruned = 0;
+#endif /* DEBUGGING */
+
    weapons_updateLayer(dt,WEAPON_LAYER_BG);
    weapons_updateLayer(dt,WEAPON_LAYER_FG);
 }
@@ -473,9 +999,10 @@ void weapons_update( const double dt )
  */
 static void weapons_updateLayer( const double dt, const WeaponLayer layer )
 {
-   Weapon **wlayer;
+   WeaponStore *st;
    Weapon *w;
-   int i;
+   double *timer, *falloff, *strength;
+   int i, n;
    int spfx;
    int s;
    Pilot *p;
@@ -483,10 +1010,10 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
    /* Choose layer. */
    switch (layer) {
       case WEAPON_LAYER_BG:
-         wlayer = wbackLayer;
+         st = &wbackLayer;
          break;
       case WEAPON_LAYER_FG:
-         wlayer = wfrontLayer;
+         st = &wfrontLayer;
          break;
 
       default:
@@ -494,47 +1021,32 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
          return;
    }
 
-   i = 0;
-   while (i < array_size(wlayer)) {
-      w = wlayer[i];
+   /* Age all the weapons and recalculate the bolt falloff. Ammo and beams
+    * have no falloff so their strength is left alone. */
+   n        = array_size(st->w);
+   timer    = st->timer;
+   falloff  = st->falloff;
+   strength = st->strength;
+   for (i=0; i<n; i++)
+      timer[i] -= dt;
+   for (i=0; i<n; i++)
+      if ((timer[i] >= 0.) && (timer[i] < falloff[i]))
+         strength[i] = timer[i] / falloff[i];
+
+   /* Destroyed weapons are only cleared until the update is over. */
+   st->updating = 1;
+   for (i=0; i<array_size(st->w); i++) {
+      w = st->w[i];
+      if (w == NULL)
+         continue;
 
       switch (w->outfit->type) {
 
-         /* most missiles behave the same */
+         /* Bolts and missiles expire the same. */
          case OUTFIT_TYPE_AMMO:
-
-            w->timer -= dt;
-            if (w->timer < 0.) {
-               spfx = -1;
-               /* See if we need armour death sprite. */
-               if (outfit_isProp(w->outfit, OUTFIT_PROP_WEAP_BLOWUP_ARMOUR))
-                  spfx = outfit_spfxArmour(w->outfit);
-               /* See if we need shield death sprite. */
-               else if (outfit_isProp(w->outfit, OUTFIT_PROP_WEAP_BLOWUP_SHIELD))
-                  spfx = outfit_spfxShield(w->outfit);
-               /* Add death sprite if needed. */
-               if (spfx != -1) {
-                  spfx_add( spfx, w->solid->pos.x, w->solid->pos.y,
-                        w->solid->vel.x, w->solid->vel.y,
-                        SPFX_LAYER_BACK ); /* presume back. */
-                  /* Add sound if explodes and has it. */
-                  s = outfit_soundHit(w->outfit);
-                  if (s != -1)
-                     w->voice = sound_playPos(s,
-                           w->solid->pos.x,
-                           w->solid->pos.y,
-                           w->solid->vel.x,
-                           w->solid->vel.y);
-               }
-               weapon_destroy(w,layer);
-               break;
-            }
-            break;
-
          case OUTFIT_TYPE_BOLT:
          case OUTFIT_TYPE_TURRET_BOLT:
-            w->timer -= dt;
-            if (w->timer < 0.) {
+            if (st->timer[i] < 0.) {
                spfx = -1;
                /* See if we need armour death sprite. */
                if (outfit_isProp(w->outfit, OUTFIT_PROP_WEAP_BLOWUP_ARMOUR))
@@ -559,15 +1071,12 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
                weapon_destroy(w,layer);
                break;
             }
-            else if (w->timer < w->falloff)
-               w->strength = w->timer / w->falloff;
             break;
 
          /* Beam weapons handled a part. */
          case OUTFIT_TYPE_BEAM:
          case OUTFIT_TYPE_TURRET_BEAM:
-            w->timer -= dt;
-            if (w->timer < 0. || (w->outfit->u.bem.min_duration > 0. &&
+            if (st->timer[i] < 0. || (w->outfit->u.bem.min_duration > 0. &&
                   w->mount->stimer < 0.)) {
                p = pilot_get(w->parent);
                if (p != NULL)
@@ -590,17 +1099,14 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
             break;
       }
 
-      /* Out of bounds, loop is over. */
-      if (i >= array_size(wlayer))
-         break;
-
-      /* Only increment if weapon wasn't deleted. */
-      if (w == wlayer[i]) {
+      /* Only update if weapon wasn't deleted. */
+      if (w == st->w[i])
          weapon_update(w,dt,layer);
-         if ((i < array_size(wlayer)) && (w == wlayer[i]))
-            i++;
-      }
    }
+   st->updating = 0;
+
+   /* Drop the destroyed weapons in one pass, keeping the render order. */
+   weapon_storeCompact( st );
 }
 
 
@@ -617,10 +1123,10 @@ void weapons_render( const WeaponLayer layer, const double dt )
 
    switch (layer) {
       case WEAPON_LAYER_BG:
-         wlayer = wbackLayer;
+         wlayer = wbackLayer.w;
          break;
       case WEAPON_LAYER_FG:
-         wlayer = wfrontLayer;
+         wlayer = wfrontLayer.w;
          break;
 
       default:
@@ -628,8 +1134,10 @@ void weapons_render( const WeaponLayer layer, const double dt )
          return;
    }
 
+   gl_batchBegin();
    for (i=0; i<array_size(wlayer); i++)
       weapon_render( wlayer[i], dt );
+   gl_batchEnd();
 }
 
 
@@ -639,6 +1147,7 @@ static void weapon_renderBeam( Weapon* w, const double dt ) {
    gl_Matrix4 projection, tex_mat;
 
    /* Load GLSL program */
+   gl_batchFlush();
    glUseProgram(shaders.beam.program);
 
    gfx = outfit_gfx(w->outfit);
@@ -710,7 +1219,7 @@ static void weapon_render( Weapon* w, const double dt )
          gfx = outfit_gfx(w->outfit);
 
          /* Alpha based on strength. */
-         c.a = w->strength;
+         c.a = weapon_strength(w);
 
          /* Outfit spins around. */
          if (outfit_isProp(w->outfit, OUTFIT_PROP_WEAP_SPIN)) {
@@ -728,7 +1237,7 @@ static void weapon_render( Weapon* w, const double dt )
             /* Render. */
             if (outfit_isBolt(w->outfit) && w->outfit->u.blt.gfx_end)
                gl_blitSpriteInterpolate( gfx, w->outfit->u.blt.gfx_end,
-                     w->timer / w->life,
+                     weapon_timer(w) / w->life,
                      w->solid->pos.x, w->solid->pos.y,
                      w->sprite % (int)gfx->sx, w->sprite / (int)gfx->sx, &c );
             else
@@ -739,7 +1248,7 @@ static void weapon_render( Weapon* w, const double dt )
          else {
             if (outfit_isBolt(w->outfit) && w->outfit->u.blt.gfx_end)
                gl_blitSpriteInterpolate( gfx, w->outfit->u.blt.gfx_end,
-                     w->timer / w->life,
+                     weapon_timer(w) / w->life,
                      w->solid->pos.x, w->solid->pos.y, w->sx, w->sy, &c );
             else
                gl_blitSprite( gfx, w->solid->pos.x, w->solid->pos.y, w->sx, w->sy, &c );
@@ -839,8 +1348,10 @@ static int weapon_checkCanHit( Weapon* w, Pilot *p )
  */
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
 {
-   int i, j, b, psx, psy, k, n;
-   unsigned int coll, usePoly=1;
+   int i, j, b, psx, psy, k, n, c, ncand;
+   unsigned int coll, usePoly=1, nopoly;
+   double x1, y1, x2, y2, hw, hh;
+   Vector2d bend;
    glTexture *gfx;
    CollPoly *plg, *polygon;
    Vector2d crash[2];
@@ -872,16 +1383,40 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
       }
    }
 
-   for (i=0; i<array_size(pilot_stack); i++) {
-      p = pilot_stack[i];
+   /* Bounding box of the weapon for the broadphase. */
+   if (b) {
+      x1 = w->solid->pos.x;
+      y1 = w->solid->pos.y;
+      x2 = x1 + w->outfit->u.bem.range * cos(w->solid->dir);
+      y2 = y1 + w->outfit->u.bem.range * sin(w->solid->dir);
+      hw = hh = WEAPON_GRID_MARGIN;
+   }
+   else {
+      x1 = x2 = w->solid->pos.x;
+      y1 = y2 = w->solid->pos.y;
+      hw = gfx->sw / 2.;
+      hh = gfx->sh / 2.;
+      if (usePoly) {
+         hw = MAX( hw, MAX( -polygon->xmin, polygon->xmax ) );
+         hh = MAX( hh, MAX( -polygon->ymin, polygon->ymax ) );
+      }
+      hw += WEAPON_GRID_MARGIN;
+      hh += WEAPON_GRID_MARGIN;
+   }
+   ncand = weapon_gridQuery( MIN(x1,x2) - hw, MIN(y1,y2) - hh,
+         MAX(x1,x2) + hw, MAX(y1,y2) + hh );
+   nopoly = weapon_gridNoPoly( w->parent );
+
+   for (c=0; c<ncand; c++) {
+      p = weapon_grid.cand[c];
 
-      psx = pilot_stack[i]->tsx;
-      psy = pilot_stack[i]->tsy;
+      psx = p->tsx;
+      psy = p->tsy;
 
-      if (w->parent == pilot_stack[i]->id) continue; /* pilot is self */
+      if (w->parent == p->id) continue; /* pilot is self */
 
       /* See if the ship has a collision polygon. */
-      if (p->ship->npolygon == 0)
+      if ((p->ship->npolygon == 0) || (p->id >= nopoly))
          usePoly = 0;
 
       /* Beam weapons have special collisions. */
@@ -908,7 +1443,7 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
       /* smart weapons only collide with their target */
       else if (weapon_isSmart(w)) {
 
-         if ( (pilot_stack[i]->id == w->target) &&
+         if ( (p->id == w->target) &&
                (w->status == WEAPON_STATUS_OK) &&
                weapon_checkCanHit(w,p) ) {
             if (usePoly) {
@@ -950,27 +1485,14 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
    }
 
    /* Collide with asteroids*/
-   if (outfit_isAmmo(w->outfit)) {
-      for (i=0; i<cur_system->nasteroids; i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        &crash[0] ) ) {
-               weapon_hitAst( w, a, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
-         }
-      }
-   }
-   else if (outfit_isBolt(w->outfit)) {
+   if (outfit_isAmmo(w->outfit) || outfit_isBolt(w->outfit)) {
       for (i=0; i<cur_system->nasteroids; i++) {
          ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
+         n   = asteroid_queryRadius( ast, &w->solid->pos,
+               sqrt( pow2(gfx->sw) + pow2(gfx->sh) ) / 2. + WEAPON_GRID_MARGIN,
+               &weapon_astQuery );
+         for (j=0; j<n; j++) {
+            a = &ast->asteroids[ weapon_astQuery[j] ];
             at = space_getType ( a->type );
             if ( (a->appearing == ASTEROID_VISIBLE) &&
                   CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
@@ -983,10 +1505,15 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
       }
    }
    else if (b) { /* Beam */
+      x2 = w->solid->pos.x + w->outfit->u.bem.range * cos(w->solid->dir);
+      y2 = w->solid->pos.y + w->outfit->u.bem.range * sin(w->solid->dir);
+      vect_cset( &bend, x2, y2 );
       for (i=0; i<cur_system->nasteroids; i++) {
          ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
+         n   = asteroid_querySegment( ast, &w->solid->pos, &bend,
+               WEAPON_GRID_MARGIN, &weapon_astQuery );
+         for (j=0; j<n; j++) {
+            a = &ast->asteroids[ weapon_astQuery[j] ];
             at = space_getType ( a->type );
             if ( (a->appearing == ASTEROID_VISIBLE) &&
                   CollideLineSprite( &w->solid->pos, w->solid->dir,
@@ -1096,7 +1623,7 @@ static void weapon_hit( Weapon* w, Pilot* p, WeaponLayer layer, Vector2d* pos )
    /* Get general details. */
    odmg              = outfit_damage( w->outfit );
    parent            = pilot_get( w->parent );
-   dmg.damage        = MAX( 0., w->dam_mod * w->strength * odmg->damage * (1.-w->dam_as_dis_mod) );
+   dmg.damage        = MAX( 0., w->dam_mod * weapon_strength(w) * odmg->damage * (1.-w->dam_as_dis_mod) );
    dmg.penetration   = odmg->penetration;
    dmg.type          = odmg->type;
    dmg.disable       = MAX( 0., odmg->disable + dmg.damage * w->dam_as_dis_mod );
@@ -1147,7 +1674,7 @@ static void weapon_hitAst( Weapon* w, Asteroid* a, WeaponLayer layer, Vector2d*
 
    /* Get general details. */
    odmg              = outfit_damage( w->outfit );
-   dmg.damage        = MAX( 0., w->dam_mod * w->strength * odmg->damage );
+   dmg.damage        = MAX( 0., w->dam_mod * weapon_strength(w) * odmg->damage );
    dmg.penetration   = odmg->penetration;
    dmg.type          = odmg->type;
    dmg.disable       = odmg->disable;
@@ -1193,7 +1720,7 @@ static void weapon_hitBeam( Weapon* w, Pilot* p, WeaponLayer layer,
    /* Get general details. */
    odmg              = outfit_damage( w->outfit );
    parent            = pilot_get( w->parent );
-   dmg.damage        = MAX( 0., w->dam_mod * w->strength * odmg->damage * dt );
+   dmg.damage        = MAX( 0., w->dam_mod * weapon_strength(w) * odmg->damage * dt );
    dmg.penetration   = odmg->penetration;
    dmg.type          = odmg->type;
    dmg.disable       = odmg->disable * dt;
@@ -1244,7 +1771,7 @@ static void weapon_hitAstBeam( Weapon* w, Asteroid* a, WeaponLayer layer,
 
    /* Get general details. */
    odmg              = outfit_damage( w->outfit );
-   dmg.damage        = MAX( 0., w->dam_mod * w->strength * odmg->damage * dt );
+   dmg.damage        = MAX( 0., w->dam_mod * weapon_strength(w) * odmg->damage * dt );
    dmg.penetration   = odmg->penetration;
    dmg.type          = odmg->type;
    dmg.disable       = odmg->disable * dt;
@@ -1404,9 +1931,9 @@ static void weapon_createBolt( Weapon *w, const Outfit* outfit, double T,
    mass = 1; /* Lasers are presumed to have unitary mass */
    v = *vel;
    vect_cadd( &v, outfit->u.blt.speed*cos(rdir), outfit->u.blt.speed*sin(rdir));
-   w->timer = outfit->u.blt.range / outfit->u.blt.speed;
-   w->falloff = w->timer - outfit->u.blt.falloff / outfit->u.blt.speed;
-   w->solid = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_EULER );
+   weapon_timer(w) = outfit->u.blt.range / outfit->u.blt.speed;
+   weapon_falloff(w) = weapon_timer(w) - outfit->u.blt.falloff / outfit->u.blt.speed;
+   solid_init( w->solid, mass, rdir, pos, &v, SOLID_UPDATE_EULER );
    w->voice = sound_playPos( w->outfit->u.blt.sound,
          w->solid->pos.x,
          w->solid->pos.y,
@@ -1472,8 +1999,8 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
 
    /* Set up ammo details. */
    mass        = w->outfit->mass;
-   w->timer    = ammo->u.amm.duration * parent->stats.launch_range;
-   w->solid    = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
+   weapon_timer(w)    = ammo->u.amm.duration * parent->stats.launch_range;
+   solid_init( w->solid, mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
    if (w->outfit->u.amm.thrust != 0.) {
       weapon_setThrust( w, w->outfit->u.amm.thrust * mass );
       w->solid->speed_max = w->outfit->u.amm.speed; /* Limit speed, we only care if it has thrust. */
@@ -1514,11 +2041,13 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
  *    @param parent Shooter.
  *    @param target Target ID of the shooter.
  *    @param time Expected flight time.
+ *    @param layer Layer to add the weapon to.
  *    @return A pointer to the newly created weapon.
  */
 static Weapon* weapon_create( const Outfit* outfit, double T,
       const double dir, const Vector2d* pos, const Vector2d* vel,
-      const Pilot* parent, const unsigned int target, double time )
+      const Pilot* parent, const unsigned int target, double time,
+      WeaponLayer layer )
 {
    double mass, rdir;
    Pilot *pilot_target;
@@ -1528,7 +2057,8 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
    Weapon* w;
 
    /* Create basic features */
-   w           = calloc( 1, sizeof(Weapon) );
+   w           = weapon_alloc();
+   weapon_storeAdd( w, layer );
    w->dam_mod  = 1.; /* Default of 100% damage. */
    w->dam_as_dis_mod = 0.; /* Default of 0% damage to disable. */
    w->faction  = parent->faction; /* non-changeable */
@@ -1540,7 +2070,6 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
       w->outfit   = outfit; /* non-changeable */
    w->update   = weapon_update;
    w->status   = WEAPON_STATUS_OK;
-   w->strength = 1.;
 
    /* Inform the target. */
    pilot_target = pilot_get(target);
@@ -1575,9 +2104,9 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
          else if (rdir >= 2.*M_PI)
             rdir -= 2.*M_PI;
          mass = 1.; /**< Needs a mass. */
-         w->solid = solid_create( mass, rdir, pos, vel, SOLID_UPDATE_EULER );
+         solid_init( w->solid, mass, rdir, pos, vel, SOLID_UPDATE_EULER );
          w->think = think_beam;
-         w->timer = outfit->u.bem.duration;
+         weapon_timer(w) = outfit->u.bem.duration;
          w->voice = sound_playPos( w->outfit->u.bem.sound,
                w->solid->pos.x,
                w->solid->pos.y,
@@ -1595,12 +2124,12 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
       default:
          WARN(_("Weapon of type '%s' has no create implemented yet!"),
                w->outfit->name);
-         w->solid = solid_create( 1., dir, pos, vel, SOLID_UPDATE_EULER );
+         solid_init( w->solid, 1., dir, pos, vel, SOLID_UPDATE_EULER );
          break;
    }
 
    /* Set life to timer. */
-   w->life = w->timer;
+   w->life = weapon_timer(w);
 
    return w;
 }
@@ -1623,9 +2152,6 @@ void weapon_add( const Outfit* outfit, const double T, const double dir,
       const Pilot *parent, unsigned int target, double time )
 {
    WeaponLayer layer;
-   Weapon *w, **m;
-   GLsizei size;
-   size_t bufsize;
 
    if (!outfit_isBolt(outfit) &&
          !outfit_isLauncher(outfit)) {
@@ -1634,33 +2160,10 @@ void weapon_add( const Outfit* outfit, const double T, const double dir,
    }
 
    layer = (parent->id==PLAYER_ID) ? WEAPON_LAYER_FG : WEAPON_LAYER_BG;
-   w     = weapon_create( outfit, T, dir, pos, vel, parent, target, time );
-
-   /* set the proper layer */
-   switch (layer) {
-      case WEAPON_LAYER_BG:
-         m = &array_grow(&wbackLayer);
-         break;
-      case WEAPON_LAYER_FG:
-         m = &array_grow(&wfrontLayer);
-         break;
-
-      default:
-         WARN(_("Unknown weapon layer!"));
-         return;
-   }
-   *m = w;
+   weapon_create( outfit, T, dir, pos, vel, parent, target, time, layer );
 
    /* Grow the vertex stuff if needed. */
-   bufsize = array_reserved(wfrontLayer) + array_reserved(wbackLayer);
-   if (bufsize != weapon_vboSize) {
-      weapon_vboSize = bufsize;
-      size = sizeof(GLfloat) * (2+4) * weapon_vboSize;
-      weapon_vboData = realloc( weapon_vboData, size );
-      if (weapon_vbo == NULL)
-         weapon_vbo = gl_vboCreateStream( size, NULL );
-      gl_vboData( weapon_vbo, size, weapon_vboData );
-   }
+   weapon_vboGrow();
 }
 
 
@@ -1684,9 +2187,7 @@ unsigned int beam_start( const Outfit* outfit,
       PilotOutfitSlot *mount )
 {
    WeaponLayer layer;
-   Weapon *w, **m;
-   GLsizei size;
-   size_t bufsize;
+   Weapon *w;
 
    if (!outfit_isBeam(outfit)) {
       ERR(_("Trying to create a Beam Weapon from a non-beam outfit."));
@@ -1694,36 +2195,13 @@ unsigned int beam_start( const Outfit* outfit,
    }
 
    layer = (parent->id==PLAYER_ID) ? WEAPON_LAYER_FG : WEAPON_LAYER_BG;
-   w = weapon_create( outfit, 0., dir, pos, vel, parent, target, 0. );
+   w = weapon_create( outfit, 0., dir, pos, vel, parent, target, 0., layer );
    w->ID = ++beam_idgen;
    w->mount = mount;
    w->exp_timer = 0.;
 
-   /* set the proper layer */
-   switch (layer) {
-      case WEAPON_LAYER_BG:
-         m = &array_grow(&wbackLayer);
-         break;
-      case WEAPON_LAYER_FG:
-         m = &array_grow(&wfrontLayer);
-         break;
-
-      default:
-         ERR(_("Invalid WEAPON_LAYER specified"));
-         return -1;
-   }
-   *m = w;
-
    /* Grow the vertex stuff if needed. */
-   bufsize = array_reserved(wfrontLayer) + array_reserved(wbackLayer);
-   if (bufsize != weapon_vboSize) {
-      weapon_vboSize = bufsize;
-      size = sizeof(GLfloat) * (2+4) * weapon_vboSize;
-      weapon_vboData = realloc( weapon_vboData, size );
-      if (weapon_vbo == NULL)
-         weapon_vbo = gl_vboCreateStream( size, NULL );
-      gl_vboData( weapon_vbo, size, weapon_vboData );
-   }
+   weapon_vboGrow();
 
    return w->ID;
 }
@@ -1746,10 +2224,10 @@ void beam_end( const unsigned int parent, unsigned int beam )
    /* set the proper layer */
    switch (layer) {
       case WEAPON_LAYER_BG:
-         curLayer = wbackLayer;
+         curLayer = wbackLayer.w;
          break;
       case WEAPON_LAYER_FG:
-         curLayer = wfrontLayer;
+         curLayer = wfrontLayer.w;
          break;
 
       default:
@@ -1760,7 +2238,7 @@ void beam_end( const unsigned int parent, unsigned int beam )
 
    /* Now try to destroy the beam. */
    for (i=0; i<array_size(curLayer); i++) {
-      if (curLayer[i]->ID == beam) { /* Found it. */
+      if ((curLayer[i] != NULL) && (curLayer[i]->ID == beam)) { /* Found it. */
          weapon_destroy(curLayer[i], layer);
          break;
       }
@@ -1777,14 +2255,14 @@ void beam_end( const unsigned int parent, unsigned int beam )
 static void weapon_destroy( Weapon* w, WeaponLayer layer )
 {
    int i;
-   Weapon** wlayer;
+   WeaponStore *st;
 
    switch (layer) {
       case WEAPON_LAYER_BG:
-         wlayer = wbackLayer;
+         st = &wbackLayer;
          break;
       case WEAPON_LAYER_FG:
-         wlayer = wfrontLayer;
+         st = &wfrontLayer;
          break;
 
       default:
@@ -1792,14 +2270,14 @@ static void weapon_destroy( Weapon* w, WeaponLayer layer )
          return;
    }
 
-   for (i=0; (wlayer[i] != w) && (i < array_size(wlayer)); i++); /* get to the current position */
-   if (i >= array_size(wlayer)) {
+   i = w->idx;
+   if ((w->layer != layer) || (i >= array_size(st->w)) || (st->w[i] != w)) {
       WARN(_("Trying to destroy weapon not found in stack!"));
       return;
    }
 
-   weapon_free(wlayer[i]);
-   array_erase( &wlayer, &wlayer[i], &wlayer[i+1] );
+   weapon_free(w);
+   weapon_storeRemove( st, i );
 }
 
 
@@ -1831,14 +2309,13 @@ static void weapon_free( Weapon* w )
             w->solid->vel.y);
    }
 
-   /* Free the solid. */
-   solid_free(w->solid);
-
 #ifdef DEBUGGING
    memset(w, 0, sizeof(Weapon));
 #endif /* DEBUGGING */
 
-   free(w);
+   /* Return to the pool. */
+   w->next_free    = weapon_poolFree;
+   weapon_poolFree = w;
 }
 
 /**
@@ -1847,17 +2324,24 @@ static void weapon_free( Weapon* w )
 void weapon_clear (void)
 {
    int i;
-   /* Don't forget to stop the sounds. */
-   for (i=0; i < array_size(wbackLayer); i++) {
-      sound_stop(wbackLayer[i]->voice);
-      weapon_free(wbackLayer[i]);
-   }
-   array_erase( &wbackLayer, array_begin(wbackLayer), array_end(wbackLayer) );
-   for (i=0; i < array_size(wfrontLayer); i++) {
-      sound_stop(wfrontLayer[i]->voice);
-      weapon_free(wfrontLayer[i]);
+   WeaponStore *st[2] = { &wbackLayer, &wfrontLayer };
+   int l;
+
+   for (l=0; l<2; l++) {
+      /* Don't forget to stop the sounds. */
+      for (i=0; i < array_size(st[l]->w); i++) {
+         if (st[l]->w[i] == NULL)
+            continue;
+         sound_stop(st[l]->w[i]->voice);
+         weapon_free(st[l]->w[i]);
+      }
+      array_erase( &st[l]->w, array_begin(st[l]->w), array_end(st[l]->w) );
+      array_erase( &st[l]->solid, array_begin(st[l]->solid), array_end(st[l]->solid) );
+      array_erase( &st[l]->timer, array_begin(st[l]->timer), array_end(st[l]->timer) );
+      array_erase( &st[l]->falloff, array_begin(st[l]->falloff), array_end(st[l]->falloff) );
+      array_erase( &st[l]->strength, array_begin(st[l]->strength), array_end(st[l]->strength) );
+      st[l]->dead = 0;
    }
-   array_erase( &wfrontLayer, array_begin(wfrontLayer), array_end(wfrontLayer) );
 }
 
 /**
@@ -1865,13 +2349,25 @@ void weapon_clear (void)
  */
 void weapon_exit (void)
 {
+   int i;
+
    weapon_clear();
 
    /* Destroy front layer. */
-   array_free(wbackLayer);
+   weapon_storeFree(&wbackLayer);
 
    /* Destroy back layer. */
-   array_free(wfrontLayer);
+   weapon_storeFree(&wfrontLayer);
+
+   /* Destroy the pool. */
+   for (i=0; i<array_size(weapon_pool); i++)
+      free( weapon_pool[i] );
+   array_free( weapon_pool );
+   weapon_pool     = NULL;
+   weapon_poolFree = NULL;
+
+   /* Destroy the collision grid. */
+   weapon_gridFree();
 
    /* Destroy VBO. */
    free( weapon_vboData );
@@ -1903,17 +2399,18 @@ static void weapon_explodeLayer( WeaponLayer layer,
       const Pilot *parent, int mode )
 {
    (void)parent;
-   int i;
-   Weapon **curLayer;
+   int i, updating;
+   WeaponStore *st;
+   Weapon *w;
    double dist, rad2;
 
    /* set the proper layer */
    switch (layer) {
       case WEAPON_LAYER_BG:
-         curLayer = wbackLayer;
+         st = &wbackLayer;
          break;
       case WEAPON_LAYER_FG:
-         curLayer = wfrontLayer;
+         st = &wfrontLayer;
          break;
 
       default:
@@ -1923,20 +2420,26 @@ static void weapon_explodeLayer( WeaponLayer layer,
 
    rad2 = radius*radius;
 
-   /* Now try to destroy the weapons affected. */
-   for (i=0; i<array_size(curLayer); i++) {
-      if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(curLayer[i]->outfit)) ||
-            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(curLayer[i]->outfit))) {
+   /* Now try to destroy the weapons affected, compacting once at the end. */
+   updating     = st->updating;
+   st->updating = 1;
+   for (i=0; i<array_size(st->w); i++) {
+      w = st->w[i];
+      if (w == NULL)
+         continue;
+      if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(w->outfit)) ||
+            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(w->outfit))) {
 
-         dist = pow2(curLayer[i]->solid->pos.x - x) +
-               pow2(curLayer[i]->solid->pos.y - y);
+         dist = pow2(w->solid->pos.x - x) +
+               pow2(w->solid->pos.y - y);
 
-         if (dist < rad2) {
-            weapon_destroy(curLayer[i], layer);
-            i--;
-         }
+         if (dist < rad2)
+            weapon_destroy(w, layer);
       }
    }
+   st->updating = updating;
+   if (!updating)
+      weapon_storeCompact( st );
 }
 
 
@@ -52,6 +52,9 @@ void weapon_explode( double x, double y, double radius,
  */
 void weapons_update( const double dt );
 void weapons_render( const WeaponLayer layer, const double dt );
+#if DEBUGGING
+void weapon_gridStats( int *tested, int *pruned );
+#endif /* DEBUGGING */
 
 
 /*